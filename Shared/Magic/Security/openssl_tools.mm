@@ -13,6 +13,7 @@
 #include "openssl_tools.hpp"
 #include "zsign/Utils.hpp"
 #include "zsign/common/common.h"
+#include "zsign/sslptr.h"
 
 #include <openssl/cms.h>
 #include <openssl/conf.h>
@@ -32,30 +33,27 @@ using namespace std;
 
 bool p12_password_check(NSString *file, NSString *pass)
 {
-    BIO *in = BIO_new(BIO_s_mem());
-    d2i_CMS_bio(in, NULL);
     const string strSignerPKeyFile = [file cStringUsingEncoding:NSUTF8StringEncoding];
     const string strPassword = [pass cStringUsingEncoding:NSUTF8StringEncoding];
-    X509 *x509Cert = NULL;
-    EVP_PKEY *evpPKey = NULL;
-    BIO *bioPKey = BIO_new_file(strSignerPKeyFile.c_str(), "r");
-    OSSL_PROVIDER_load(NULL, "legacy");
-    PKCS12 *p12 = d2i_PKCS12_bio(bioPKey, NULL);
-    if (NULL != p12)
+    ZSSLPtr<BIO> bioPKey(BIO_new_file(strSignerPKeyFile.c_str(), "r"));
+    if (!bioPKey)
     {
-        if (0 == PKCS12_parse(p12, strPassword.c_str(), &evpPKey, &x509Cert, NULL))
-        {
-            return false;
-        }
-        PKCS12_free(p12);
-        BIO_free(bioPKey);
-        return true;
+        return false;
     }
-    else
+
+    OSSL_PROVIDER_load(NULL, "legacy");
+    ZSSLPtr<PKCS12> p12(d2i_PKCS12_bio(bioPKey.get(), NULL));
+    if (!p12)
     {
-        BIO_free(bioPKey);
         return false;
     }
+
+    X509 *x509Cert = NULL;
+    EVP_PKEY *evpPKey = NULL;
+    bool bRet = (0 != PKCS12_parse(p12.get(), strPassword.c_str(), &evpPKey, &x509Cert, NULL));
+    ZSSLPtr<X509> cert(x509Cert);
+    ZSSLPtr<EVP_PKEY> pkey(evpPKey);
+    return bRet;
 }
 
 // This function validates a mobile provision file
@@ -68,10 +66,8 @@ void provision_file_validation(NSString *path)
     string strProvisionData;
     ReadFile(strProvisionFile.c_str(), strProvisionData);
 
-    BIO *in = BIO_new(BIO_s_mem());
-    OPENSSL_assert((size_t)BIO_write(in, strProvisionData.data(), (int)strProvisionData.size()) ==
-                   strProvisionData.size());
-    d2i_CMS_bio(in, NULL);
+    ZSSLPtr<BIO> in(BIO_new_mem_buf(strProvisionData.data(), (int)strProvisionData.size()));
+    ZSSLPtr<CMS_ContentInfo> cms(in ? d2i_CMS_bio(in.get(), NULL) : NULL);
 }
 
 void generate_root_ca_pair(const char *basename)
@@ -13,7 +13,11 @@ func zsign(_ appPath: String,
            _ bundleId: String,
            _ name: String,
            _ version: String,
-           _ removeProvisioningFile: Bool) -> Int32
+           _ removeProvisioningFile: Bool,
+           _ injectDylibs: [String],
+           _ removeDylibs: [String],
+           _ changeDylibsFrom: [String],
+           _ changeDylibsTo: [String]) -> Int32
 
 // MARK: - External C++ functions
 
@@ -23,9 +27,33 @@ private func _InjectDyLib(_ filePath: String, _ dylibPath: String, _ weakInject:
 @_silgen_name("ChangeDylibPath")
 private func _ChangeDylibPath(_ filePath: String, _ oldPath: String, _ newPath: String) -> Bool
 
+@_silgen_name("ChangeBundleDylibPath")
+private func _ChangeBundleDylibPath(_ appPath: String, _ oldPath: String, _ newPath: String) -> Bool
+
+@_silgen_name("ExtractDeb")
+private func _ExtractDeb(_ appPath: String,
+                         _ debPath: String,
+                         _ injectPaths: NSMutableArray,
+                         _ changeFrom: NSMutableArray,
+                         _ changeTo: NSMutableArray) -> Int32
+
+@_silgen_name("AdhocSign")
+private func _AdhocSign(_ path: String,
+                        _ entitlementsPath: String,
+                        _ injectDylibs: [String],
+                        _ removeDylibs: [String],
+                        _ changeDylibsFrom: [String],
+                        _ changeDylibsTo: [String]) -> Bool
+
+@_silgen_name("AdhocSignFiles")
+private func _AdhocSignFiles(_ filePaths: [String], _ entitlementsPath: String) -> Bool
+
 @_silgen_name("ListDylibs")
 private func _ListDylibs(_ filePath: String, _ dylibPaths: NSMutableArray) -> Bool
 
+@_silgen_name("GetDylibGraph")
+private func _GetDylibGraph(_ appPath: String, _ graphJSON: NSMutableString) -> Bool
+
 @_silgen_name("UninstallDylibs")
 private func _UninstallDylibs(_ filePath: String, _ dylibPaths: [String]) -> Bool
 
@@ -39,16 +67,62 @@ func changeDylibPath(_ filePath: String, _ oldPath: String, _ newPath: String) -
     return _ChangeDylibPath(filePath, oldPath, newPath)
 }
 
+func changeBundleDylibPath(_ appPath: String, _ oldPath: String, _ newPath: String) -> Bool {
+    return _ChangeBundleDylibPath(appPath, oldPath, newPath)
+}
+
+/// Mirrors ZDebPackage::E_DEB_EXTRACT_*; only `.unsupported` guarantees nothing was written to the app.
+enum DebExtractResult: Int32 {
+    case extracted = 0
+    case unsupported = 1
+    case failed = 2
+}
+
+func extractDeb(_ appPath: String,
+                _ debPath: String,
+                _ injectPaths: NSMutableArray,
+                _ changeFrom: NSMutableArray,
+                _ changeTo: NSMutableArray) -> DebExtractResult {
+    return DebExtractResult(rawValue: _ExtractDeb(appPath, debPath, injectPaths, changeFrom, changeTo)) ?? .failed
+}
+
+func adhocSign(_ path: String, _ entitlementsPath: String, _ edits: DylibEdits) -> Bool {
+    return _AdhocSign(
+        path,
+        entitlementsPath,
+        edits.inject,
+        edits.remove,
+        edits.change.map { $0.from },
+        edits.change.map { $0.to }
+    )
+}
+
+func adhocSignFiles(_ filePaths: [String], _ entitlementsPath: String) -> Bool {
+    return _AdhocSignFiles(filePaths, entitlementsPath)
+}
+
 func getDylibsList(_ filePath: String, _ dylibPaths: NSMutableArray) -> Bool {
     return _ListDylibs(filePath, dylibPaths)
 }
 
+func getDylibGraph(_ appPath: String, _ graphJSON: NSMutableString) -> Bool {
+    return _GetDylibGraph(appPath, graphJSON)
+}
+
 func removeDylibs(_ filePath: String, _ dylibPaths: [String]) -> Bool {
     return _UninstallDylibs(filePath, dylibPaths)
 }
 
 // MARK: - App Signing Functions
 
+/// Load command edits zsign applies to every binary as it signs it, so nothing is rewritten twice.
+/// `inject` only goes into the app's main executable, `remove` and `change` apply bundle-wide.
+struct DylibEdits {
+    var inject: [String] = []
+    var remove: [String] = []
+    var change: [(from: String, to: String)] = []
+}
+
 func signInitialApp(
     bundle: BundleOptions,
     mainOptions: SigningMainDataWrapper,
@@ -102,15 +176,9 @@ func signInitialApp(
             let handler = TweakHandler(urls: signingOptions.signingOptions.toInject, app: tmpDirApp)
             try handler.getInputFiles()
 
-            // Remove injected paths if requested
-            if !mainOptions.mainOptions.removeInjectPaths.isEmpty {
-                if let appExe = try? TweakHandler.findExecutable(at: tmpDirApp) {
-                    _ = uninstallDylibs(
-                        filePath: appExe.path,
-                        dylibPaths: mainOptions.mainOptions.removeInjectPaths
-                    )
-                }
-            }
+            // Remove injected paths if requested, zsign drops them while signing
+            var dylibEdits = handler.dylibEdits
+            dylibEdits.remove = mainOptions.mainOptions.removeInjectPaths
 
             // Update app components
             try updatePlugIns(options: signingOptions, app: tmpDirApp)
@@ -129,7 +197,8 @@ func signInitialApp(
                 certPaths: (certPaths.provisionPath.path, certPaths.p12Path.path),
                 password: mainOptions.mainOptions.certificate?.password ?? "",
                 main: mainOptions,
-                options: signingOptions
+                options: signingOptions,
+                edits: dylibEdits
             )
             Debug.shared.log(message: "🦋 End Signing 🦋")
 
@@ -236,7 +305,8 @@ private func signAppWithZSign(
     certPaths: (provisionPath: String, p12Path: String),
     password: String,
     main: SigningMainDataWrapper? = nil,
-    options: SigningDataWrapper? = nil
+    options: SigningDataWrapper? = nil,
+    edits: DylibEdits = DylibEdits()
 ) throws {
     // Call zsign function
     let result = zsign(
@@ -247,7 +317,11 @@ private func signAppWithZSign(
         main?.mainOptions.bundleId ?? "",
         main?.mainOptions.name ?? "",
         main?.mainOptions.version ?? "",
-        options?.signingOptions.removeProvisioningFile ?? true
+        options?.signingOptions.removeProvisioningFile ?? true,
+        edits.inject,
+        edits.remove,
+        edits.change.map { $0.from },
+        edits.change.map { $0.to }
     )
 
     if result != 0 {
@@ -265,6 +339,35 @@ func injectDylib(filePath: String, dylibPath: String, weakInject: Bool) -> Bool
     return injectDyLib(filePath, dylibPath, weakInject, bCreate)
 }
 
+func changeBundleDylib(appPath: String, oldPath: String, newPath: String) -> Bool {
+    // Call changeBundleDylibPath function using the Swift wrapper
+    return changeBundleDylibPath(appPath, oldPath, newPath)
+}
+
+func extractDeb(appPath: String, debPath: String, edits: inout DylibEdits) -> DebExtractResult {
+    // Call extractDeb function using the Swift wrapper
+    let injectPathsArray = NSMutableArray()
+    let changeFromArray = NSMutableArray()
+    let changeToArray = NSMutableArray()
+    let result = extractDeb(appPath, debPath, injectPathsArray, changeFromArray, changeToArray)
+    edits.inject.append(contentsOf: injectPathsArray.compactMap { $0 as? String })
+    let changes = zip(changeFromArray.compactMap { $0 as? String }, changeToArray.compactMap { $0 as? String })
+    for (from, to) in changes where !edits.change.contains(where: { $0.from == from }) {
+        edits.change.append((from: from, to: to))
+    }
+    return result
+}
+
+func adhocSign(path: String, entitlementsPath: String = "", edits: DylibEdits = DylibEdits()) -> Bool {
+    // Call adhocSign function using the Swift wrapper
+    return adhocSign(path, entitlementsPath, edits)
+}
+
+func adhocSignFiles(filePaths: [String], entitlementsPath: String = "") -> Bool {
+    // Call adhocSignFiles function using the Swift wrapper
+    return adhocSignFiles(filePaths, entitlementsPath)
+}
+
 func changeDylib(filePath: String, oldPath: String, newPath: String) -> Bool {
     // Call changeDylibPath function using the Swift wrapper
     return changeDylibPath(filePath, oldPath, newPath)
@@ -300,6 +403,20 @@ func listDylibs(filePath: String) -> [String]? {
     return nil
 }
 
+func dylibGraph(appPath: String) -> [String: Any]? {
+    // Call getDylibGraph function using the Swift wrapper
+    let graphJSON = NSMutableString()
+
+    if getDylibGraph(appPath, graphJSON),
+       let data = (graphJSON as String).data(using: .utf8),
+       let graph = try? JSONSerialization.jsonObject(with: data) as? [String: Any] {
+        return graph
+    }
+
+    Debug.shared.log(message: "Failed to build dylib graph.")
+    return nil
+}
+
 func uninstallDylibs(filePath: String, dylibPaths: [String]) -> Bool {
     // Call removeDylibs function using the Swift wrapper
     return removeDylibs(filePath, dylibPaths)
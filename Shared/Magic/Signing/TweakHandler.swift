@@ -9,6 +9,9 @@ class TweakHandler {
     private var urlsToInject: [URL] = []
     private var directoriesToCheck: [URL] = []
 
+    /// Load commands for zsign to add while signing, the app's binaries are not touched here
+    private(set) var dylibEdits = DylibEdits()
+
     init(urls: [String], app: URL) {
         self.urls = urls
         self.app = app
@@ -88,6 +91,17 @@ class TweakHandler {
         }
     }
 
+    // change paths because some tweaks hardlink, which is not ideal.
+    // this is not a good solution, at most this would work for basic tweaks
+    // we recommend you use newer theos to compile, and make sure it works
+    // using the ellekit framework
+    private func addSubstratePathChange() {
+        let oldPath = "/Library/Frameworks/CydiaSubstrate.framework/CydiaSubstrate"
+        if !dylibEdits.change.contains(where: { $0.from == oldPath }) {
+            dylibEdits.change.append((from: oldPath, to: "@rpath/CydiaSubstrate.framework/CydiaSubstrate"))
+        }
+    }
+
     // Inject imported dylib file
     private func handleDylib(at url: URL) throws {
         do {
@@ -96,25 +110,10 @@ class TweakHandler {
                 .appendingPathComponent(url.lastPathComponent)
             try Self.moveFile(from: url, to: destinationURL)
 
-            // change paths because some tweaks hardlink, which is not ideal.
-            // this is not a good solution, at most this would work for basic tweaks
-            // we recommend you use newer theos to compile, and make sure it works
-            // using the ellekit framework
-            _ = changeDylib(
-                filePath: destinationURL.path,
-                oldPath: "/Library/Frameworks/CydiaSubstrate.framework/CydiaSubstrate",
-                newPath: "@rpath/CydiaSubstrate.framework/CydiaSubstrate"
-            )
+            addSubstratePathChange()
 
-            // inject if there's a valid app main executable
-            if let exe = try Self.findExecutable(at: app) {
-                let dylibPath = "@executable_path/Frameworks/\(destinationURL.lastPathComponent)"
-                _ = injectDylib(
-                    filePath: exe.path,
-                    dylibPath: dylibPath,
-                    weakInject: true
-                )
-            }
+            // injected into the app main executable when it is signed
+            dylibEdits.inject.append("@executable_path/Frameworks/\(destinationURL.lastPathComponent)")
         } catch {
             throw error
         }
@@ -124,26 +123,12 @@ class TweakHandler {
     private func handleDylib(framework: URL) throws {
         do {
             if let fexe = try Self.findExecutable(at: framework) {
-                // change paths because some tweaks hardlink, which is not ideal.
-                // this is not a good solution, at most this would work for basic tweaks
-                // we recommend you use newer theos to compile, and make sure it works
-                // using the ellekit framework
-                _ = changeDylib(
-                    filePath: fexe.path,
-                    oldPath: "/Library/Frameworks/CydiaSubstrate.framework/CydiaSubstrate",
-                    newPath: "@rpath/CydiaSubstrate.framework/CydiaSubstrate"
-                )
+                addSubstratePathChange()
 
-                // inject if there's a valid app main executable
-                if let appexe = try Self.findExecutable(at: app) {
-                    let dylibPath =
-                        "@executable_path/Frameworks/\(framework.lastPathComponent)/\(fexe.lastPathComponent)"
-                    _ = injectDylib(
-                        filePath: appexe.path,
-                        dylibPath: dylibPath,
-                        weakInject: true
-                    )
-                }
+                // injected into the app main executable when it is signed
+                dylibEdits.inject.append(
+                    "@executable_path/Frameworks/\(framework.lastPathComponent)/\(fexe.lastPathComponent)"
+                )
             }
         } catch {
             throw error
@@ -152,6 +137,21 @@ class TweakHandler {
 
     // Extract imported deb file
     private func handleDeb(at url: URL, baseTmpDir: URL) throws {
+        // the native reader streams gz/xz debs straight into the app,
+        // only a codec it can't read (nothing written yet) goes through the extraction below
+        switch extractDeb(appPath: app.path, debPath: url.path, edits: &dylibEdits) {
+        case .extracted:
+            return
+        case .failed:
+            throw NSError(
+                domain: "TweakHandlerErrorDomain",
+                code: 1,
+                userInfo: [NSLocalizedDescriptionKey: "Failed to extract deb \(url.lastPathComponent)"]
+            )
+        case .unsupported:
+            break
+        }
+
         let uniqueSubDir = baseTmpDir.appendingPathComponent(UUID().uuidString)
         try Self.createDirectoryIfNeeded(at: uniqueSubDir)
 
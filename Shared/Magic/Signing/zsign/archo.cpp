@@ -12,7 +12,9 @@
 #include "common/json.h"
 #include "signing.h"
 
-static uint64_t execSegLimit = 0;
+static const string s_strEmptyEntitlements =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
+    "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n<plist version=\"1.0\">\n<dict/>\n</plist>\n";
 
 ZArchO::ZArchO()
 {
@@ -30,9 +32,13 @@ ZArchO::ZArchO()
     m_pCodeSignSegment = NULL;
     m_pLinkEditSegment = NULL;
     m_uLoadCommandsFreeSpace = 0;
+    m_uPageSize = 0;
+    m_uSignSlack = CODESIGN_SLACK_DEFAULT;
+    m_uNeedSignLength = 0;
+    m_uExecSegLimit = 0;
 }
 
-bool ZArchO::Init(uint8_t *pBase, uint32_t uLength)
+bool ZArchO::Init(uint8_t *pBase, uint64_t uLength)
 {
     if (NULL == pBase || uLength == 0)
     {
@@ -52,7 +58,9 @@ bool ZArchO::Init(uint8_t *pBase, uint32_t uLength)
     m_b64 = (MH_MAGIC_64 == m_pHeader->magic || MH_CIGAM_64 == m_pHeader->magic) ? true : false;
     m_bBigEndian = (MH_CIGAM == m_pHeader->magic || MH_CIGAM_64 == m_pHeader->magic) ? true : false;
     m_uHeaderSize = m_b64 ? sizeof(mach_header_64) : sizeof(mach_header);
+    m_uExecSegLimit = 0;
 
+    uint64_t uFirstDataOffset = m_uLength; // load commands can grow up to the first byte of file content
     uint8_t *pLoadCommand = m_pBase + m_uHeaderSize;
     for (uint32_t i = 0; i < BO(m_pHeader->ncmds); i++)
     {
@@ -62,59 +70,73 @@ bool ZArchO::Init(uint8_t *pBase, uint32_t uLength)
             case LC_SEGMENT:
             {
                 segment_command *seglc = reinterpret_cast<segment_command *>(pLoadCommand);
-                if (0 == strcmp("__TEXT", seglc->segname))
+                if (BO(seglc->fileoff) > 0 && BO(seglc->filesize) > 0)
                 {
-                    execSegLimit = seglc->vmsize;
-                    for (uint32_t j = 0; j < BO(seglc->nsects); j++)
-                    {
-                        section *sect =
-                            reinterpret_cast<section *>((pLoadCommand + sizeof(segment_command)) + sizeof(section) * j);
-                        if (0 == strcmp("__text", sect->sectname))
-                        {
-                            if (BO(sect->offset) > (BO(m_pHeader->sizeofcmds) + m_uHeaderSize))
-                            {
-                                m_uLoadCommandsFreeSpace = BO(sect->offset) - BO(m_pHeader->sizeofcmds) - m_uHeaderSize;
-                            }
-                        }
-                        else if (0 == strcmp("__info_plist", sect->sectname))
-                        {
-                            m_strInfoPlist.append((const char *)m_pBase + BO(sect->offset), BO(sect->size));
-                        }
-                    }
+                    uFirstDataOffset = min(uFirstDataOffset, (uint64_t)BO(seglc->fileoff));
+                }
+
+                bool bText = (0 == strcmp("__TEXT", seglc->segname));
+                if (bText)
+                {
+                    m_uExecSegLimit = BO(seglc->vmsize);
                 }
                 else if (0 == strcmp("__LINKEDIT", seglc->segname))
                 {
                     m_pLinkEditSegment = pLoadCommand;
                 }
+
+                for (uint32_t j = 0; j < BO(seglc->nsects); j++)
+                {
+                    section *sect =
+                        reinterpret_cast<section *>((pLoadCommand + sizeof(segment_command)) + sizeof(section) * j);
+                    uint32_t uType = BO(sect->flags) & SECTION_TYPE;
+                    if (BO(sect->offset) > 0 && BO(sect->size) > 0 && S_ZEROFILL != uType && S_GB_ZEROFILL != uType &&
+                        S_THREAD_LOCAL_ZEROFILL != uType)
+                    {
+                        uFirstDataOffset = min(uFirstDataOffset, (uint64_t)BO(sect->offset));
+                    }
+
+                    if (bText && 0 == strcmp("__info_plist", sect->sectname))
+                    {
+                        m_strInfoPlist.append((const char *)m_pBase + BO(sect->offset), BO(sect->size));
+                    }
+                }
             }
             break;
             case LC_SEGMENT_64:
             {
                 segment_command_64 *seglc = reinterpret_cast<segment_command_64 *>(pLoadCommand);
-                if (0 == strcmp("__TEXT", seglc->segname))
+                if (BO(seglc->fileoff) > 0 && BO(seglc->filesize) > 0)
                 {
-                    execSegLimit = seglc->vmsize;
-                    for (uint32_t j = 0; j < BO(seglc->nsects); j++)
-                    {
-                        section_64 *sect = reinterpret_cast<section_64 *>((pLoadCommand + sizeof(segment_command_64)) +
-                                                                          sizeof(section_64) * j);
-                        if (0 == strcmp("__text", sect->sectname))
-                        {
-                            if (BO(sect->offset) > (BO(m_pHeader->sizeofcmds) + m_uHeaderSize))
-                            {
-                                m_uLoadCommandsFreeSpace = BO(sect->offset) - BO(m_pHeader->sizeofcmds) - m_uHeaderSize;
-                            }
-                        }
-                        else if (0 == strcmp("__info_plist", sect->sectname))
-                        {
-                            m_strInfoPlist.append((const char *)m_pBase + BO(sect->offset), BO((uint32_t)sect->size));
-                        }
-                    }
+                    uFirstDataOffset = min(uFirstDataOffset, BO(seglc->fileoff));
+                }
+
+                bool bText = (0 == strcmp("__TEXT", seglc->segname));
+                if (bText)
+                {
+                    m_uExecSegLimit = BO(seglc->vmsize);
                 }
                 else if (0 == strcmp("__LINKEDIT", seglc->segname))
                 {
                     m_pLinkEditSegment = pLoadCommand;
                 }
+
+                for (uint32_t j = 0; j < BO(seglc->nsects); j++)
+                {
+                    section_64 *sect = reinterpret_cast<section_64 *>((pLoadCommand + sizeof(segment_command_64)) +
+                                                                      sizeof(section_64) * j);
+                    uint32_t uType = BO(sect->flags) & SECTION_TYPE;
+                    if (BO(sect->offset) > 0 && BO(sect->size) > 0 && S_ZEROFILL != uType &&
+                        S_GB_ZEROFILL != uType && S_THREAD_LOCAL_ZEROFILL != uType)
+                    {
+                        uFirstDataOffset = min(uFirstDataOffset, (uint64_t)BO(sect->offset));
+                    }
+
+                    if (bText && 0 == strcmp("__info_plist", sect->sectname))
+                    {
+                        m_strInfoPlist.append((const char *)m_pBase + BO(sect->offset), BO(sect->size));
+                    }
+                }
             }
             break;
             case LC_ENCRYPTION_INFO:
@@ -141,9 +163,112 @@ bool ZArchO::Init(uint8_t *pBase, uint32_t uLength)
         pLoadCommand += BO(plc->cmdsize);
     }
 
+    uint32_t uLoadCommandsEnd = m_uHeaderSize + BO(m_pHeader->sizeofcmds);
+    m_uLoadCommandsFreeSpace =
+        (uFirstDataOffset > uLoadCommandsEnd) ? (uint32_t)(uFirstDataOffset - uLoadCommandsEnd) : 0;
     return true;
 }
 
+bool ZArchO::ReserveLoadCommandsSpace(uint32_t uSize)
+{
+    if (m_uLoadCommandsFreeSpace >= uSize)
+    {
+        return true;
+    }
+
+    // commands dyld doesn't need, they are dropped only as far as needed
+    uint32_t uReclaimable = 0;
+    uint8_t *pLoadCommand = m_pBase + m_uHeaderSize;
+    for (uint32_t i = 0; i < BO(m_pHeader->ncmds); i++)
+    {
+        load_command *plc = reinterpret_cast<load_command *>(pLoadCommand);
+        if (IsDroppableLoadCommand(pLoadCommand))
+        {
+            uReclaimable += BO(plc->cmdsize);
+        }
+        pLoadCommand += BO(plc->cmdsize);
+    }
+
+    if (m_uLoadCommandsFreeSpace + uReclaimable < uSize)
+    {
+        ZLog::ErrorV(">>> No Enough Space Of LoadCommands! Free: %u, Reclaimable: %u, Need: %u\n",
+                     m_uLoadCommandsFreeSpace, uReclaimable, uSize);
+        return false;
+    }
+
+    uint32_t uCommandsSize = BO(m_pHeader->sizeofcmds);
+    uint32_t uCommandsCount = 0;
+    uint32_t uDropped = 0;
+    string strCommands;
+    strCommands.reserve(uCommandsSize);
+    pLoadCommand = m_pBase + m_uHeaderSize;
+    for (uint32_t i = 0; i < BO(m_pHeader->ncmds); i++)
+    {
+        load_command *plc = reinterpret_cast<load_command *>(pLoadCommand);
+        uint32_t uCommandSize = BO(plc->cmdsize);
+        if (m_uLoadCommandsFreeSpace + uDropped < uSize && IsDroppableLoadCommand(pLoadCommand))
+        {
+            ZLog::WarnV(">>> Drop LoadCommand 0x%x (%u bytes) For Space\n", BO(plc->cmd), uCommandSize);
+            uDropped += uCommandSize;
+        }
+        else
+        {
+            strCommands.append((const char *)pLoadCommand, uCommandSize);
+            uCommandsCount++;
+        }
+        pLoadCommand += uCommandSize;
+    }
+
+    memcpy(m_pBase + m_uHeaderSize, strCommands.data(), strCommands.size());
+    memset(m_pBase + m_uHeaderSize + strCommands.size(), 0, uDropped);
+    m_pHeader->ncmds = BO(uCommandsCount);
+    m_pHeader->sizeofcmds = BO((uint32_t)strCommands.size());
+    m_uLoadCommandsFreeSpace += uDropped;
+
+    // commands behind a dropped one have moved
+    m_pCodeSignSegment = NULL;
+    m_pLinkEditSegment = NULL;
+    pLoadCommand = m_pBase + m_uHeaderSize;
+    for (uint32_t i = 0; i < uCommandsCount; i++)
+    {
+        load_command *plc = reinterpret_cast<load_command *>(pLoadCommand);
+        if (LC_CODE_SIGNATURE == BO(plc->cmd))
+        {
+            m_pCodeSignSegment = pLoadCommand;
+        }
+        else if (LC_SEGMENT == BO(plc->cmd) || LC_SEGMENT_64 == BO(plc->cmd))
+        {
+            if (0 == strcmp("__LINKEDIT", reinterpret_cast<segment_command *>(pLoadCommand)->segname))
+            {
+                m_pLinkEditSegment = pLoadCommand;
+            }
+        }
+        pLoadCommand += BO(plc->cmdsize);
+    }
+    return true;
+}
+
+bool ZArchO::IsDroppableLoadCommand(uint8_t *pLoadCommand) const
+{
+    load_command *plc = reinterpret_cast<load_command *>(pLoadCommand);
+    switch (BO(plc->cmd))
+    {
+        case LC_DYLIB_CODE_SIGN_DRS:
+        case LC_SOURCE_VERSION:
+        case LC_DATA_IN_CODE:
+            return true;
+            break;
+        case LC_ENCRYPTION_INFO:
+        case LC_ENCRYPTION_INFO_64:
+        { // only when already decrypted
+            encryption_info_command *crypt_cmd = reinterpret_cast<encryption_info_command *>(pLoadCommand);
+            return (0 == BO(crypt_cmd->cryptid));
+        }
+        break;
+    }
+    return false;
+}
+
 // static to match header declaration
 const char *ZArchO::GetArch(int cpuType, int cpuSubType)
 {
@@ -268,6 +393,8 @@ const char *ZArchO::GetFileType(uint32_t uFileType)
 
 uint32_t ZArchO::BO(uint32_t uValue) const { return m_bBigEndian ? LE(uValue) : uValue; }
 
+uint64_t ZArchO::BO(uint64_t uValue) const { return m_bBigEndian ? LE(uValue) : uValue; }
+
 bool ZArchO::IsExecute()
 {
     if (NULL != m_pHeader)
@@ -287,17 +414,17 @@ void ZArchO::PrintInfo() const
     ZLog::Print("------------------------------------------------------------------\n");
     ZLog::Print(">>> MachO Info: \n");
     ZLog::PrintV("\tFileType: \t%s\n", GetFileType(BO(m_pHeader->filetype)));
-    ZLog::PrintV("\tTotalSize: \t%u (%s)\n", m_uLength, FormatSize(m_uLength).c_str());
+    ZLog::PrintV("\tTotalSize: \t%llu (%s)\n", m_uLength, FormatSize(m_uLength).c_str());
     ZLog::PrintV("\tPlatform: \t%u\n", m_b64 ? 64 : 32);
-    ZLog::PrintV("\tCPUArch: \t%s\n", GetArch(BO(m_pHeader->cputype), BO(m_pHeader->cpusubtype)));
-    ZLog::PrintV("\tCPUType: \t0x%x\n", BO(m_pHeader->cputype));
-    ZLog::PrintV("\tCPUSubType: \t0x%x\n", BO(m_pHeader->cpusubtype));
+    ZLog::PrintV("\tCPUArch: \t%s\n", GetArch(BO((uint32_t)m_pHeader->cputype), BO((uint32_t)m_pHeader->cpusubtype)));
+    ZLog::PrintV("\tCPUType: \t0x%x\n", BO((uint32_t)m_pHeader->cputype));
+    ZLog::PrintV("\tCPUSubType: \t0x%x\n", BO((uint32_t)m_pHeader->cpusubtype));
     ZLog::PrintV("\tBigEndian: \t%d\n", m_bBigEndian);
     ZLog::PrintV("\tEncrypted: \t%d\n", m_bEncrypted);
     ZLog::PrintV("\tCommandCount: \t%d\n", BO(m_pHeader->ncmds));
-    ZLog::PrintV("\tCodeLength: \t%d (%s)\n", m_uCodeLength, FormatSize(m_uCodeLength).c_str());
+    ZLog::PrintV("\tCodeLength: \t%llu (%s)\n", m_uCodeLength, FormatSize(m_uCodeLength).c_str());
     ZLog::PrintV("\tSignLength: \t%d (%s)\n", m_uSignLength, FormatSize(m_uSignLength).c_str());
-    ZLog::PrintV("\tSpareLength: \t%d (%s)\n", m_uLength - m_uCodeLength - m_uSignLength,
+    ZLog::PrintV("\tSpareLength: \t%lld (%s)\n", (int64_t)(m_uLength - m_uCodeLength - m_uSignLength),
                  FormatSize(m_uLength - m_uCodeLength - m_uSignLength).c_str());
 
     uint8_t *pLoadCommand = m_pBase + m_uHeaderSize;
@@ -380,17 +507,15 @@ void ZArchO::PrintInfo() const
 bool ZArchO::BuildCodeSignature(ZSignAsset *pSignAsset, bool bForce, const string &strBundleId,
                                 const string &strInfoPlistSHA1, const string &strInfoPlistSHA256,
                                 const string &strCodeResourcesSHA1, const string &strCodeResourcesSHA256,
-                                string &strOutput)
+                                bool bSHA256Only, string &strOutput)
 {
     string strRequirementsSlot;
     string strEntitlementsSlot;
     string strDerEntitlementsSlot;
 
-    string strEmptyEntitlements =
-        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
-        "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n<plist version=\"1.0\">\n<dict/>\n</plist>\n";
     SlotBuildRequirements(strBundleId, pSignAsset->m_strSubjectCN, strRequirementsSlot);
-    SlotBuildEntitlements(IsExecute() ? pSignAsset->m_strEntitlementsData : strEmptyEntitlements, strEntitlementsSlot);
+    SlotBuildEntitlements(IsExecute() ? pSignAsset->m_strEntitlementsData : s_strEmptyEntitlements,
+                          strEntitlementsSlot);
     SlotBuildDerEntitlements(IsExecute() ? pSignAsset->m_strEntitlementsData : "", strDerEntitlementsSlot);
 
     string strRequirementsSlotSHA1;
@@ -433,10 +558,11 @@ bool ZArchO::BuildCodeSignature(ZSignAsset *pSignAsset, bool bForce, const strin
     uint8_t *pCodeSlots256Data = NULL;
     uint32_t uCodeSlots1DataLength = 0;
     uint32_t uCodeSlots256DataLength = 0;
+    uint32_t uPageSize = GetPageSize();
     if (!bForce)
     {
-        GetCodeSignatureExistsCodeSlotsData(m_pSignBase, pCodeSlots1Data, uCodeSlots1DataLength, pCodeSlots256Data,
-                                            uCodeSlots256DataLength);
+        GetCodeSignatureExistsCodeSlotsData(m_pSignBase, uPageSize, pCodeSlots1Data, uCodeSlots1DataLength,
+                                            pCodeSlots256Data, uCodeSlots256DataLength);
     }
 
     uint64_t execSegFlags = 0;
@@ -446,18 +572,53 @@ bool ZArchO::BuildCodeSignature(ZSignAsset *pSignAsset, bool bForce, const strin
         execSegFlags = CS_EXECSEG_MAIN_BINARY | CS_EXECSEG_ALLOW_UNSIGNED;
     }
 
+    uint32_t uFlags = pSignAsset->m_bAdhoc ? (uint32_t)CS_ADHOC : 0;
     string strCMSSignatureSlot;
     string strCodeDirectorySlot;
     string strAltnateCodeDirectorySlot;
-    SlotBuildCodeDirectory(false, m_pBase, m_uCodeLength, pCodeSlots1Data, uCodeSlots1DataLength, execSegLimit,
-                           execSegFlags, strBundleId, pSignAsset->m_strTeamId, strInfoPlistSHA1,
-                           strRequirementsSlotSHA1, strCodeResourcesSHA1, strEntitlementsSlotSHA1,
-                           strDerEntitlementsSlotSHA1, IsExecute(), strCodeDirectorySlot);
-    SlotBuildCodeDirectory(true, m_pBase, m_uCodeLength, pCodeSlots256Data, uCodeSlots256DataLength, execSegLimit,
-                           execSegFlags, strBundleId, pSignAsset->m_strTeamId, strInfoPlistSHA256,
-                           strRequirementsSlotSHA256, strCodeResourcesSHA256, strEntitlementsSlotSHA256,
-                           strDerEntitlementsSlotSHA256, IsExecute(), strAltnateCodeDirectorySlot);
-    SlotBuildCMSSignature(pSignAsset, strCodeDirectorySlot, strAltnateCodeDirectorySlot, strCMSSignatureSlot);
+    if (bSHA256Only)
+    { // the SHA-256 directory takes the primary slot and there is no alternate
+        SlotBuildCodeDirectory(true, m_pBase, m_uCodeLength, pCodeSlots256Data, uCodeSlots256DataLength,
+                               m_uExecSegLimit, execSegFlags, uFlags, uPageSize, strBundleId, pSignAsset->m_strTeamId,
+                               strInfoPlistSHA256, strRequirementsSlotSHA256, strCodeResourcesSHA256,
+                               strEntitlementsSlotSHA256, strDerEntitlementsSlotSHA256, IsExecute(),
+                               strCodeDirectorySlot);
+    }
+    else
+    {
+        SlotBuildCodeDirectory(false, m_pBase, m_uCodeLength, pCodeSlots1Data, uCodeSlots1DataLength,
+                               m_uExecSegLimit, execSegFlags, uFlags, uPageSize, strBundleId, pSignAsset->m_strTeamId,
+                               strInfoPlistSHA1, strRequirementsSlotSHA1, strCodeResourcesSHA1,
+                               strEntitlementsSlotSHA1, strDerEntitlementsSlotSHA1, IsExecute(), strCodeDirectorySlot);
+        SlotBuildCodeDirectory(true, m_pBase, m_uCodeLength, pCodeSlots256Data, uCodeSlots256DataLength,
+                               m_uExecSegLimit, execSegFlags, uFlags, uPageSize, strBundleId, pSignAsset->m_strTeamId,
+                               strInfoPlistSHA256, strRequirementsSlotSHA256, strCodeResourcesSHA256,
+                               strEntitlementsSlotSHA256, strDerEntitlementsSlotSHA256, IsExecute(),
+                               strAltnateCodeDirectorySlot);
+    }
+    if (pSignAsset->m_bAdhoc)
+    { // empty blob wrapper, as codesign -s - and ldid leave it
+        strCMSSignatureSlot.assign("\xfa\xde\x0b\x01\x00\x00\x00\x08", 8);
+    }
+    else
+    {
+        SlotBuildCMSSignature(pSignAsset, strCodeDirectorySlot, strAltnateCodeDirectorySlot, strCMSSignatureSlot);
+    }
+
+    if (bSHA256Only)
+    { // truncated sha256, as the kernel and CodeResources record it
+        SHASum(E_SHASUM_TYPE_256, strCodeDirectorySlot, m_strCDHash);
+        m_strCDHash.resize(20);
+    }
+    else if (strAltnateCodeDirectorySlot.empty())
+    {
+        SHASum(E_SHASUM_TYPE_1, strCodeDirectorySlot, m_strCDHash);
+    }
+    else
+    {
+        SHASum(E_SHASUM_TYPE_256, strAltnateCodeDirectorySlot, m_strCDHash);
+        m_strCDHash.resize(20);
+    }
 
     uint32_t uCodeDirectorySlotLength = (uint32_t)strCodeDirectorySlot.size();
     uint32_t uRequirementsSlotLength = (uint32_t)strRequirementsSlot.size();
@@ -565,11 +726,13 @@ bool ZArchO::BuildCodeSignature(ZSignAsset *pSignAsset, bool bForce, const strin
 }
 
 bool ZArchO::Sign(ZSignAsset *pSignAsset, bool bForce, const string &strBundleId, const string &strInfoPlistSHA1,
-                  const string &strInfoPlistSHA256, const string &strCodeResourcesData)
+                  const string &strInfoPlistSHA256, const string &strCodeResourcesData, bool bSHA256Only)
 {
+    uint32_t uSignLength = EstimateSignLength(pSignAsset, strBundleId, bSHA256Only);
     if (NULL == m_pSignBase)
     {
         m_bEnoughSpace = false;
+        m_uNeedSignLength = uSignLength;
         ZLog::Warn(">>> Can't Find CodeSignature Segment!\n");
         return false;
     }
@@ -586,59 +749,217 @@ bool ZArchO::Sign(ZSignAsset *pSignAsset, bool bForce, const string &strBundleId
         SHASum(strCodeResourcesData, strCodeResourcesSHA1, strCodeResourcesSHA256);
     }
 
+    if (CompactCodeSignSpace(uSignLength))
+    { // right-sized before the blob is built, so the load commands it hashes are already final
+        RehashLoadCommandsSlots();
+    }
+    else if (m_uCodeLength + uSignLength > m_uLength)
+    { // a blob that can't fit isn't built, the realloc is sized by the estimate instead
+        m_bEnoughSpace = false;
+        m_uNeedSignLength = uSignLength;
+        ZLog::WarnV(">>> No Enough CodeSignature Space. Length => Now: %lld, Need: %u\n",
+                    (int64_t)m_uLength - (int64_t)m_uCodeLength, uSignLength);
+        return false;
+    }
+
     string strCodeSignBlob;
     BuildCodeSignature(pSignAsset, bForce, strBundleId, strInfoPlistSHA1, strInfoPlistSHA256, strCodeResourcesSHA1,
-                       strCodeResourcesSHA256, strCodeSignBlob);
+                       strCodeResourcesSHA256, bSHA256Only, strCodeSignBlob);
     if (strCodeSignBlob.empty())
     {
         ZLog::Error(">>> Build CodeSignature Failed!\n");
         return false;
     }
 
-    int nSpaceLength = (int)m_uLength - (int)m_uCodeLength - (int)strCodeSignBlob.size();
+    m_uNeedSignLength = (uint32_t)strCodeSignBlob.size();
+    return WriteCodeSignature(strCodeSignBlob);
+}
+
+uint32_t ZArchO::EstimateSignLength(ZSignAsset *pSignAsset, const string &strBundleId, bool bSHA256Only)
+{ // every blob of the new signature, laid out as BuildCodeSignature does
+    uint32_t uCMSLength = 8; // empty ad-hoc wrapper
+    if (!pSignAsset->m_bAdhoc)
+    {
+        uCMSLength = pSignAsset->GetCMSLengthBound();
+        if (0 == uCMSLength)
+        { // only a CMS the slice already carries tells how large CMS_sign output gets
+            uCMSLength = GetCodeSignatureSlotLength(m_pSignBase, CSSLOT_SIGNATURESLOT);
+            uCMSLength = (uCMSLength > 8) ? uCMSLength : 0;
+        }
+    }
+    if (0 == uCMSLength)
+    {
+        return 0;
+    }
+
+    string strRequirementsSlot;
+    string strEntitlementsSlot;
+    string strDerEntitlementsSlot;
+    SlotBuildRequirements(strBundleId, pSignAsset->m_strSubjectCN, strRequirementsSlot);
+    SlotBuildEntitlements(IsExecute() ? pSignAsset->m_strEntitlementsData : s_strEmptyEntitlements,
+                          strEntitlementsSlot);
+    SlotBuildDerEntitlements(IsExecute() ? pSignAsset->m_strEntitlementsData : "", strDerEntitlementsSlot);
+
+    // fixed 0x20400 header, identifier, team id, then the special and code slots
+    uint32_t uPageSize = GetPageSize();
+    uint64_t uSlots = (IsExecute() ? 7 : 5) + (m_uCodeLength + uPageSize - 1) / uPageSize;
+    uint64_t uCodeDirectoryLength = 88 + strBundleId.size() + 1;
+    uCodeDirectoryLength += pSignAsset->m_strTeamId.empty() ? 0 : pSignAsset->m_strTeamId.size() + 1;
+
+    uint64_t uBlobCount = 2 + (strRequirementsSlot.empty() ? 0 : 1) + (strEntitlementsSlot.empty() ? 0 : 1) +
+                          (strDerEntitlementsSlot.empty() ? 0 : 1) + (bSHA256Only ? 0 : 1);
+    uint64_t uLength = sizeof(CS_SuperBlob) + uBlobCount * sizeof(CS_BlobIndex) + strRequirementsSlot.size() +
+                       strEntitlementsSlot.size() + strDerEntitlementsSlot.size() + uCMSLength;
+    uLength += bSHA256Only ? (uCodeDirectoryLength + uSlots * 32)
+                           : (uCodeDirectoryLength * 2 + uSlots * (20 + 32));
+    return (uint32_t)min(uLength, (uint64_t)UINT32_MAX / 2);
+}
+
+bool ZArchO::WriteCodeSignature(const string &strCodeSignBlob)
+{
+    int64_t nSpaceLength = (int64_t)m_uLength - (int64_t)m_uCodeLength - (int64_t)strCodeSignBlob.size();
     if (nSpaceLength < 0)
     {
         m_bEnoughSpace = false;
-        ZLog::WarnV(">>> No Enough CodeSignature Space. Length => Now: %d, Need: %d\n",
-                    (int)m_uLength - (int)m_uCodeLength, (int)strCodeSignBlob.size());
+        ZLog::WarnV(">>> No Enough CodeSignature Space. Length => Now: %lld, Need: %d\n",
+                    (int64_t)m_uLength - (int64_t)m_uCodeLength, (int)strCodeSignBlob.size());
         return false;
     }
 
     memcpy(m_pBase + m_uCodeLength, strCodeSignBlob.data(), strCodeSignBlob.size());
-    // memset(m_pBase + m_uCodeLength + strCodeSignBlob.size(), 0, nSpaceLength);
+    memset(m_pBase + m_uCodeLength + strCodeSignBlob.size(), 0, (size_t)nSpaceLength); // no stale bytes of old blobs
+    return true;
+}
+
+bool ZArchO::CompactCodeSignSpace(uint32_t uSignLength)
+{
+    if (NULL == m_pLinkEditSegment || NULL == m_pCodeSignSegment || 0 == m_uSignLength || 0 == uSignLength)
+    { // unsigned slices get their space from a realloc sized to the built blob
+        return false;
+    }
+
+    // 16 more bytes absorb an ECDSA signature that comes out a little longer when signing again
+    codesignature_command *pcslc = reinterpret_cast<codesignature_command *>(m_pCodeSignSegment);
+    uint32_t uNewSignLength = ((uSignLength + 16 + 15) & ~15u) + m_uSignSlack;
+    if ((uint64_t)BO(pcslc->dataoff) + BO(pcslc->datasize) != m_uLength ||
+        (uint64_t)BO(pcslc->datasize) <= (uint64_t)uNewSignLength + m_uSignSlack)
+    { // a stale tail within the slack isn't worth rewriting the file for
+        return false;
+    }
+
+    uint64_t uNewLength = m_uCodeLength + uNewSignLength;
+    uint64_t uSegAlign = (CPU_TYPE_ARM64 == (int)BO((uint32_t)m_pHeader->cputype)) ? 16384 : 4096;
+    load_command *pseglc = reinterpret_cast<load_command *>(m_pLinkEditSegment);
+    switch (BO(pseglc->cmd))
+    {
+        case LC_SEGMENT:
+        {
+            segment_command *seglc = reinterpret_cast<segment_command *>(m_pLinkEditSegment);
+            if ((uint64_t)BO(seglc->fileoff) + BO(seglc->filesize) != m_uLength)
+            {
+                return false;
+            }
+            uint64_t uFileSize = uNewLength - BO(seglc->fileoff);
+            uint64_t uVMSize = min((uint64_t)BO(seglc->vmsize), (uFileSize + uSegAlign - 1) / uSegAlign * uSegAlign);
+            seglc->filesize = BO((uint32_t)uFileSize);
+            seglc->vmsize = BO((uint32_t)uVMSize);
+        }
+        break;
+        case LC_SEGMENT_64:
+        {
+            segment_command_64 *seglc = reinterpret_cast<segment_command_64 *>(m_pLinkEditSegment);
+            if (BO(seglc->fileoff) + BO(seglc->filesize) != m_uLength)
+            {
+                return false;
+            }
+            uint64_t uFileSize = uNewLength - BO(seglc->fileoff);
+            uint64_t uVMSize = min(BO(seglc->vmsize), (uFileSize + uSegAlign - 1) / uSegAlign * uSegAlign);
+            seglc->filesize = BO(uFileSize);
+            seglc->vmsize = BO(uVMSize);
+        }
+        break;
+        default:
+            return false;
+    }
+
+    ZLog::PrintV(">>> Compact CodeSignature Space: %u -> %u\n", BO(pcslc->datasize), uNewSignLength);
+    pcslc->datasize = BO(uNewSignLength);
+    m_uLength = uNewLength;
     return true;
 }
 
-uint32_t ZArchO::ReallocCodeSignSpace(const string &strNewFile)
+void ZArchO::RehashLoadCommandsSlots()
+{
+    uint8_t *pCodeSlots1Data = NULL;
+    uint8_t *pCodeSlots256Data = NULL;
+    uint32_t uCodeSlots1DataLength = 0;
+    uint32_t uCodeSlots256DataLength = 0;
+    uint32_t uPageSize = GetPageSize();
+    GetCodeSignatureExistsCodeSlotsData(m_pSignBase, uPageSize, pCodeSlots1Data, uCodeSlots1DataLength,
+                                        pCodeSlots256Data, uCodeSlots256DataLength);
+
+    uint64_t uCommandsEnd = (uint64_t)m_uHeaderSize + BO(m_pHeader->sizeofcmds);
+    uint64_t uHashLength = min((uCommandsEnd + uPageSize - 1) / uPageSize * uPageSize, m_uCodeLength);
+    if (NULL != pCodeSlots1Data)
+    {
+        string strSlots;
+        SHASumPages(E_SHASUM_TYPE_1, m_pBase, uHashLength, uPageSize, strSlots);
+        memcpy(pCodeSlots1Data, strSlots.data(), min((size_t)uCodeSlots1DataLength, strSlots.size()));
+    }
+    if (NULL != pCodeSlots256Data)
+    {
+        string strSlots;
+        SHASumPages(E_SHASUM_TYPE_256, m_pBase, uHashLength, uPageSize, strSlots);
+        memcpy(pCodeSlots256Data, strSlots.data(), min((size_t)uCodeSlots256DataLength, strSlots.size()));
+    }
+}
+
+uint64_t ZArchO::ReallocCodeSignSpace(const string &strNewFile)
 {
     RemoveFile(strNewFile.c_str());
 
-    uint32_t uNewLength =
-        m_uCodeLength + ByteAlign(((m_uCodeLength / 4096) + 1) * (20 + 32), 4096) + 16384; // 16K May Be Enough
-    if (NULL == m_pLinkEditSegment || uNewLength <= m_uLength)
+    uint64_t uNewLength = m_uCodeLength + ByteAlign(((m_uCodeLength / GetPageSize()) + 1) * (20 + 32), 4096) +
+                          16384; // 16K May Be Enough
+    if (m_uNeedSignLength > 0)
+    { // the blob size is known, it gets the same headroom compaction leaves
+        uNewLength = max(m_uLength, m_uCodeLength + ((m_uNeedSignLength + 16 + 15) & ~15u) + m_uSignSlack);
+    }
+    if (NULL == m_pLinkEditSegment || uNewLength < m_uLength)
     {
         return 0;
     }
 
+    if (m_uCodeLength > UINT32_MAX || uNewLength - m_uCodeLength > UINT32_MAX)
+    { // LC_CODE_SIGNATURE only has 32-bit dataoff/datasize
+        ZLog::ErrorV(">>> CodeSignature Offset Out Of Range! CodeLength: %llu\n", m_uCodeLength);
+        return 0;
+    }
+
+    if (NULL == m_pCodeSignSegment && !ReserveLoadCommandsSpace(sizeof(codesignature_command)))
+    {
+        ZLog::Error(">>> Can't Find Free Space Of LoadCommands For CodeSignature!\n");
+        return 0;
+    }
+
     load_command *pseglc = reinterpret_cast<load_command *>(m_pLinkEditSegment);
     switch (BO(pseglc->cmd))
     {
         case LC_SEGMENT:
         {
             segment_command *seglc = reinterpret_cast<segment_command *>(m_pLinkEditSegment);
-            seglc->vmsize = ByteAlign(BO(seglc->vmsize) + (uNewLength - m_uLength), 4096);
+            seglc->vmsize = (uint32_t)ByteAlign(BO(seglc->vmsize) + (uNewLength - m_uLength), 4096);
             seglc->vmsize = BO(seglc->vmsize);
-            seglc->filesize = uNewLength - BO(seglc->fileoff);
+            seglc->filesize = (uint32_t)(uNewLength - BO(seglc->fileoff));
             seglc->filesize = BO(seglc->filesize);
         }
         break;
         case LC_SEGMENT_64:
         {
             segment_command_64 *seglc = reinterpret_cast<segment_command_64 *>(m_pLinkEditSegment);
-            seglc->vmsize = ByteAlign(BO((uint32_t)seglc->vmsize) + (uNewLength - m_uLength), 4096);
-            seglc->vmsize = BO((uint32_t)seglc->vmsize);
-            seglc->filesize = uNewLength - BO((uint32_t)seglc->fileoff);
-            seglc->filesize = BO((uint32_t)seglc->filesize);
+            seglc->vmsize = ByteAlign(BO(seglc->vmsize) + (uNewLength - m_uLength), 4096);
+            seglc->vmsize = BO(seglc->vmsize);
+            seglc->filesize = uNewLength - BO(seglc->fileoff);
+            seglc->filesize = BO(seglc->filesize);
         }
         break;
     }
@@ -646,29 +967,19 @@ uint32_t ZArchO::ReallocCodeSignSpace(const string &strNewFile)
     codesignature_command *pcslc = reinterpret_cast<codesignature_command *>(m_pCodeSignSegment);
     if (NULL == pcslc)
     {
-        if (m_uLoadCommandsFreeSpace < 4)
-        {
-            ZLog::Error(">>> Can't Find Free Space Of LoadCommands For CodeSignature!\n");
-            return 0;
-        }
-
         pcslc = reinterpret_cast<codesignature_command *>(m_pBase + m_uHeaderSize + BO(m_pHeader->sizeofcmds));
-        pcslc->cmd = BO(LC_CODE_SIGNATURE);
+        pcslc->cmd = BO((uint32_t)LC_CODE_SIGNATURE);
         pcslc->cmdsize = BO((uint32_t)sizeof(codesignature_command));
-        pcslc->dataoff = BO(m_uCodeLength);
+        pcslc->dataoff = BO((uint32_t)m_uCodeLength);
         m_pHeader->ncmds = BO(BO(m_pHeader->ncmds) + 1);
-        m_pHeader->sizeofcmds = BO(BO(m_pHeader->sizeofcmds) + sizeof(codesignature_command));
+        m_pHeader->sizeofcmds = BO(BO(m_pHeader->sizeofcmds) + (uint32_t)sizeof(codesignature_command));
+        m_uLoadCommandsFreeSpace -= sizeof(codesignature_command);
     }
-    pcslc->datasize = BO(uNewLength - m_uCodeLength);
+    pcslc->datasize = BO((uint32_t)(uNewLength - m_uCodeLength));
 
-    if (!AppendFile(strNewFile.c_str(), (const char *)m_pBase, m_uLength))
-    {
-        return 0;
-    }
-
-    string strPadding;
-    strPadding.append(uNewLength - m_uLength, 0);
-    if (!AppendFile(strNewFile.c_str(), strPadding))
+    ZFileWriter writer; // the old blob is dropped, its page hashes predate the new load commands
+    if (!writer.Open(strNewFile.c_str(), uNewLength) || !writer.Write(m_pBase, (size_t)m_uCodeLength) ||
+        !writer.WriteZero(uNewLength - m_uCodeLength) || !writer.Close())
     {
         RemoveFile(strNewFile.c_str());
         return 0;
@@ -705,7 +1016,7 @@ bool ZArchO::InjectDyLib(bool bWeakInject, const char *szDyLibPath, bool &bCreat
                 }
                 else
                 {
-                    ZLog::WarnV(">>> DyLib Is Already Existed! %s\n");
+                    ZLog::WarnV(">>> DyLib Is Already Existed! %s\n", szDyLibPath);
                 }
                 return true;
             }
@@ -716,7 +1027,7 @@ bool ZArchO::InjectDyLib(bool bWeakInject, const char *szDyLibPath, bool &bCreat
     uint32_t uDylibPathLength = (uint32_t)strlen(szDyLibPath);
     uint32_t uDylibPathPadding = (8 - uDylibPathLength % 8);
     uint32_t uDyLibCommandSize = sizeof(dylib_command) + uDylibPathLength + uDylibPathPadding;
-    if (m_uLoadCommandsFreeSpace > 0 && m_uLoadCommandsFreeSpace < uDyLibCommandSize) // some bin doesn't have '__text'
+    if (!ReserveLoadCommandsSpace(uDyLibCommandSize))
     {
         ZLog::Error(">>> Can't Find Free Space Of LoadCommands For LC_LOAD_DYLIB Or LC_LOAD_WEAK_DYLIB!\n");
         return false;
@@ -739,6 +1050,7 @@ bool ZArchO::InjectDyLib(bool bWeakInject, const char *szDyLibPath, bool &bCreat
 
     m_pHeader->ncmds = BO(BO(m_pHeader->ncmds) + 1);
     m_pHeader->sizeofcmds = BO(BO(m_pHeader->sizeofcmds) + uDyLibCommandSize);
+    m_uLoadCommandsFreeSpace -= uDyLibCommandSize;
 
     bCreate = true;
     return true;
@@ -862,3 +1174,54 @@ std::vector<std::string> ZArchO::ListDylibs()
 
     return dylibList;
 }
+
+void ZArchO::GetDependencies(vector<pair<uint32_t, string>> &arrDylibs, vector<string> &arrRPaths)
+{
+    uint8_t *pLoadCommand = m_pBase + m_uHeaderSize;
+    for (uint32_t i = 0; i < BO(m_pHeader->ncmds); i++)
+    {
+        load_command *plc = reinterpret_cast<load_command *>(pLoadCommand);
+        uint32_t uLoadType = BO(plc->cmd);
+        uint32_t uCmdSize = BO(plc->cmdsize);
+        uint32_t uNameOffset = 0;
+        if (LC_LOAD_DYLIB == uLoadType || LC_LOAD_WEAK_DYLIB == uLoadType || LC_REEXPORT_DYLIB == uLoadType ||
+            LC_LAZY_LOAD_DYLIB == uLoadType || LC_LOAD_UPWARD_DYLIB == uLoadType)
+        {
+            uNameOffset = BO(reinterpret_cast<dylib_command *>(pLoadCommand)->dylib.name.offset);
+        }
+        else if (LC_RPATH == uLoadType)
+        {
+            uNameOffset = BO(reinterpret_cast<rpath_command *>(pLoadCommand)->path.offset);
+        }
+
+        if (uNameOffset > 0 && uNameOffset < uCmdSize)
+        {
+            const char *szName = reinterpret_cast<const char *>(pLoadCommand + uNameOffset);
+            string strName(szName, strnlen(szName, uCmdSize - uNameOffset));
+            if (LC_RPATH == uLoadType)
+            {
+                arrRPaths.push_back(strName);
+            }
+            else
+            {
+                arrDylibs.push_back(make_pair(uLoadType, strName));
+            }
+        }
+        pLoadCommand += uCmdSize;
+    }
+}
+
+void ZArchO::SetPageSize(uint32_t uPageSize) { m_uPageSize = uPageSize; }
+
+void ZArchO::SetSignatureSlack(uint32_t uSlack) { m_uSignSlack = uSlack; }
+
+uint32_t ZArchO::GetPageSize() const
+{
+    if (4096 == m_uPageSize || 16384 == m_uPageSize)
+    {
+        return m_uPageSize;
+    }
+
+    // arm64 kernels map 16 KiB pages, everything else still pages in 4 KiB
+    return (NULL != m_pHeader && CPU_TYPE_ARM64 == (int)BO((uint32_t)m_pHeader->cputype)) ? 16384 : 4096;
+}
@@ -11,6 +11,9 @@
 #include "common/mach-o.h"
 #include "openssl.h"
 #include <set>
+
+#define CODESIGN_SLACK_DEFAULT 4096
+
 /**
  * Class for manipulating Mach-O architecture files
  */
@@ -29,7 +32,7 @@ class ZArchO
      * @param uLength Length of the binary data in bytes
      * @return true if initialization succeeded, false otherwise
      */
-    bool Init(uint8_t *pBase, uint32_t uLength);
+    bool Init(uint8_t *pBase, uint64_t uLength);
 
   public:
     /**
@@ -41,10 +44,11 @@ class ZArchO
      * @param strInfoPlistSHA1 SHA1 hash of the Info.plist file
      * @param strInfoPlistSHA256 SHA256 hash of the Info.plist file
      * @param strCodeResourcesData Code resources data
+     * @param bSHA256Only Emit a single SHA-256 CodeDirectory instead of SHA-1 plus an alternate SHA-256 one
      * @return true if signing succeeded, false otherwise
      */
     bool Sign(ZSignAsset *pSignAsset, bool bForce, const string &strBundleId, const string &strInfoPlistSHA1,
-              const string &strInfoPlistSHA256, const string &strCodeResourcesData);
+              const string &strInfoPlistSHA256, const string &strCodeResourcesData, bool bSHA256Only = false);
 
     /**
      * Prints information about the Mach-O binary
@@ -72,9 +76,9 @@ class ZArchO
      * Reallocates code signing space
      *
      * @param strNewFile Path to the new file
-     * @return The size of the reallocated space
+     * @return The size of the reallocated space, 0 on failure
      */
-    uint32_t ReallocCodeSignSpace(const string &strNewFile);
+    uint64_t ReallocCodeSignSpace(const string &strNewFile);
 
     /**
      * Uninstalls dylibs from the binary
@@ -99,6 +103,46 @@ class ZArchO
      */
     std::vector<std::string> ListDylibs();
 
+    /**
+     * Lists the dylib load commands and run paths of the binary
+     *
+     * @param arrDylibs Receives (load command, path) pairs in load order
+     * @param arrRPaths Receives the LC_RPATH entries in search order
+     */
+    void GetDependencies(vector<pair<uint32_t, string>> &arrDylibs, vector<string> &arrRPaths);
+
+    /**
+     * Sets the code page size hashed into the CodeDirectory
+     *
+     * @param uPageSize 4096 or 16384, 0 picks 16 KiB for arm64 slices and 4 KiB for the rest
+     */
+    void SetPageSize(uint32_t uPageSize);
+
+    /**
+     * Gets the code page size used for signing, with the default resolved for this slice
+     *
+     * @return Page size in bytes
+     */
+    uint32_t GetPageSize() const;
+
+    /**
+     * Sets the spare bytes kept after the signature blob when its space is right-sized
+     *
+     * @param uSlack Bytes of headroom left for later re-signs with a larger blob
+     */
+    void SetSignatureSlack(uint32_t uSlack);
+
+    /**
+     * Estimates the size of the next signature blob from the code length, entitlements, requirements
+     * and the CMS size of the signing asset
+     *
+     * @param pSignAsset Signing asset the blob is built with
+     * @param strBundleId Bundle identifier recorded in the CodeDirectory
+     * @param bSHA256Only Whether the new signature drops the SHA-1 CodeDirectory
+     * @return Estimated blob size, 0 when the CMS size can't be known before signing
+     */
+    uint32_t EstimateSignLength(ZSignAsset *pSignAsset, const string &strBundleId, bool bSHA256Only);
+
   private:
     /**
      * Byte-order swaps a value if needed
@@ -107,6 +151,7 @@ class ZArchO
      * @return Byte-swapped value if big-endian, original value if little-endian
      */
     uint32_t BO(uint32_t uValue) const;
+    uint64_t BO(uint64_t uValue) const;
 
     /**
      * Gets the file type name for a file type code
@@ -125,6 +170,24 @@ class ZArchO
      */
     static const char *GetArch(int cpuType, int cpuSubType);
 
+    /**
+     * Makes room for a new load command, dropping commands dyld doesn't need
+     * (LC_DYLIB_CODE_SIGN_DRS, LC_SOURCE_VERSION, LC_DATA_IN_CODE, decrypted LC_ENCRYPTION_INFO)
+     * when the padding before the first section is too small
+     *
+     * @param uSize Size of the load command to add
+     * @return true if at least uSize bytes are free after the load commands
+     */
+    bool ReserveLoadCommandsSpace(uint32_t uSize);
+
+    /**
+     * Checks if a load command can be removed without changing how the binary loads
+     *
+     * @param pLoadCommand Pointer to the load command
+     * @return true if the command can be dropped
+     */
+    bool IsDroppableLoadCommand(uint8_t *pLoadCommand) const;
+
     /**
      * Builds code signature for the binary
      *
@@ -135,23 +198,47 @@ class ZArchO
      * @param strInfoPlistSHA256 SHA256 hash of the Info.plist file
      * @param strCodeResourcesSHA1 SHA1 hash of code resources
      * @param strCodeResourcesSHA256 SHA256 hash of code resources
+     * @param bSHA256Only Emit a single SHA-256 CodeDirectory
      * @param strOutput Reference to output string
      * @return true if building succeeded, false otherwise
      */
     bool BuildCodeSignature(ZSignAsset *pSignAsset, bool bForce, const string &strBundleId,
                             const string &strInfoPlistSHA1, const string &strInfoPlistSHA256,
                             const string &strCodeResourcesSHA1, const string &strCodeResourcesSHA256,
-                            string &strOutput);
+                            bool bSHA256Only, string &strOutput);
+
+    /**
+     * Copies a signature blob into the signature space and zeroes the rest of it
+     *
+     * @param strCodeSignBlob Signature blob to write
+     * @return true if the blob fits, false otherwise
+     */
+    bool WriteCodeSignature(const string &strCodeSignBlob);
+
+    /**
+     * Shrinks LC_CODE_SIGNATURE and __LINKEDIT of an already signed slice to a blob of the given size plus
+     * the slack, when the signature ends the slice. m_uLength becomes the length the slice should be truncated to.
+     *
+     * @param uSignLength Size of the signature blob that has to fit
+     * @return true if the load commands were changed, false if the slice was left as is
+     */
+    bool CompactCodeSignSpace(uint32_t uSignLength);
+
+    /**
+     * Rehashes the code pages holding the load commands inside the existing signature,
+     * so the one build that follows compaction can reuse every other page hash
+     */
+    void RehashLoadCommandsSlots();
 
   public:
     /** Pointer to the base of the Mach-O binary data */
     uint8_t *m_pBase;
 
     /** Total length of the binary data */
-    uint32_t m_uLength;
+    uint64_t m_uLength;
 
     /** Length of the code section */
-    uint32_t m_uCodeLength;
+    uint64_t m_uCodeLength;
 
     /** Pointer to the signature section base */
     uint8_t *m_pSignBase;
@@ -188,4 +275,19 @@ class ZArchO
 
     /** Size of the Mach-O header */
     uint32_t m_uHeaderSize;
+
+    /** Requested code page size, 0 for the per-architecture default */
+    uint32_t m_uPageSize;
+
+    /** Spare bytes kept after the signature blob when its space is compacted */
+    uint32_t m_uSignSlack;
+
+    /** Size of the signature blob, built or estimated, that a realloc sizes the new space for */
+    uint32_t m_uNeedSignLength;
+
+    /** vmsize of this slice's __TEXT, recorded as the CodeDirectory execSegLimit */
+    uint64_t m_uExecSegLimit;
+
+    /** CDHash of the last built signature, taken from the strongest CodeDirectory */
+    string m_strCDHash;
 };
@@ -13,64 +13,165 @@
 #include "bundle.h"
 #include "common/base64.h"
 #include "common/common.h"
+#include "common/dirwalk.h"
 #include "macho.h"
+#include "resrules.h"
+#include "signing.h"
 #include "sys/stat.h"
 #include "sys/types.h"
+#include <atomic>
+#include <functional>
+#include <thread>
 
 ZAppBundle::ZAppBundle()
 {
     m_pSignAsset = NULL;
     m_bForceSign = false;
     m_bWeakInject = false;
+    m_bSHA256Only = false;
+    m_uPageSize = 0;
+    m_uSignSlack = CODESIGN_SLACK_DEFAULT;
 }
 
-bool ZAppBundle::FindAppFolder(const string &strFolder, string &strAppFolder)
+static void _PushPath(string &strPath, const char *szName)
 {
-    if (IsPathSuffix(strFolder, ".app") || IsPathSuffix(strFolder, ".appex"))
+    strPath += "/";
+    strPath += szName;
+}
+
+static void _PopPath(string &strPath, size_t uLength) { strPath.resize(uLength); }
+
+static bool _PathLess(const char *szPath1, const char *szPath2) { return (strcmp(szPath1, szPath2) < 0); }
+
+static bool _DirFileLess(const ZDirFile &file1, const ZDirFile &file2) { return _PathLess(file1.szPath, file2.szPath); }
+
+static bool _IsInsideFolders(const char *szPath, const set<string> &setFolders)
+{
+    for (const char *szSlash = strchr(szPath, '/'); NULL != szSlash; szSlash = strchr(szSlash + 1, '/'))
     {
-        strAppFolder = strFolder;
-        return true;
+        if (setFolders.find(string(szPath, szSlash - szPath)) != setFolders.end())
+        {
+            return true;
+        }
     }
+    return false;
+}
+
+static string _NormalizePath(const string &strPath)
+{
+    vector<string> arrParts;
+    StringSplit(strPath, "/", arrParts);
 
-    DIR *dir = opendir(strFolder.c_str());
-    if (NULL != dir)
+    vector<string> arrResult;
+    for (size_t i = 0; i < arrParts.size(); i++)
     {
-        dirent *ptr = readdir(dir);
-        while (NULL != ptr)
+        if (".." == arrParts[i])
         {
-            if (0 != strcmp(ptr->d_name, ".") && 0 != strcmp(ptr->d_name, "..") && 0 != strcmp(ptr->d_name, "__MACOSX"))
+            if (!arrResult.empty())
             {
-                bool isdir = false;
-                if (DT_DIR == ptr->d_type)
-                {
-                    isdir = true;
-                }
-                else if (DT_UNKNOWN == ptr->d_type)
-                {
-                    // Entry type can be unknown depending on the underlying file system
-                    ZLog::DebugV(">>> Unknown directory entry type for %s, falling back to POSIX-compatible check\n",
-                                 strFolder.c_str());
-                    struct stat statbuf;
-                    stat(strFolder.c_str(), &statbuf);
-                    if (S_ISDIR(statbuf.st_mode))
-                    {
-                        isdir = true;
-                    }
-                }
-                if (isdir)
+                arrResult.pop_back();
+            }
+        }
+        else if (!arrParts[i].empty() && "." != arrParts[i])
+        {
+            arrResult.push_back(arrParts[i]);
+        }
+    }
+
+    string strResult;
+    for (size_t i = 0; i < arrResult.size(); i++)
+    {
+        strResult += "/" + arrResult[i];
+    }
+    return strResult;
+}
+
+static bool _IsSHA256OnlyTarget(const string &strMinimumOSVersion)
+{ // every iOS release from 11 on validates SHA-256 code directories and resource seals by themselves
+    return (!strMinimumOSVersion.empty() && atoi(strMinimumOSVersion.c_str()) >= 11);
+}
+
+static bool _ParallelFor(size_t uCount, const function<bool(size_t)> &fnWork)
+{
+    size_t uThreads = min((size_t)thread::hardware_concurrency(), uCount);
+    if (uThreads <= 1)
+    {
+        for (size_t i = 0; i < uCount; i++)
+        {
+            if (!fnWork(i))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    atomic<size_t> uNext(0);
+    atomic<bool> bFailed(false);
+    vector<thread> arrThreads;
+    for (size_t i = 0; i < uThreads; i++)
+    {
+        arrThreads.emplace_back([&]() {
+            for (size_t uIndex = uNext++; uIndex < uCount && !bFailed; uIndex = uNext++)
+            {
+                if (!fnWork(uIndex))
                 {
-                    string strSubFolder = strFolder;
-                    strSubFolder += "/";
-                    strSubFolder += ptr->d_name;
-                    if (FindAppFolder(strSubFolder, strAppFolder))
-                    {
-                        return true;
-                    }
+                    bFailed = true;
                 }
             }
-            ptr = readdir(dir);
+        });
+    }
+    for (size_t i = 0; i < arrThreads.size(); i++)
+    {
+        arrThreads[i].join();
+    }
+    return !bFailed;
+}
+
+bool ZAppBundle::FindAppFolder(const string &strFolder, string &strAppFolder)
+{
+    if (IsPathSuffix(strFolder, ".app") || IsPathSuffix(strFolder, ".appex"))
+    {
+        strAppFolder = strFolder;
+        return true;
+    }
+
+    ZDirReader dir;
+    if (!dir.Open(strFolder.c_str()))
+    {
+        return false;
+    }
+
+    string strPath = strFolder;
+    return FindAppFolderAt(dir, strPath, strAppFolder);
+}
+
+bool ZAppBundle::FindAppFolderAt(ZDirReader &dir, string &strPath, string &strAppFolder)
+{
+    size_t uLength = strPath.size();
+    const char *szName = NULL;
+    bool bFolder = false;
+    bool bFile = false;
+    while (dir.Read(szName, bFolder, bFile))
+    {
+        if (!bFolder || 0 == strcmp(szName, "__MACOSX"))
+        {
+            continue;
+        }
+
+        _PushPath(strPath, szName);
+        if (IsPathSuffix(strPath, ".app") || IsPathSuffix(strPath, ".appex"))
+        {
+            strAppFolder = strPath;
+            return true;
+        }
+
+        ZDirReader subdir;
+        if (subdir.OpenAt(dir.GetFD(), szName) && FindAppFolderAt(subdir, strPath, strAppFolder))
+        {
+            return true;
         }
-        closedir(dir);
+        _PopPath(strPath, uLength);
     }
     return false;
 }
@@ -115,125 +216,236 @@ bool ZAppBundle::GetSignFolderInfo(const string &strFolder, JValue &jvNode, bool
 
 bool ZAppBundle::GetObjectsToSign(const string &strFolder, JValue &jvInfo)
 {
-    DIR *dir = opendir(strFolder.c_str());
-    if (NULL != dir)
+    ZDirReader dir;
+    if (dir.Open(strFolder.c_str()))
+    {
+        string strPath = strFolder;
+        GetObjectsToSignAt(dir, strPath, jvInfo);
+    }
+    return true;
+}
+
+void ZAppBundle::GetObjectsToSignAt(ZDirReader &dir, string &strPath, JValue &jvInfo)
+{
+    size_t uLength = strPath.size();
+    const char *szName = NULL;
+    bool bFolder = false;
+    bool bFile = false;
+    while (dir.Read(szName, bFolder, bFile))
     {
-        dirent *ptr = readdir(dir);
-        while (NULL != ptr)
+        _PushPath(strPath, szName);
+        if (bFolder)
         {
-            if (0 != strcmp(ptr->d_name, ".") && 0 != strcmp(ptr->d_name, ".."))
+            ZDirReader subdir;
+            if (subdir.OpenAt(dir.GetFD(), szName))
             {
-                string strNode = strFolder + "/" + ptr->d_name;
-                if (DT_DIR == ptr->d_type)
+                if (IsPathSuffix(strPath, ".app") || IsPathSuffix(strPath, ".appex") ||
+                    IsPathSuffix(strPath, ".framework") || IsPathSuffix(strPath, ".xctest"))
                 {
-                    if (IsPathSuffix(strNode, ".app") || IsPathSuffix(strNode, ".appex") ||
-                        IsPathSuffix(strNode, ".framework") || IsPathSuffix(strNode, ".xctest"))
-                    {
-                        JValue jvNode;
-                        jvNode["path"] = strNode.substr(m_strAppFolder.size() + 1);
-                        if (GetSignFolderInfo(strNode, jvNode))
-                        {
-                            if (GetObjectsToSign(strNode, jvNode))
-                            {
-                                jvInfo["folders"].push_back(jvNode);
-                            }
-                        }
-                    }
-                    else
+                    JValue jvNode;
+                    jvNode["path"] = strPath.substr(m_strAppFolder.size() + 1);
+                    if (GetSignFolderInfo(strPath, jvNode))
                     {
-                        GetObjectsToSign(strNode, jvInfo);
+                        GetObjectsToSignAt(subdir, strPath, jvNode);
+                        jvInfo["folders"].push_back(std::move(jvNode));
                     }
                 }
-                else if (DT_REG == ptr->d_type)
+                else
                 {
-                    if (IsPathSuffix(strNode, ".dylib"))
-                    {
-                        jvInfo["files"].push_back(strNode.substr(m_strAppFolder.size() + 1));
-                    }
+                    GetObjectsToSignAt(subdir, strPath, jvInfo);
                 }
             }
-            ptr = readdir(dir);
         }
-        closedir(dir);
+        else if (bFile)
+        {
+            if (IsPathSuffix(strPath, ".dylib"))
+            {
+                jvInfo["files"].push_back(strPath.substr(m_strAppFolder.size() + 1));
+            }
+        }
+        _PopPath(strPath, uLength);
     }
-    return true;
 }
 
-void ZAppBundle::GetFolderFiles(const string &strFolder, const string &strBaseFolder, set<string> &setFiles)
+void ZAppBundle::GetFolderFiles(const string &strFolder, const set<string> &setSkipFolders, ZPathArena &arena,
+                                vector<ZDirFile> &arrFiles)
 {
-    DIR *dir = opendir(strFolder.c_str());
-    if (NULL != dir)
+    ZDirReader dir;
+    if (dir.Open(strFolder.c_str()))
     {
-        dirent *ptr = readdir(dir);
-        while (NULL != ptr)
+        string strPath;
+        GetFolderFilesAt(dir, strPath, setSkipFolders, arena, arrFiles);
+    }
+}
+
+void ZAppBundle::GetFolderFilesAt(ZDirReader &dir, string &strPath, const set<string> &setSkipFolders,
+                                  ZPathArena &arena, vector<ZDirFile> &arrFiles)
+{
+    size_t uLength = strPath.size();
+    const char *szName = NULL;
+    bool bFolder = false;
+    bool bFile = false;
+    while (dir.Read(szName, bFolder, bFile))
+    {
+        if (uLength > 0)
+        {
+            strPath += "/";
+        }
+        strPath += szName;
+
+        if (bFolder)
         {
-            if (0 != strcmp(ptr->d_name, ".") && 0 != strcmp(ptr->d_name, ".."))
+            ZDirReader subdir;
+            if (setSkipFolders.find(strPath) == setSkipFolders.end() && subdir.OpenAt(dir.GetFD(), szName))
             {
-                string strNode = strFolder;
-                strNode += "/";
-                strNode += ptr->d_name;
-                if (DT_DIR == ptr->d_type)
-                {
-                    GetFolderFiles(strNode, strBaseFolder, setFiles);
-                }
-                else if (DT_REG == ptr->d_type)
-                {
-                    setFiles.insert(strNode.substr(strBaseFolder.size() + 1));
-                }
+                GetFolderFilesAt(subdir, strPath, setSkipFolders, arena, arrFiles);
             }
-            ptr = readdir(dir);
         }
-        closedir(dir);
+        else if (bFile)
+        {
+            ZDirFile file = {arena.Intern(strPath), dir.GetDevice(), dir.GetInode()};
+            arrFiles.push_back(file);
+        }
+        _PopPath(strPath, uLength);
     }
 }
 
-bool ZAppBundle::GenerateCodeResources(const string &strFolder, JValue &jvCodeRes)
+bool ZAppBundle::GenerateCodeResources(const string &strFolder, const JValue &jvNode, const JValue &jvOldCodeRes,
+                                       JValue &jvCodeRes)
 {
     jvCodeRes.clear();
 
-    set<string> setFiles;
-    GetFolderFiles(strFolder, strFolder, setFiles);
+    if (jvOldCodeRes["rules"].isObject() && jvOldCodeRes["rules2"].isObject())
+    { // keep custom rules of the existing seal
+        jvCodeRes["rules"] = jvOldCodeRes["rules"];
+        jvCodeRes["rules2"] = jvOldCodeRes["rules2"];
+    }
+    else
+    {
+        ZResourceRules::GetDefaultRules(jvCodeRes["rules"]);
+        ZResourceRules::GetDefaultRules2(jvCodeRes["rules2"]);
+    }
 
-    JValue jvInfo;
-    string strInfoPlistPath = strFolder + "/Info.plist";
-    jvInfo.readPListFile(strInfoPlistPath.c_str());
-    string strBundleExe = jvInfo["CFBundleExecutable"];
-    setFiles.erase(strBundleExe);
-    setFiles.erase("_CodeSignature/CodeResources");
+    ZResourceRules rules;
+    ZResourceRules rules2;
+    if (!rules.Compile(jvCodeRes["rules"]) || !rules2.Compile(jvCodeRes["rules2"]))
+    {
+        ZLog::ErrorV(">>> Can't Compile CodeResources Rules! %s\n", strFolder.c_str());
+        return false;
+    }
 
     jvCodeRes["files"] = JValue(JValue::E_OBJECT);
     jvCodeRes["files2"] = JValue(JValue::E_OBJECT);
 
-    for (set<string>::iterator it = setFiles.begin(); it != setFiles.end(); ++it)
+    set<string> setNested; // signed child bundles are sealed by their cdhash in files2, file by file in files
+    map<string, string> mapNestedExe;
+    string strNodePath = jvNode["path"];
+    for (size_t i = 0; i < jvNode["folders"].size(); i++)
     {
-        string strKey = *it;
-        string strFile = strFolder + "/" + strKey;
-        string strFileSHA1Base64;
-        string strFileSHA256Base64;
-        SHASumBase64File(strFile.c_str(), strFileSHA1Base64, strFileSHA256Base64);
+        const JValue &jvSubNode = jvNode["folders"][i];
+        string strKey = jvSubNode["path"];
+        if ("/" != strNodePath)
+        {
+            strKey = strKey.substr(strNodePath.size() + 1);
+        }
+
+        uint32_t uFlags = 0;
+        if (jvSubNode.has("cdhash") && rules2.Match(strKey.c_str(), uFlags) &&
+            (uFlags & ZResourceRules::E_RULE_NESTED) && !(uFlags & ZResourceRules::E_RULE_OMIT))
+        {
+            setNested.insert(strKey);
+            mapNestedExe[strKey] = jvSubNode["exec"].asString();
+            jvCodeRes["files2"][strKey]["cdhash"] = jvSubNode["cdhash"];
+            jvCodeRes["files2"][strKey]["requirement"] = jvSubNode["requirement"];
+        }
+    }
 
-        bool bomit1 = false;
-        bool bomit2 = false;
+    ZPathArena arena;
+    vector<ZDirFile> arrFiles;
+    set<string> setSkip; // nested bundles that are not walked again
+    for (map<string, string>::iterator it = mapNestedExe.begin(); it != mapNestedExe.end(); it++)
+    {
+        if (m_bSHA256Only)
+        { // no v1 seal, the cdhash in files2 covers the whole child
+            setSkip.insert(it->first);
+            continue;
+        }
 
-        if ("Info.plist" == strKey || "PkgInfo" == strKey)
+        JValue jvNestedCodeRes; // the child was signed first, its v1 seal already lists its files
+        string strNestedCodeRes = strFolder + "/" + it->first + "/_CodeSignature/CodeResources";
+        if (!jvNestedCodeRes.readPListFile(strNestedCodeRes.c_str()) || !jvNestedCodeRes["files"].isObject())
         {
-            bomit2 = true;
+            continue;
         }
 
-        if (IsPathSuffix(strKey, ".DS_Store"))
+        vector<string> arrKeys;
+        jvNestedCodeRes["files"].keys(arrKeys);
+        for (size_t i = 0; i < arrKeys.size(); i++)
         {
-            bomit2 = true;
+            string strKey = it->first + "/" + arrKeys[i];
+            uint32_t uFlags1 = 0;
+            if (!rules.Match(strKey.c_str(), uFlags1) || (uFlags1 & ZResourceRules::E_RULE_OMIT))
+            {
+                continue;
+            }
+
+            const JValue &jvEntry = jvNestedCodeRes["files"][arrKeys[i]];
+            const JValue &jvHash = jvEntry.isObject() ? jvEntry["hash"] : jvEntry;
+            if (uFlags1 & ZResourceRules::E_RULE_OPTIONAL)
+            {
+                jvCodeRes["files"][strKey]["hash"] = jvHash;
+                jvCodeRes["files"][strKey]["optional"] = true;
+            }
+            else
+            {
+                jvCodeRes["files"][strKey] = jvHash;
+            }
         }
 
-        if (IsPathSuffix(strKey, ".lproj/locversion.plist"))
+        // the child's executable and its own seal are the only files that seal leaves out
+        ZDirFile fileExe = {arena.Intern(it->first + "/" + it->second), 0, 0};
+        ZDirFile fileCodeRes = {arena.Intern(it->first + "/_CodeSignature/CodeResources"), 0, 0};
+        arrFiles.push_back(fileExe);
+        arrFiles.push_back(fileCodeRes);
+        setSkip.insert(it->first);
+    }
+    GetFolderFiles(strFolder, setSkip, arena, arrFiles);
+    sort(arrFiles.begin(), arrFiles.end(), _DirFileLess);
+
+    JValue jvInfo;
+    string strInfoPlistPath = strFolder + "/Info.plist";
+    jvInfo.readPListFile(strInfoPlistPath.c_str());
+    string strBundleExe = jvInfo["CFBundleExecutable"];
+
+    ZSHASumCache shaCache(!m_bSHA256Only); // hardlinks share one digest, found by the file id of the walk
+    for (size_t i = 0; i < arrFiles.size(); i++)
+    {
+        const char *szKey = arrFiles[i].szPath;
+        string strKey = szKey;
+        if (strBundleExe == strKey || "_CodeSignature/CodeResources" == strKey)
         {
-            bomit1 = true;
-            bomit2 = true;
+            continue;
         }
 
-        if (!bomit1)
+        uint32_t uFlags1 = 0;
+        uint32_t uFlags2 = 0;
+        bool bomit1 = m_bSHA256Only || !rules.Match(szKey, uFlags1) || (uFlags1 & ZResourceRules::E_RULE_OMIT);
+        bool bomit2 = !rules2.Match(szKey, uFlags2) || (uFlags2 & ZResourceRules::E_RULE_OMIT) ||
+                      _IsInsideFolders(szKey, setNested);
+        if (bomit1 && bomit2)
         {
-            if (string::npos != strKey.rfind(".lproj/"))
+            continue;
+        }
+
+        string strFile = strFolder + "/" + strKey;
+        string strFileSHA1Base64;
+        string strFileSHA256Base64;
+        shaCache.SHASumBase64File(strFile.c_str(), arrFiles[i].uDevice, arrFiles[i].uInode, strFileSHA1Base64,
+                                  strFileSHA256Base64);
+
+        if (!bomit1)
+        { // the v1 seal is SHA-1 only, a SHA-256 only bundle omits every file from it
+            if (uFlags1 & ZResourceRules::E_RULE_OPTIONAL)
             {
                 jvCodeRes["files"][strKey]["hash"] = "data:" + strFileSHA1Base64;
                 jvCodeRes["files"][strKey]["optional"] = true;
@@ -246,49 +458,32 @@ bool ZAppBundle::GenerateCodeResources(const string &strFolder, JValue &jvCodeRe
 
         if (!bomit2)
         {
-            jvCodeRes["files2"][strKey]["hash"] = "data:" + strFileSHA1Base64;
+            if (!m_bSHA256Only)
+            {
+                jvCodeRes["files2"][strKey]["hash"] = "data:" + strFileSHA1Base64;
+            }
             jvCodeRes["files2"][strKey]["hash2"] = "data:" + strFileSHA256Base64;
-            if (string::npos != strKey.rfind(".lproj/"))
+            if (uFlags2 & ZResourceRules::E_RULE_OPTIONAL)
             {
                 jvCodeRes["files2"][strKey]["optional"] = true;
             }
         }
     }
 
-    jvCodeRes["rules"]["^.*"] = true;
-    jvCodeRes["rules"]["^.*\\.lproj/"]["optional"] = true;
-    jvCodeRes["rules"]["^.*\\.lproj/"]["weight"] = 1000.0;
-    jvCodeRes["rules"]["^.*\\.lproj/locversion.plist$"]["omit"] = true;
-    jvCodeRes["rules"]["^.*\\.lproj/locversion.plist$"]["weight"] = 1100.0;
-    jvCodeRes["rules"]["^Base\\.lproj/"]["weight"] = 1010.0;
-    jvCodeRes["rules"]["^version.plist$"] = true;
-
-    jvCodeRes["rules2"]["^.*"] = true;
-    jvCodeRes["rules2"][".*\\.dSYM($|/)"]["weight"] = 11.0;
-    jvCodeRes["rules2"]["^(.*/)?\\.DS_Store$"]["omit"] = true;
-    jvCodeRes["rules2"]["^(.*/)?\\.DS_Store$"]["weight"] = 2000.0;
-    jvCodeRes["rules2"]["^.*\\.lproj/"]["optional"] = true;
-    jvCodeRes["rules2"]["^.*\\.lproj/"]["weight"] = 1000.0;
-    jvCodeRes["rules2"]["^.*\\.lproj/locversion.plist$"]["omit"] = true;
-    jvCodeRes["rules2"]["^.*\\.lproj/locversion.plist$"]["weight"] = 1100.0;
-    jvCodeRes["rules2"]["^Base\\.lproj/"]["weight"] = 1010.0;
-    jvCodeRes["rules2"]["^Info\\.plist$"]["omit"] = true;
-    jvCodeRes["rules2"]["^Info\\.plist$"]["weight"] = 20.0;
-    jvCodeRes["rules2"]["^PkgInfo$"]["omit"] = true;
-    jvCodeRes["rules2"]["^PkgInfo$"]["weight"] = 20.0;
-    jvCodeRes["rules2"]["^embedded\\.provisionprofile$"]["weight"] = 20.0;
-    jvCodeRes["rules2"]["^version\\.plist$"]["weight"] = 20.0;
+    ZLog::DebugV(">>> CodeResources: %lu files, %lu hashed, %lu hardlinked, %lu nested\n", arrFiles.size(),
+                 shaCache.GetHashedCount(), shaCache.GetSharedCount(), setNested.size());
 
     return true;
 }
 
-void ZAppBundle::GetChangedFiles(JValue &jvNode, vector<string> &arrChangedFiles)
-{
+void ZAppBundle::GetNodeChangedFiles(JValue &jvNode, bool dontGenerateEmbeddedMobileProvision)
+{ // children first, so a node extends each child's list instead of walking its subtree again
+    JValue jvChanged(JValue::E_ARRAY);
     if (jvNode.has("files"))
     {
         for (size_t i = 0; i < jvNode["files"].size(); i++)
         {
-            arrChangedFiles.push_back(jvNode["files"][i]);
+            jvChanged.push_back(jvNode["files"][i]);
         }
     }
 
@@ -297,38 +492,33 @@ void ZAppBundle::GetChangedFiles(JValue &jvNode, vector<string> &arrChangedFiles
         for (size_t i = 0; i < jvNode["folders"].size(); i++)
         {
             JValue &jvSubNode = jvNode["folders"][i];
-            GetChangedFiles(jvSubNode, arrChangedFiles);
-            string strPath = jvSubNode["path"];
-            arrChangedFiles.push_back(strPath + "/_CodeSignature/CodeResources");
-            arrChangedFiles.push_back(strPath + "/" + jvSubNode["exec"].asString());
-        }
-    }
-}
+            GetNodeChangedFiles(jvSubNode, dontGenerateEmbeddedMobileProvision);
 
-void ZAppBundle::GetNodeChangedFiles(JValue &jvNode, bool dontGenerateEmbeddedMobileProvision)
-{
-    if (jvNode.has("folders"))
-    {
-        for (size_t i = 0; i < jvNode["folders"].size(); i++)
-        {
-            GetNodeChangedFiles(jvNode["folders"][i], dontGenerateEmbeddedMobileProvision);
+            if (jvSubNode.has("changed"))
+            {
+                for (size_t j = 0; j < jvSubNode["changed"].size(); j++)
+                {
+                    jvChanged.push_back(jvSubNode["changed"][j]);
+                }
+            }
+            string strPath = jvSubNode["path"];
+            jvChanged.emplace_back() = strPath + "/_CodeSignature/CodeResources";
+            jvChanged.emplace_back() = strPath + "/" + jvSubNode["exec"].asString();
         }
     }
 
-    vector<string> arrChangedFiles;
-    GetChangedFiles(jvNode, arrChangedFiles);
-    for (size_t i = 0; i < arrChangedFiles.size(); i++)
-    {
-        jvNode["changed"].push_back(arrChangedFiles[i]);
-    }
     // TODO: try
     if (dontGenerateEmbeddedMobileProvision)
     {
         if ("/" == jvNode["path"])
         { // root
-            jvNode["changed"].push_back("embedded.mobileprovision");
+            jvChanged.push_back("embedded.mobileprovision");
         }
     }
+    if (jvChanged.size() > 0)
+    {
+        jvNode.emplace("changed", std::move(jvChanged));
+    }
 }
 
 bool ZAppBundle::SignNode(JValue &jvNode)
@@ -345,20 +535,15 @@ bool ZAppBundle::SignNode(JValue &jvNode)
     }
 
     if (jvNode.has("files"))
-    {
+    { // loose dylibs don't depend on each other's signatures
+        vector<string> arrFiles;
         for (size_t i = 0; i < jvNode["files"].size(); i++)
         {
-            const char *szFile = jvNode["files"][i].asCString();
-            ZLog::PrintV(">>> SignFile: \t%s\n", szFile);
-            ZMachO macho;
-            if (!macho.InitV("%s/%s", m_strAppFolder.c_str(), szFile))
-            {
-                return false;
-            }
-            if (!macho.Sign(m_pSignAsset, m_bForceSign, "", "", "", ""))
-            {
-                return false;
-            }
+            arrFiles.push_back(jvNode["files"][i].asCString());
+        }
+        if (!_ParallelFor(arrFiles.size(), [&](size_t i) { return SignFile(arrFiles[i]); }))
+        {
+            return false;
         }
     }
 
@@ -405,15 +590,20 @@ bool ZAppBundle::SignNode(JValue &jvNode)
                  strBundleExe.c_str());
 
     ZMachO macho;
+    macho.SetPageSize(m_uPageSize);
+    macho.SetSignatureSlack(m_uSignSlack);
     if (!macho.Init(strExePath.c_str()))
     {
         ZLog::ErrorV(">>> Can't Parse BundleExecute File! %s\n", strExePath.c_str());
         return false;
     }
 
+    string strCodeResFile = strBaseFolder + "/_CodeSignature/CodeResources";
+    JValue jvOldCodeRes;
+    jvOldCodeRes.readPListFile(strCodeResFile.c_str());
+
     RemoveFolderV("%s/_CodeSignature", strBaseFolder.c_str());
     CreateFolderV("%s/_CodeSignature", strBaseFolder.c_str());
-    string strCodeResFile = strBaseFolder + "/_CodeSignature/CodeResources";
 
     JValue jvCodeRes;
     if (!m_bForceSign)
@@ -423,7 +613,7 @@ bool ZAppBundle::SignNode(JValue &jvNode)
 
     if (m_bForceSign || jvCodeRes.isNull())
     { // create
-        if (!GenerateCodeResources(strBaseFolder, jvCodeRes))
+        if (!GenerateCodeResources(strBaseFolder, jvNode, jvOldCodeRes, jvCodeRes))
         {
             ZLog::ErrorV(">>> Create CodeResources Failed! %s\n", strBaseFolder.c_str());
             return false;
@@ -470,41 +660,442 @@ bool ZAppBundle::SignNode(JValue &jvNode)
     { // inject dylib
         macho.InjectDyLib(m_bWeakInject, m_strDyLibPath.c_str(), bForceSign);
     }
+    ApplyDylibEdits(macho, strExePath, "/" == strFolder, bForceSign);
 
-    if (!macho.Sign(m_pSignAsset, bForceSign, strBundleId, strInfoPlistSHA1, strInfoPlistSHA256, strCodeResData))
+    if (!macho.Sign(m_pSignAsset, bForceSign, strBundleId, strInfoPlistSHA1, strInfoPlistSHA256, strCodeResData,
+                    m_bSHA256Only))
     {
         return false;
     }
 
+    string strCDHash;
+    if (macho.GetCDHash(strCDHash))
+    { // for the parent's CodeResources
+        string strRequirement;
+        GetRequirementsText(strBundleId, m_pSignAsset->m_strSubjectCN, strCDHash, strRequirement);
+        jvNode["cdhash"].assignData(strCDHash.data(), strCDHash.size());
+        jvNode["requirement"] = strRequirement;
+    }
+
     return true;
 }
 
 void ZAppBundle::GetPlugIns(const string &strFolder, vector<string> &arrPlugIns)
 {
-    DIR *dir = opendir(strFolder.c_str());
-    if (NULL != dir)
+    ZDirReader dir;
+    if (dir.Open(strFolder.c_str()))
+    {
+        string strPath = strFolder;
+        GetPlugInsAt(dir, strPath, arrPlugIns);
+    }
+}
+
+void ZAppBundle::GetPlugInsAt(ZDirReader &dir, string &strPath, vector<string> &arrPlugIns)
+{
+    size_t uLength = strPath.size();
+    const char *szName = NULL;
+    bool bFolder = false;
+    bool bFile = false;
+    while (dir.Read(szName, bFolder, bFile))
+    {
+        if (!bFolder)
+        {
+            continue;
+        }
+
+        _PushPath(strPath, szName);
+        if (IsPathSuffix(strPath, ".app") || IsPathSuffix(strPath, ".appex"))
+        {
+            arrPlugIns.push_back(strPath);
+        }
+
+        ZDirReader subdir;
+        if (subdir.OpenAt(dir.GetFD(), szName))
+        {
+            GetPlugInsAt(subdir, strPath, arrPlugIns);
+        }
+        _PopPath(strPath, uLength);
+    }
+}
+
+bool ZAppBundle::SignFile(const string &strFile)
+{
+    ZLog::PrintV(">>> SignFile: \t%s\n", strFile.c_str());
+    ZMachO macho;
+    macho.SetPageSize(m_uPageSize);
+    macho.SetSignatureSlack(m_uSignSlack);
+    if (!macho.InitV("%s/%s", m_strAppFolder.c_str(), strFile.c_str()))
+    {
+        return false;
+    }
+
+    bool bForceSign = m_bForceSign;
+    ApplyDylibEdits(macho, m_strAppFolder + "/" + strFile, false, bForceSign);
+    return macho.Sign(m_pSignAsset, bForceSign, "", "", "", "", m_bSHA256Only);
+}
+
+bool ZAppBundle::SignFiles(ZSignAsset *pSignAsset, const vector<string> &arrFiles, bool bForce)
+{ // standalone binaries, each one is its own identifier and needs no bundle around it
+    if (NULL == pSignAsset)
+    {
+        return false;
+    }
+
+    atomic<size_t> uFailed(0);
+    _ParallelFor(arrFiles.size(), [&](size_t i) {
+        ZMachO macho;
+        macho.SetPageSize(m_uPageSize);
+        macho.SetSignatureSlack(m_uSignSlack);
+        bool bSign = bForce;
+        if (!macho.Init(arrFiles[i].c_str()) || !ApplyDylibEdits(macho, arrFiles[i], true, bSign) ||
+            !macho.Sign(pSignAsset, bSign, "", "", "", ""))
+        {
+            ZLog::ErrorV(">>> Can't Sign File! %s\n", arrFiles[i].c_str());
+            uFailed++;
+        }
+        return true;
+    });
+
+    ZLog::PrintV(">>> SignFiles: \t%lu signed, %lu failed\n", arrFiles.size() - uFailed, (size_t)uFailed);
+    return (0 == uFailed);
+}
+
+void ZAppBundle::SetPageSize(uint32_t uPageSize) { m_uPageSize = uPageSize; }
+
+void ZAppBundle::SetSignatureSlack(uint32_t uSlack) { m_uSignSlack = uSlack; }
+
+void ZAppBundle::AddDylibEdit(int nType, const string &strPath, const string &strNewPath, bool bWeak)
+{
+    DylibEdit edit;
+    edit.nType = nType;
+    edit.strPath = strPath;
+    edit.strNewPath = strNewPath;
+    edit.bWeak = bWeak;
+    m_arrDylibEdits.push_back(edit);
+}
+
+bool ZAppBundle::ApplyDylibEdits(ZMachO &macho, const string &strFile, bool bRoot, bool &bChanged)
+{
+    if (m_arrDylibEdits.empty())
+    {
+        return true;
+    }
+
+    vector<string> arrDylibs = macho.ListDylibs();
+    set<string> setDylibs(arrDylibs.begin(), arrDylibs.end());
+
+    bool bRet = true;
+    for (size_t i = 0; i < m_arrDylibEdits.size(); i++)
     {
-        dirent *ptr = readdir(dir);
-        while (NULL != ptr)
+        const DylibEdit &edit = m_arrDylibEdits[i];
+        if (E_DYLIB_CHANGE == edit.nType)
         {
-            if (0 != strcmp(ptr->d_name, ".") && 0 != strcmp(ptr->d_name, ".."))
+            if (setDylibs.count(edit.strPath) > 0 &&
+                macho.ChangeDylibPath(edit.strPath.c_str(), edit.strNewPath.c_str()))
             {
-                if (DT_DIR == ptr->d_type)
-                {
-                    string strSubFolder = strFolder;
-                    strSubFolder += "/";
-                    strSubFolder += ptr->d_name;
-                    if (IsPathSuffix(strSubFolder, ".app") || IsPathSuffix(strSubFolder, ".appex"))
-                    {
-                        arrPlugIns.push_back(strSubFolder);
-                    }
-                    GetPlugIns(strSubFolder, arrPlugIns);
-                }
+                setDylibs.erase(edit.strPath);
+                setDylibs.insert(edit.strNewPath);
+                bChanged = true;
+            }
+        }
+        else if (E_DYLIB_REMOVE == edit.nType)
+        {
+            if (setDylibs.count(edit.strPath) > 0)
+            {
+                set<string> setRemove;
+                setRemove.insert(edit.strPath);
+                macho.RemoveDylib(setRemove);
+                setDylibs.erase(edit.strPath);
+                bChanged = true;
+            }
+        }
+        else if (E_DYLIB_INJECT == edit.nType || (E_DYLIB_INJECT_ROOT == edit.nType && bRoot))
+        {
+            string strTarget = edit.strPath;
+            if (0 == strTarget.compare(0, 17, "@executable_path/"))
+            {
+                strTarget = m_strAppFolder + strTarget.substr(16);
+            }
+            else if (0 == strTarget.compare(0, 7, "@rpath/"))
+            {
+                strTarget = m_strAppFolder + "/Frameworks" + strTarget.substr(6);
+            }
+            if (strTarget == strFile)
+            { // never make a library load itself
+                continue;
             }
-            ptr = readdir(dir);
+
+            bool bCreate = false;
+            if (!macho.InjectDyLib(edit.bWeak, edit.strPath.c_str(), bCreate))
+            {
+                bRet = false;
+            }
+            bChanged = bChanged || bCreate;
+        }
+    }
+    return bRet;
+}
+
+void ZAppBundle::GetNodeBinaries(const JValue &jvNode, vector<string> &arrBinaries, set<string> &setMainBinaries)
+{
+    string strFolder = jvNode["path"];
+    string strBaseFolder = ("/" == strFolder) ? m_strAppFolder : (m_strAppFolder + "/" + strFolder);
+    string strExe = jvNode["exec"];
+    if (!strExe.empty())
+    {
+        arrBinaries.push_back(strBaseFolder + "/" + strExe);
+        if ("/" == strFolder || IsPathSuffix(strFolder, ".app") || IsPathSuffix(strFolder, ".appex") ||
+            IsPathSuffix(strFolder, ".xctest"))
+        {
+            setMainBinaries.insert(arrBinaries.back());
         }
-        closedir(dir);
     }
+    for (size_t i = 0; i < jvNode["files"].size(); i++)
+    {
+        arrBinaries.push_back(m_strAppFolder + "/" + jvNode["files"][i].asCString());
+    }
+    for (size_t i = 0; i < jvNode["folders"].size(); i++)
+    {
+        GetNodeBinaries(jvNode["folders"][i], arrBinaries, setMainBinaries);
+    }
+}
+
+bool ZAppBundle::GetBundleTree(const string &strFolder, JValue &jvRoot)
+{
+    if (!FindAppFolder(strFolder, m_strAppFolder))
+    {
+        ZLog::ErrorV(">>> Can't Find App Folder! %s\n", strFolder.c_str());
+        return false;
+    }
+
+    jvRoot["path"] = "/";
+    if (!GetSignFolderInfo(m_strAppFolder, jvRoot) || !GetObjectsToSign(m_strAppFolder, jvRoot))
+    {
+        ZLog::ErrorV(">>> Can't Get BundleExecute in Info.plist! %s\n", m_strAppFolder.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ZAppBundle::EditFolder(const string &strFolder)
+{
+    JValue jvRoot;
+    if (!GetBundleTree(strFolder, jvRoot))
+    {
+        return false;
+    }
+
+    vector<string> arrBinaries;
+    set<string> setMainBinaries;
+    GetNodeBinaries(jvRoot, arrBinaries, setMainBinaries);
+    string strRootExe = m_strAppFolder + "/" + jvRoot["exec"].asString();
+    ZLog::PrintV(">>> EditDylibs: \t%lu binaries, %lu rules\n", arrBinaries.size(), m_arrDylibEdits.size());
+
+    return _ParallelFor(arrBinaries.size(), [&](size_t i) {
+        ZMachO macho;
+        if (!macho.Init(arrBinaries[i].c_str()))
+        {
+            return false;
+        }
+        bool bChanged = false;
+        bool bRet = ApplyDylibEdits(macho, arrBinaries[i], strRootExe == arrBinaries[i], bChanged);
+        macho.Free();
+        return bRet;
+    });
+}
+
+bool ZAppBundle::ResolveDylibPath(const string &strDylib, const string &strLoaderFolder, const string &strExeFolder,
+                                  const vector<string> &arrRPaths, string &strResolved, bool &bSystem)
+{
+    vector<string> arrCandidates;
+    if (0 == strDylib.compare(0, 17, "@executable_path/"))
+    {
+        arrCandidates.push_back(strExeFolder + strDylib.substr(16));
+    }
+    else if (0 == strDylib.compare(0, 13, "@loader_path/"))
+    {
+        arrCandidates.push_back(strLoaderFolder + strDylib.substr(12));
+    }
+    else if (0 == strDylib.compare(0, 7, "@rpath/"))
+    {
+        for (size_t i = 0; i < arrRPaths.size(); i++)
+        {
+            string strRPath = arrRPaths[i];
+            if (0 == strRPath.compare(0, 16, "@executable_path"))
+            {
+                strRPath = strExeFolder + strRPath.substr(16);
+            }
+            else if (0 == strRPath.compare(0, 12, "@loader_path"))
+            {
+                strRPath = strLoaderFolder + strRPath.substr(12);
+            }
+            arrCandidates.push_back(strRPath + strDylib.substr(6));
+        }
+    }
+    else
+    {
+        arrCandidates.push_back(strDylib);
+    }
+
+    bSystem = false;
+    string strAppFolder = _NormalizePath(m_strAppFolder) + "/";
+    for (size_t i = 0; i < arrCandidates.size(); i++)
+    { // only files inside the bundle count, the graph is keyed by bundle-relative paths
+        string strPath = _NormalizePath(arrCandidates[i]);
+        if (0 == strPath.compare(0, strAppFolder.size(), strAppFolder) && IsRegularFile(arrCandidates[i].c_str()))
+        {
+            strResolved = strPath.substr(strAppFolder.size());
+            return true;
+        }
+        if (0 == strPath.compare(0, 9, "/usr/lib/") || 0 == strPath.compare(0, 8, "/System/"))
+        { // e.g. @rpath/libswiftCore.dylib through /usr/lib/swift, provided by the OS
+            bSystem = true;
+        }
+    }
+    return false;
+}
+
+bool ZAppBundle::GetDylibGraph(const string &strFolder, JValue &jvGraph)
+{
+    JValue jvRoot;
+    if (!GetBundleTree(strFolder, jvRoot))
+    {
+        return false;
+    }
+
+    vector<string> arrBinaries;
+    set<string> setMainBinaries;
+    GetNodeBinaries(jvRoot, arrBinaries, setMainBinaries);
+
+    vector<vector<pair<uint32_t, string>>> arrDylibs(arrBinaries.size());
+    vector<vector<string>> arrRPaths(arrBinaries.size());
+    _ParallelFor(arrBinaries.size(), [&](size_t i) {
+        ZMachO::ProbeDependencies(arrBinaries[i].c_str(), arrDylibs[i], arrRPaths[i]);
+        return true;
+    });
+
+    // @executable_path is the enclosing app or extension, whose run paths dyld also searches
+    size_t uPrefix = m_strAppFolder.size() + 1;
+    map<string, size_t> mapIndexes;
+    for (size_t i = 0; i < arrBinaries.size(); i++)
+    {
+        mapIndexes[arrBinaries[i].substr(uPrefix)] = i;
+    }
+
+    map<string, vector<string>> mapEdges;
+    jvGraph["root"] = m_strAppFolder;
+    for (size_t i = 0; i < arrBinaries.size(); i++)
+    {
+        string strFile = arrBinaries[i].substr(uPrefix);
+        string strLoaderFolder = arrBinaries[i].substr(0, arrBinaries[i].rfind('/'));
+        string strExeFolder = m_strAppFolder;
+        size_t uMainIndex = i;
+        for (set<string>::iterator it = setMainBinaries.begin(); it != setMainBinaries.end(); ++it)
+        {
+            string strMainFolder = it->substr(0, it->rfind('/'));
+            if (0 == arrBinaries[i].compare(0, strMainFolder.size() + 1, strMainFolder + "/") &&
+                strMainFolder.size() >= strExeFolder.size())
+            {
+                strExeFolder = strMainFolder;
+                uMainIndex = mapIndexes[it->substr(uPrefix)];
+            }
+        }
+
+        vector<string> arrSearchPaths = arrRPaths[i];
+        if (uMainIndex != i)
+        {
+            arrSearchPaths.insert(arrSearchPaths.end(), arrRPaths[uMainIndex].begin(), arrRPaths[uMainIndex].end());
+        }
+
+        JValue &jvBinary = jvGraph["binaries"][strFile];
+        jvBinary["main"] = (setMainBinaries.count(arrBinaries[i]) > 0);
+        for (size_t j = 0; j < arrRPaths[i].size(); j++)
+        {
+            jvBinary["rpaths"].push_back(arrRPaths[i][j]);
+        }
+
+        for (size_t j = 0; j < arrDylibs[i].size(); j++)
+        {
+            const string &strDylib = arrDylibs[i][j].second;
+            uint32_t uLoadType = arrDylibs[i][j].first;
+
+            JValue jvDep;
+            jvDep["path"] = strDylib;
+            switch (uLoadType)
+            {
+            case LC_LOAD_WEAK_DYLIB:
+                jvDep["type"] = "weak";
+                break;
+            case LC_REEXPORT_DYLIB:
+                jvDep["type"] = "reexport";
+                break;
+            case LC_LAZY_LOAD_DYLIB:
+                jvDep["type"] = "lazy";
+                break;
+            case LC_LOAD_UPWARD_DYLIB:
+                jvDep["type"] = "upward";
+                break;
+            default:
+                jvDep["type"] = "load";
+                break;
+            }
+
+            string strResolved;
+            bool bSystem = false;
+            if (ResolveDylibPath(strDylib, strLoaderFolder, strExeFolder, arrSearchPaths, strResolved, bSystem))
+            {
+                jvDep["resolved"] = strResolved;
+                mapEdges[strFile].push_back(strResolved);
+            }
+            else if (bSystem)
+            {
+                jvDep["system"] = true;
+            }
+            else
+            {
+                JValue jvMissing;
+                jvMissing["binary"] = strFile;
+                jvMissing["path"] = strDylib;
+                jvMissing["type"] = jvDep["type"];
+                jvGraph["missing"].push_back(std::move(jvMissing));
+            }
+            jvBinary["deps"].push_back(std::move(jvDep));
+        }
+    }
+
+    // anything the executables can't reach is only loadable through dlopen
+    set<string> setReached;
+    vector<string> arrQueue;
+    for (set<string>::iterator it = setMainBinaries.begin(); it != setMainBinaries.end(); ++it)
+    {
+        arrQueue.push_back(it->substr(uPrefix));
+        setReached.insert(arrQueue.back());
+    }
+    while (!arrQueue.empty())
+    {
+        string strFile = arrQueue.back();
+        arrQueue.pop_back();
+        vector<string> &arrEdges = mapEdges[strFile];
+        for (size_t i = 0; i < arrEdges.size(); i++)
+        {
+            if (setReached.insert(arrEdges[i]).second)
+            {
+                arrQueue.push_back(arrEdges[i]);
+            }
+        }
+    }
+    for (size_t i = 0; i < arrBinaries.size(); i++)
+    {
+        string strFile = arrBinaries[i].substr(uPrefix);
+        if (0 == setReached.count(strFile))
+        {
+            jvGraph["unused"].push_back(strFile);
+        }
+    }
+
+    ZLog::PrintV(">>> DylibGraph: \t%lu binaries, %lu missing, %lu unused\n", arrBinaries.size(),
+                 jvGraph["missing"].size(), jvGraph["unused"].size());
+    return true;
 }
 
 bool ZAppBundle::SignFolder(ZSignAsset *pSignAsset, const string &strFolder, const string &strBundleID,
@@ -519,6 +1110,11 @@ bool ZAppBundle::SignFolder(ZSignAsset *pSignAsset, const string &strFolder, con
         return false;
     }
 
+    if (m_pSignAsset->m_bAdhoc)
+    { // no profile to embed
+        dontGenerateEmbeddedMobileProvision = false;
+    }
+
     if (!FindAppFolder(strFolder, m_strAppFolder))
     {
         ZLog::ErrorV(">>> Can't Find App Folder! %s\n", strFolder.c_str());
@@ -640,14 +1236,18 @@ bool ZAppBundle::SignFolder(ZSignAsset *pSignAsset, const string &strFolder, con
         }
     }
 
+    if (!m_arrDylibEdits.empty())
+    { // cached hashes are stale once load commands change
+        m_bForceSign = true;
+    }
+
     if (!strDyLibFile.empty())
     { // inject dylib
-        string strDyLibData;
-        ReadFile(strDyLibFile.c_str(), strDyLibData);
-        if (!strDyLibData.empty())
+        if (GetFileSize(strDyLibFile.c_str()) > 0)
         {
             string strFileName = basename((char *)strDyLibFile.c_str());
-            if (WriteFile(strDyLibData, "%s/%s", m_strAppFolder.c_str(), strFileName.c_str()))
+            string strDstFile = m_strAppFolder + "/" + strFileName;
+            if (CloneFile(strDyLibFile.c_str(), strDstFile.c_str()))
             {
                 StringFormat(m_strDyLibPath, "@executable_path/%s", strFileName.c_str());
             }
@@ -683,6 +1283,10 @@ bool ZAppBundle::SignFolder(ZSignAsset *pSignAsset, const string &strFolder, con
         jvRoot.readPath("./.zsign_cache/%s.json", strCacheName.c_str());
     }
 
+    JValue jvInfoPlist;
+    jvInfoPlist.readPListPath("%s/Info.plist", m_strAppFolder.c_str());
+    m_bSHA256Only = _IsSHA256OnlyTarget(jvInfoPlist["MinimumOSVersion"].asString());
+
     ZLog::PrintV(">>> Signing: \t%s ...\n", m_strAppFolder.c_str());
     ZLog::PrintV(">>> AppName: \t%s\n", jvRoot["name"].asCString());
     ZLog::PrintV(">>> BundleId: \t%s\n", jvRoot["bid"].asCString());
@@ -690,6 +1294,7 @@ bool ZAppBundle::SignFolder(ZSignAsset *pSignAsset, const string &strFolder, con
     ZLog::PrintV(">>> TeamId: \t%s\n", m_pSignAsset->m_strTeamId.c_str());
     ZLog::PrintV(">>> SubjectCN: \t%s\n", m_pSignAsset->m_strSubjectCN.c_str());
     ZLog::PrintV(">>> ReadCache: \t%s\n", m_bForceSign ? "NO" : "YES");
+    ZLog::PrintV(">>> Digest: \t%s\n", m_bSHA256Only ? "SHA-256" : "SHA-1, SHA-256");
     ZLog::PrintV(">>> Exclude MobileProvision: \t%s\n", dontGenerateEmbeddedMobileProvision ? "NO" : "YES");
 
     if (SignNode(jvRoot))
@@ -12,39 +12,84 @@
 
 #pragma once
 #include "common/common.h"
+#include "common/dirwalk.h"
 #include "common/json.h"
 #include "openssl.h"
 
+class ZMachO;
+
 class ZAppBundle
 {
+  public:
+    enum
+    {
+        E_DYLIB_CHANGE = 1,
+        E_DYLIB_INJECT = 2,
+        E_DYLIB_REMOVE = 3,
+        E_DYLIB_INJECT_ROOT = 4, // like E_DYLIB_INJECT, but only into the app's own executable
+    };
+
   public:
     ZAppBundle();
 
+  public:
+    void AddDylibEdit(int nType, const string &strPath, const string &strNewPath = "", bool bWeak = true);
+    bool EditFolder(const string &strFolder);
+    bool GetDylibGraph(const string &strFolder, JValue &jvGraph);
+
   public:
     bool SignFolder(ZSignAsset *pSignAsset, const string &strFolder, const string &strBundleID,
                     const string &strBundleVersion, const string &strDisplayName, const string &strDyLibFile,
                     bool bForce, bool bWeakInject, bool bEnableCache, bool dontGenerateEmbeddedMobileProvision);
+    bool SignFiles(ZSignAsset *pSignAsset, const vector<string> &arrFiles, bool bForce);
+    void SetPageSize(uint32_t uPageSize);
+    void SetSignatureSlack(uint32_t uSlack);
 
   private:
     bool SignNode(JValue &jvNode);
+    bool SignFile(const string &strFile);
+    bool GetBundleTree(const string &strFolder, JValue &jvRoot);
+    void GetNodeBinaries(const JValue &jvNode, vector<string> &arrBinaries, set<string> &setMainBinaries);
+    bool ResolveDylibPath(const string &strDylib, const string &strLoaderFolder, const string &strExeFolder,
+                          const vector<string> &arrRPaths, string &strResolved, bool &bSystem);
+    bool ApplyDylibEdits(ZMachO &macho, const string &strFile, bool bRoot, bool &bChanged);
     void GetNodeChangedFiles(JValue &jvNode, bool dontGenerateEmbeddedMobileProvision);
-    void GetChangedFiles(JValue &jvNode, vector<string> &arrChangedFiles);
     void GetPlugIns(const string &strFolder, vector<string> &arrPlugIns);
+    void GetPlugInsAt(ZDirReader &dir, string &strPath, vector<string> &arrPlugIns);
 
   private:
     bool FindAppFolder(const string &strFolder, string &strAppFolder);
+    bool FindAppFolderAt(ZDirReader &dir, string &strPath, string &strAppFolder);
     bool GetObjectsToSign(const string &strFolder, JValue &jvInfo);
+    void GetObjectsToSignAt(ZDirReader &dir, string &strPath, JValue &jvInfo);
     bool GetSignFolderInfo(const string &strFolder, JValue &jvNode, bool bGetName = false);
 
   private:
-    bool GenerateCodeResources(const string &strFolder, JValue &jvCodeRes);
-    void GetFolderFiles(const string &strFolder, const string &strBaseFolder, set<string> &setFiles);
+    bool GenerateCodeResources(const string &strFolder, const JValue &jvNode, const JValue &jvOldCodeRes,
+                               JValue &jvCodeRes);
+    void GetFolderFiles(const string &strFolder, const set<string> &setSkipFolders, ZPathArena &arena,
+                        vector<ZDirFile> &arrFiles);
+    void GetFolderFilesAt(ZDirReader &dir, string &strPath, const set<string> &setSkipFolders, ZPathArena &arena,
+                          vector<ZDirFile> &arrFiles);
+
+  private:
+    struct DylibEdit
+    {
+        int nType;
+        string strPath;
+        string strNewPath;
+        bool bWeak;
+    };
 
   private:
     bool m_bForceSign;
     bool m_bWeakInject;
+    bool m_bSHA256Only;
+    uint32_t m_uPageSize;
+    uint32_t m_uSignSlack;
     string m_strDyLibPath;
     ZSignAsset *m_pSignAsset;
+    vector<DylibEdit> m_arrDylibEdits;
 
   public:
     string m_strAppFolder;
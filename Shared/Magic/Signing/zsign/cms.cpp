@@ -0,0 +1,260 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#include "cms.h"
+#include "sslptr.h"
+
+#include <algorithm>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#define DER_INTEGER 0x02
+#define DER_OCTET_STRING 0x04
+#define DER_OID 0x06
+#define DER_UTC_TIME 0x17
+#define DER_GENERALIZED_TIME 0x18
+#define DER_SEQUENCE 0x30
+#define DER_SET 0x31
+#define DER_CONTEXT_0 0xA0
+
+// signed attributes (a 2 entry CDHashes plist is about 330 bytes) and every DER header around them
+#define CMS_FRAMING_LENGTH_BOUND 1024
+
+// pre-encoded object identifiers, tag and length included
+static const string s_oidData("\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x07\x01", 11);
+static const string s_oidSignedData("\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x07\x02", 11);
+static const string s_oidContentType("\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x09\x03", 11);
+static const string s_oidMessageDigest("\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x09\x04", 11);
+static const string s_oidSigningTime("\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x09\x05", 11);
+static const string s_oidCDHashes("\x06\x09\x2A\x86\x48\x86\xF7\x63\x64\x09\x01", 11);
+static const string s_oidCDHashes2("\x06\x09\x2A\x86\x48\x86\xF7\x63\x64\x09\x02", 11);
+static const string s_oidSHA256("\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x01", 11);
+static const string s_oidRSAEncryption("\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x01\x01", 11);
+static const string s_derNull("\x05\x00", 2);
+static const string s_derVersion1("\x02\x01\x01", 3);
+
+static string _DER(uint8_t uTag, const string &strContent)
+{
+    string strOutput;
+    size_t uLength = strContent.size();
+    strOutput.reserve(uLength + 6);
+    strOutput.push_back((char)uTag);
+    if (uLength < 0x80)
+    {
+        strOutput.push_back((char)uLength);
+    }
+    else
+    {
+        uint8_t uBytes = 0;
+        for (size_t n = uLength; n > 0; n >>= 8)
+        {
+            uBytes++;
+        }
+        strOutput.push_back((char)(0x80 | uBytes));
+        for (int i = uBytes - 1; i >= 0; i--)
+        {
+            strOutput.push_back((char)((uLength >> (8 * i)) & 0xFF));
+        }
+    }
+    strOutput.append(strContent);
+    return strOutput;
+}
+
+static string _DERSetOf(vector<string> &arrElements)
+{ // DER orders SET OF members by their encodings
+    sort(arrElements.begin(), arrElements.end());
+    string strContent;
+    for (size_t i = 0; i < arrElements.size(); i++)
+    {
+        strContent += arrElements[i];
+    }
+    return strContent;
+}
+
+static string _DERAttribute(const string &strOID, const string &strValue)
+{
+    return _DER(DER_SEQUENCE, strOID + _DER(DER_SET, strValue));
+}
+
+static string _DERSigningTime()
+{
+    time_t tNow = time(NULL);
+    struct tm tmNow;
+    gmtime_r(&tNow, &tmNow);
+
+    char szTime[32] = {0};
+    int nYear = tmNow.tm_year + 1900;
+    if (nYear >= 1950 && nYear < 2050)
+    {
+        strftime(szTime, sizeof(szTime), "%y%m%d%H%M%SZ", &tmNow);
+        return _DER(DER_UTC_TIME, szTime);
+    }
+    strftime(szTime, sizeof(szTime), "%Y%m%d%H%M%SZ", &tmNow);
+    return _DER(DER_GENERALIZED_TIME, szTime);
+}
+
+static string _X509ToDER(X509 *x509Cert)
+{
+    string strDER;
+    unsigned char *pDER = NULL;
+    int nDER = i2d_X509(x509Cert, &pDER);
+    if (nDER > 0)
+    {
+        strDER.append((const char *)pDER, nDER);
+        OPENSSL_free(pDER);
+    }
+    return strDER;
+}
+
+ZCMSTemplate::ZCMSTemplate() { m_evpPKey = NULL; }
+
+void ZCMSTemplate::Clear()
+{
+    m_evpPKey = NULL;
+    m_strCertificates.clear();
+    m_strSignerId.clear();
+}
+
+bool ZCMSTemplate::IsReady() const { return (NULL != m_evpPKey); }
+
+size_t ZCMSTemplate::GetEncodedLengthBound() const
+{ // certificates and signer id are encoded already, the RSA signature is as long as the key
+    if (!IsReady())
+    {
+        return 0;
+    }
+    return m_strCertificates.size() + m_strSignerId.size() + (size_t)EVP_PKEY_size((EVP_PKEY *)m_evpPKey) +
+           CMS_FRAMING_LENGTH_BOUND;
+}
+
+bool ZCMSTemplate::Init(void *pX509Cert, void *pEVPPKey, void *pCertChain)
+{
+    Clear();
+
+    X509 *x509Cert = (X509 *)pX509Cert;
+    STACK_OF(X509) *pChain = (STACK_OF(X509) *)pCertChain;
+    if (NULL == x509Cert || NULL == pChain || NULL == pEVPPKey ||
+        EVP_PKEY_RSA != EVP_PKEY_base_id((EVP_PKEY *)pEVPPKey))
+    { // other key types and issuers still go through CMS_sign
+        return false;
+    }
+
+    vector<string> arrCerts;
+    arrCerts.push_back(_X509ToDER(x509Cert));
+    for (int i = 0; i < sk_X509_num(pChain); i++)
+    {
+        string strCert = _X509ToDER(sk_X509_value(pChain, i));
+        if (arrCerts.end() == find(arrCerts.begin(), arrCerts.end(), strCert))
+        {
+            arrCerts.push_back(strCert);
+        }
+    }
+
+    string strIssuer;
+    unsigned char *pDER = NULL;
+    int nDER = i2d_X509_NAME(X509_get_issuer_name(x509Cert), &pDER);
+    if (nDER > 0)
+    {
+        strIssuer.append((const char *)pDER, nDER);
+        OPENSSL_free(pDER);
+    }
+
+    string strSerial;
+    pDER = NULL;
+    nDER = i2d_ASN1_INTEGER(X509_get_serialNumber(x509Cert), &pDER);
+    if (nDER > 0)
+    {
+        strSerial.append((const char *)pDER, nDER);
+        OPENSSL_free(pDER);
+    }
+
+    for (size_t i = 0; i < arrCerts.size(); i++)
+    {
+        if (arrCerts[i].empty())
+        {
+            return false;
+        }
+    }
+    if (strIssuer.empty() || strSerial.empty())
+    {
+        return false;
+    }
+
+    m_strCertificates = _DER(DER_CONTEXT_0, _DERSetOf(arrCerts));
+    m_strSignerId = _DER(DER_SEQUENCE, strIssuer + strSerial);
+    m_evpPKey = pEVPPKey;
+    return true;
+}
+
+bool ZCMSTemplate::Encode(const string &strCDHashData, const string &strCDHashesPlist,
+                          const string &strAltnateCodeDirectorySlot256, string &strCMSOutput) const
+{
+    strCMSOutput.clear();
+    if (!IsReady())
+    {
+        return false;
+    }
+
+    string strMessageDigest;
+    SHASum(E_SHASUM_TYPE_256, strCDHashData, strMessageDigest);
+
+    string strAlgSHA256 = _DER(DER_SEQUENCE, s_oidSHA256);
+    vector<string> arrAttrs;
+    arrAttrs.push_back(_DERAttribute(s_oidContentType, s_oidData));
+    arrAttrs.push_back(_DERAttribute(s_oidSigningTime, _DERSigningTime()));
+    arrAttrs.push_back(_DERAttribute(s_oidMessageDigest, _DER(DER_OCTET_STRING, strMessageDigest)));
+    arrAttrs.push_back(_DERAttribute(s_oidCDHashes, _DER(DER_OCTET_STRING, strCDHashesPlist)));
+    arrAttrs.push_back(_DERAttribute(
+        s_oidCDHashes2, _DER(DER_SEQUENCE, s_oidSHA256 + _DER(DER_OCTET_STRING, strAltnateCodeDirectorySlot256))));
+    string strSignedAttrs = _DERSetOf(arrAttrs);
+
+    string strAttrsDigest;
+    SHASum(E_SHASUM_TYPE_256, _DER(DER_SET, strSignedAttrs), strAttrsDigest);
+
+    // the only private-key operation per signature: PKCS#1 v1.5 over the signed attributes digest
+    size_t uSignature = 0;
+    ZSSLPtr<EVP_PKEY_CTX> ctx(EVP_PKEY_CTX_new((EVP_PKEY *)m_evpPKey, NULL));
+    if (!ctx || EVP_PKEY_sign_init(ctx.get()) <= 0 || EVP_PKEY_CTX_set_rsa_padding(ctx.get(), RSA_PKCS1_PADDING) <= 0 ||
+        EVP_PKEY_CTX_set_signature_md(ctx.get(), EVP_sha256()) <= 0 ||
+        EVP_PKEY_sign(ctx.get(), NULL, &uSignature, (const unsigned char *)strAttrsDigest.data(),
+                      strAttrsDigest.size()) <= 0)
+    {
+        ZLog::Error(">>> Can't Sign CMS Attributes!\n");
+        return false;
+    }
+
+    string strSignature(uSignature, 0);
+    if (EVP_PKEY_sign(ctx.get(), (unsigned char *)&strSignature[0], &uSignature,
+                      (const unsigned char *)strAttrsDigest.data(), strAttrsDigest.size()) <= 0)
+    {
+        ZLog::Error(">>> Can't Sign CMS Attributes!\n");
+        return false;
+    }
+    strSignature.resize(uSignature);
+
+    string strSignerInfo = s_derVersion1;
+    strSignerInfo += m_strSignerId;
+    strSignerInfo += strAlgSHA256;
+    strSignerInfo += _DER(DER_CONTEXT_0, strSignedAttrs);
+    strSignerInfo += _DER(DER_SEQUENCE, s_oidRSAEncryption + s_derNull);
+    strSignerInfo += _DER(DER_OCTET_STRING, strSignature);
+
+    string strSignedData = s_derVersion1;
+    strSignedData += _DER(DER_SET, strAlgSHA256);
+    strSignedData += _DER(DER_SEQUENCE, s_oidData);
+    strSignedData += m_strCertificates;
+    strSignedData += _DER(DER_SET, _DER(DER_SEQUENCE, strSignerInfo));
+
+    strCMSOutput = _DER(DER_SEQUENCE, s_oidSignedData + _DER(DER_CONTEXT_0, _DER(DER_SEQUENCE, strSignedData)));
+    return true;
+}
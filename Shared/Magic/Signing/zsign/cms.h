@@ -0,0 +1,39 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#pragma once
+#include "common/common.h"
+
+/**
+ * DER encoder for the one CMS shape a code signature uses: detached SignedData, one RSA signer,
+ * the Apple certificate chain and the CDHashes (1.2.840.113635.100.9.1/9.2) signed attributes.
+ * The certificate set and signer identifier are encoded once by Init, so Encode only hashes the
+ * signed attributes and makes a single private-key operation.
+ */
+class ZCMSTemplate
+{
+  public:
+    ZCMSTemplate();
+
+  public:
+    bool Init(void *pX509Cert, void *pEVPPKey, void *pCertChain);
+    bool IsReady() const;
+    void Clear();
+    bool Encode(const string &strCDHashData, const string &strCDHashesPlist,
+                const string &strAltnateCodeDirectorySlot256, string &strCMSOutput) const;
+    size_t GetEncodedLengthBound() const;
+
+  private:
+    void *m_evpPKey;
+    string m_strCertificates;
+    string m_strSignerId;
+};
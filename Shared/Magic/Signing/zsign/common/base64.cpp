@@ -130,17 +130,18 @@ const char *ZBase64::Decode(const char *pData, int nDataLen, int *pOutDataLen)
     char *pDecoded = new char[*pOutDataLen + 1];
     m_arrDec.push_back(pDecoded);
 
-    static unsigned char s_ca_table_dec[256] = {0};
-    static bool s_b_init = false;
-    if (!s_b_init)
-    {
-        memset(s_ca_table_dec, 0xff, sizeof(s_ca_table_dec));
-        for (int i = 0; i < 64; i++)
+    static const struct DecodeTable
+    { // a function static is built exactly once, even when binaries are signed on several threads
+        unsigned char data[256];
+        DecodeTable()
         {
-            s_ca_table_dec[s_ca_table_enc[i]] = i;
+            memset(data, 0xff, sizeof(data));
+            for (int i = 0; i < 64; i++)
+            {
+                data[s_ca_table_enc[i]] = i;
+            }
         }
-        s_b_init = true;
-    }
+    } s_ca_table_dec;
 
     const unsigned char *p = (const unsigned char *)pData;
     unsigned char *q = (unsigned char *)pDecoded;
@@ -153,7 +154,7 @@ const char *ZBase64::Decode(const char *pData, int nDataLen, int *pOutDataLen)
             continue;
         }
 
-        unsigned char c = s_ca_table_dec[p[i]];
+        unsigned char c = s_ca_table_dec.data[p[i]];
         if (0xff == c)
         {
             continue;
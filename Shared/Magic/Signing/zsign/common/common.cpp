@@ -16,9 +16,18 @@
 #include <cinttypes>
 #include <fstream>
 #include <inttypes.h>
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <sys/stat.h>
 
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#elif defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
 #define PARSEVALIST(szFormatArgs, szArgs)                                                                              \
     ZBuffer buffer;                                                                                                    \
     char szBuffer[PATH_MAX] = {0};                                                                                     \
@@ -46,7 +55,7 @@ bool IsRegularFile(const char *file)
     return S_ISREG(info.st_mode);
 }
 
-void *MapFile(const char *path, size_t offset, size_t size, size_t *psize, bool ro)
+void *MapFile(const char *path, size_t offset, size_t size, size_t *psize, bool ro, bool populate)
 {
     int fd = open(path, ro ? O_RDONLY : O_RDWR);
     if (fd <= 0)
@@ -66,7 +75,11 @@ void *MapFile(const char *path, size_t offset, size_t size, size_t *psize, bool
         *psize = size;
     }
 
-    void *base = mmap(NULL, size, ro ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    int flags = ro ? MAP_PRIVATE : MAP_SHARED;
+#ifdef MAP_POPULATE
+    flags |= populate ? MAP_POPULATE : 0; // fault the whole range in with one read-ahead instead of page by page
+#endif
+    void *base = mmap(NULL, size, ro ? PROT_READ : PROT_READ | PROT_WRITE, flags, fd, offset);
     close(fd);
 
     if (MAP_FAILED == base)
@@ -77,38 +90,97 @@ void *MapFile(const char *path, size_t offset, size_t size, size_t *psize, bool
     return base;
 }
 
-bool WriteFile(const char *szFile, const char *szData, size_t sLen)
+bool CloneFile(const char *szSrcFile, const char *szDstFile)
 {
-    if (NULL == szFile)
+    if (NULL == szSrcFile || NULL == szDstFile)
+    {
+        return false;
+    }
+
+#if defined(__APPLE__)
+    unlink(szDstFile);
+    if (0 == clonefile(szSrcFile, szDstFile, 0))
+    { // APFS shares the extents, nothing is read at all
+        return true;
+    }
+#endif
+
+    int fdSrc = open(szSrcFile, O_RDONLY);
+    if (fdSrc < 0)
     {
+        ZLog::ErrorV("CloneFile: Failed in open! %s, %s\n", szSrcFile, strerror(errno));
         return false;
     }
 
-    FILE *fp = fopen(szFile, "wb");
-    if (NULL != fp)
+    uint64_t uSize = (uint64_t)GetFileSize(fdSrc);
+    ZFileWriter writer;
+    bool bRet = writer.Open(szDstFile, uSize) && writer.WriteFrom(fdSrc, 0, uSize);
+    bRet = writer.Close() && bRet;
+    close(fdSrc);
+
+    if (!bRet)
+    {
+        ZLog::ErrorV("CloneFile: Failed! %s -> %s, %s\n", szSrcFile, szDstFile, strerror(errno));
+    }
+    return bRet;
+}
+
+#define FILE_WRITER_BUFFER_SIZE (1024 * 1024)
+
+static bool _PWriteAll(int fd, const char *pData, size_t sLen, uint64_t uOffset)
+{
+    while (sLen > 0)
     {
-        int64_t towrite = sLen;
-        if (NULL != szData)
+        ssize_t nWrite = pwrite(fd, pData, sLen, (off_t)uOffset);
+        if (nWrite < 0 && EINTR == errno)
         {
-            while (towrite > 0)
-            {
-                int64_t nwrite = fwrite(szData + (sLen - towrite), 1, towrite, fp);
-                if (nwrite <= 0)
-                {
-                    break;
-                }
-                towrite -= nwrite;
-            }
+            continue;
+        }
+        if (nWrite <= 0)
+        {
+            return false;
         }
-        fclose(fp);
-        return (towrite > 0) ? false : true;
+        pData += nWrite;
+        sLen -= (size_t)nWrite;
+        uOffset += (uint64_t)nWrite;
     }
-    else
+    return true;
+}
+
+static bool _WriteFileDirect(const char *szTag, const char *szFile, const char *szData, size_t sLen, bool bAppend)
+{ // a payload that fits one writer buffer needs neither the buffer nor a preallocation
+    int fd = open(szFile, O_WRONLY | O_CREAT | (bAppend ? 0 : O_TRUNC), 0644);
+    if (fd < 0)
     {
-        ZLog::ErrorV("WriteFile: Failed in fopen! %s, %s\n", szFile, strerror(errno));
+        ZLog::ErrorV("%s: Failed in open! %s, %s\n", szTag, szFile, strerror(errno));
+        return false;
     }
 
-    return false;
+    bool bRet = _PWriteAll(fd, szData, sLen, bAppend ? (uint64_t)GetFileSize(fd) : 0);
+    return (0 == close(fd)) && bRet;
+}
+
+bool WriteFile(const char *szFile, const char *szData, size_t sLen)
+{
+    if (NULL == szFile)
+    {
+        return false;
+    }
+
+    if (NULL == szData || sLen <= FILE_WRITER_BUFFER_SIZE)
+    {
+        return _WriteFileDirect("WriteFile", szFile, szData, (NULL != szData) ? sLen : 0, false);
+    }
+
+    ZFileWriter writer;
+    if (!writer.Open(szFile, (NULL != szData) ? sLen : 0))
+    {
+        ZLog::ErrorV("WriteFile: Failed in open! %s, %s\n", szFile, strerror(errno));
+        return false;
+    }
+
+    bool bRet = writer.Write(szData, sLen);
+    return writer.Close() && bRet;
 }
 
 bool WriteFile(const char *szFile, const string &strData) { return WriteFile(szFile, strData.data(), strData.size()); }
@@ -134,27 +206,32 @@ bool ReadFile(const char *szFile, string &strData)
         return false;
     }
 
-    FILE *fp = fopen(szFile, "rb");
-    if (NULL != fp)
+    int fd = open(szFile, O_RDONLY);
+    if (fd < 0)
     {
-        strData.reserve(GetFileSize(fileno(fp)));
+        ZLog::ErrorV("ReadFile: Failed in open! %s, %s\n", szFile, strerror(errno));
+        return false;
+    }
 
-        char buf[4096] = {0};
-        size_t nread = fread(buf, 1, 4096, fp);
-        while (nread > 0)
+    strData.resize((size_t)GetFileSize(fd));
+    size_t sRead = 0;
+    while (sRead < strData.size())
+    { // straight into the pre-sized string, no staging buffer
+        ssize_t nRead = pread(fd, &strData[sRead], strData.size() - sRead, (off_t)sRead);
+        if (nRead < 0 && EINTR == errno)
         {
-            strData.append(buf, nread);
-            nread = fread(buf, 1, 4096, fp);
+            continue;
         }
-        fclose(fp);
-        return true;
-    }
-    else
-    {
-        ZLog::ErrorV("ReadFile: Failed in fopen! %s, %s\n", szFile, strerror(errno));
+        if (nRead <= 0)
+        {
+            break;
+        }
+        sRead += (size_t)nRead;
     }
+    close(fd);
 
-    return false;
+    strData.resize(sRead);
+    return true;
 }
 
 bool ReadFile(string &strData, const char *szFormatPath, ...)
@@ -165,28 +242,20 @@ bool ReadFile(string &strData, const char *szFormatPath, ...)
 
 bool AppendFile(const char *szFile, const char *szData, size_t sLen)
 {
-    FILE *fp = fopen(szFile, "ab+");
-    if (NULL != fp)
+    if (sLen <= FILE_WRITER_BUFFER_SIZE)
     {
-        int64_t towrite = sLen;
-        while (towrite > 0)
-        {
-            int64_t nwrite = fwrite(szData + (sLen - towrite), 1, towrite, fp);
-            if (nwrite <= 0)
-            {
-                break;
-            }
-            towrite -= nwrite;
-        }
-
-        fclose(fp);
-        return (towrite > 0) ? false : true;
+        return _WriteFileDirect("AppendFile", szFile, szData, sLen, true);
     }
-    else
+
+    ZFileWriter writer;
+    if (!writer.Open(szFile, sLen, true))
     {
-        ZLog::ErrorV("AppendFile: Failed in fopen! %s, %s\n", szFile, strerror(errno));
+        ZLog::ErrorV("AppendFile: Failed in open! %s, %s\n", szFile, strerror(errno));
+        return false;
     }
-    return false;
+
+    bool bRet = writer.Write(szData, sLen);
+    return writer.Close() && bRet;
 }
 
 bool AppendFile(const char *szFile, const string &strData)
@@ -473,7 +542,7 @@ uint64_t _Swap(uint64_t value)
     return value;
 }
 
-uint32_t ByteAlign(uint32_t uValue, uint32_t uAlign) { return (uValue + (uAlign - uValue % uAlign)); }
+uint64_t ByteAlign(uint64_t uValue, uint64_t uAlign) { return (uValue + (uAlign - uValue % uAlign)); }
 
 const char *StringFormat(string &strFormat, const char *szFormatArgs, ...)
 {
@@ -554,24 +623,130 @@ void PrintDataSHASum(const char *prefix, int nSumType, uint8_t *data, size_t siz
     PrintSHASum(prefix, strSHASum, suffix);
 }
 
+static const EVP_MD *_GetSHAMD(int nSumType)
+{ // explicit fetch, so OpenSSL 3 doesn't look the algorithm up again on every digest
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static const EVP_MD *s_pSHA1 = EVP_MD_fetch(NULL, "SHA1", NULL);
+    static const EVP_MD *s_pSHA256 = EVP_MD_fetch(NULL, "SHA256", NULL);
+    const EVP_MD *pMD = (E_SHASUM_TYPE_1 == nSumType) ? s_pSHA1 : s_pSHA256;
+    if (NULL != pMD)
+    {
+        return pMD;
+    }
+#endif
+    return (E_SHASUM_TYPE_1 == nSumType) ? EVP_sha1() : EVP_sha256();
+}
+
+ZSHAHasher::ZSHAHasher(int nSumType)
+{
+    m_nSumType = (E_SHASUM_TYPE_1 == nSumType) ? E_SHASUM_TYPE_1 : E_SHASUM_TYPE_256;
+    m_pCtx = EVP_MD_CTX_new();
+}
+
+ZSHAHasher::~ZSHAHasher()
+{
+    if (NULL != m_pCtx)
+    {
+        EVP_MD_CTX_free((EVP_MD_CTX *)m_pCtx);
+    }
+}
+
+uint32_t ZSHAHasher::GetHashSize() const { return (E_SHASUM_TYPE_1 == m_nSumType) ? 20 : 32; }
+
+bool ZSHAHasher::Init()
+{
+    return (NULL != m_pCtx && 1 == EVP_DigestInit_ex((EVP_MD_CTX *)m_pCtx, _GetSHAMD(m_nSumType), NULL));
+}
+
+bool ZSHAHasher::Update(const uint8_t *data, size_t size)
+{
+    return (0 == size || 1 == EVP_DigestUpdate((EVP_MD_CTX *)m_pCtx, data, size));
+}
+
+bool ZSHAHasher::Final(string &strOutput)
+{
+    uint8_t hash[EVP_MAX_MD_SIZE];
+    unsigned int uHashSize = 0;
+    if (1 != EVP_DigestFinal_ex((EVP_MD_CTX *)m_pCtx, hash, &uHashSize))
+    {
+        return false;
+    }
+    strOutput.append((const char *)hash, uHashSize);
+    return true;
+}
+
+bool ZSHAHasher::Sum(const uint8_t *data, size_t size, string &strOutput)
+{
+    return (Init() && Update(data, size) && Final(strOutput));
+}
+
+static ZSHAHasher &_GetThreadHasher(int nSumType)
+{ // one reusable context per algorithm per thread, shared by every one-shot digest on that thread
+    static thread_local ZSHAHasher s_hasherSHA1(E_SHASUM_TYPE_1);
+    static thread_local ZSHAHasher s_hasherSHA256(E_SHASUM_TYPE_256);
+    return (E_SHASUM_TYPE_1 == nSumType) ? s_hasherSHA1 : s_hasherSHA256;
+}
+
 bool SHASum(int nSumType, uint8_t *data, size_t size, string &strOutput)
 {
     strOutput.clear();
-    if (1 == nSumType)
+    ZSHAHasher &hasher = _GetThreadHasher(nSumType);
+    if (!hasher.Sum(data, size, strOutput))
     {
-        uint8_t hash[20];
-        memset(hash, 0, 20);
-        SHA1(data, size, hash);
-        strOutput.append((const char *)hash, 20);
+        strOutput.assign(hasher.GetHashSize(), 0);
+        return false;
     }
-    else
+    return true;
+}
+
+#define SHASUM_PREFETCH_WINDOW (8 * 1024 * 1024)
+
+static void _AdviseRange(const uint8_t *data, size_t size, int advice)
+{ // madvise wants a page aligned start, and advice is only a hint so failures are ignored
+    static const uintptr_t uPageMask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+    uintptr_t uBegin = (uintptr_t)data & ~uPageMask;
+    uintptr_t uEnd = (uintptr_t)data + size;
+    if (uEnd > uBegin)
     {
-        uint8_t hash[32];
-        memset(hash, 0, 32);
-        SHA256(data, size, hash);
-        strOutput.append((const char *)hash, 32);
+        madvise((void *)uBegin, uEnd - uBegin, advice);
     }
-    return true;
+}
+
+bool SHASumPages(int nSumType, const uint8_t *data, size_t size, uint32_t uPageSize, string &strOutput)
+{
+    if (0 == uPageSize)
+    {
+        return false;
+    }
+
+    bool bPrefetch = (size >= SHASUM_PREFETCH_WINDOW);
+    size_t uPrefetched = 0;
+    if (bPrefetch)
+    { // a freshly mapped image would otherwise fault in one page at a time on this thread
+        _AdviseRange(data, size, MADV_SEQUENTIAL);
+    }
+
+    ZSHAHasher &hasher = _GetThreadHasher(nSumType);
+    strOutput.reserve(strOutput.size() + ((size + uPageSize - 1) / uPageSize) * hasher.GetHashSize());
+    bool bRet = true;
+    for (size_t uOffset = 0; bRet && uOffset < size; uOffset += uPageSize)
+    {
+        if (bPrefetch && uPrefetched < size && uOffset + SHASUM_PREFETCH_WINDOW / 2 >= uPrefetched)
+        { // keep about one window of reads in flight ahead of the cursor
+            size_t uWindow = min(size - uPrefetched, (size_t)SHASUM_PREFETCH_WINDOW);
+            _AdviseRange(data + uPrefetched, uWindow, MADV_WILLNEED);
+            uPrefetched += uWindow;
+        }
+
+        size_t uLength = (size - uOffset < uPageSize) ? (size - uOffset) : uPageSize;
+        bRet = hasher.Sum(data + uOffset, uLength, strOutput);
+    }
+
+    if (bPrefetch)
+    { // the rest of signing touches the mapping randomly again
+        _AdviseRange(data, size, MADV_NORMAL);
+    }
+    return bRet;
 }
 
 bool SHASum(int nSumType, const string &strData, string &strOutput)
@@ -586,19 +761,36 @@ bool SHASum(const string &strData, string &strSHA1, string &strSHA256)
     return (!strSHA1.empty() && !strSHA256.empty());
 }
 
-bool SHASumFile(const char *szFile, string &strSHA1, string &strSHA256)
+bool SHASumFile(const char *szFile, string &strSHA1, string &strSHA256, bool bSHA1)
 {
     size_t sSize = 0;
-    uint8_t *pBase = (uint8_t *)MapFile(szFile, 0, 0, &sSize, true);
-
-    SHASum(E_SHASUM_TYPE_1, pBase, sSize, strSHA1);
-    SHASum(E_SHASUM_TYPE_256, pBase, sSize, strSHA256);
+    uint8_t *pBase = (uint8_t *)MapFile(szFile, 0, 0, &sSize, true, true);
+
+    strSHA1.clear();
+    strSHA256.clear();
+    if (NULL != pBase || 0 == sSize)
+    { // both digests walk the mapping together, so each chunk is read from memory once
+        ZSHAHasher &hasherSHA1 = _GetThreadHasher(E_SHASUM_TYPE_1);
+        ZSHAHasher &hasherSHA256 = _GetThreadHasher(E_SHASUM_TYPE_256);
+        bool bOK = ((!bSHA1 || hasherSHA1.Init()) && hasherSHA256.Init());
+        for (size_t uOffset = 0; bOK && uOffset < sSize; uOffset += 1024 * 1024)
+        {
+            size_t uLength = min(sSize - uOffset, (size_t)(1024 * 1024));
+            bOK = ((!bSHA1 || hasherSHA1.Update(pBase + uOffset, uLength)) &&
+                   hasherSHA256.Update(pBase + uOffset, uLength));
+        }
+        if (!bOK || (bSHA1 && !hasherSHA1.Final(strSHA1)) || !hasherSHA256.Final(strSHA256))
+        {
+            strSHA1.clear();
+            strSHA256.clear();
+        }
+    }
 
     if (NULL != pBase && sSize > 0)
     {
         munmap(pBase, sSize);
     }
-    return (!strSHA1.empty() && !strSHA256.empty());
+    return ((!bSHA1 || !strSHA1.empty()) && !strSHA256.empty());
 }
 
 bool SHASumBase64(const string &strData, string &strSHA1Base64, string &strSHA256Base64)
@@ -612,15 +804,15 @@ bool SHASumBase64(const string &strData, string &strSHA1Base64, string &strSHA25
     return (!strSHA1Base64.empty() && !strSHA256Base64.empty());
 }
 
-bool SHASumBase64File(const char *szFile, string &strSHA1Base64, string &strSHA256Base64)
+bool SHASumBase64File(const char *szFile, string &strSHA1Base64, string &strSHA256Base64, bool bSHA1)
 {
     ZBase64 b64;
     string strSHA1;
     string strSHA256;
-    SHASumFile(szFile, strSHA1, strSHA256);
-    strSHA1Base64 = b64.Encode(strSHA1);
+    SHASumFile(szFile, strSHA1, strSHA256, bSHA1);
+    strSHA1Base64 = bSHA1 ? b64.Encode(strSHA1) : "";
     strSHA256Base64 = b64.Encode(strSHA256);
-    return (!strSHA1Base64.empty() && !strSHA256Base64.empty());
+    return ((!bSHA1 || !strSHA1Base64.empty()) && !strSHA256Base64.empty());
 }
 
 ZBuffer::ZBuffer()
@@ -660,6 +852,277 @@ void ZBuffer::Free()
     m_uSize = 0;
 }
 
+ZFileWriter::ZFileWriter()
+{
+    m_fd = -1;
+    m_bFailed = false;
+    m_uOffset = 0;
+    m_pBuffer = NULL;
+    m_sBuffered = 0;
+}
+
+ZFileWriter::~ZFileWriter() { Close(); }
+
+bool ZFileWriter::Open(const char *szFile, uint64_t uSizeHint, bool bAppend)
+{
+    Close();
+    if (NULL == szFile)
+    {
+        return false;
+    }
+
+    m_fd = open(szFile, O_WRONLY | O_CREAT | (bAppend ? 0 : O_TRUNC), 0644);
+    if (m_fd < 0)
+    {
+        return false;
+    }
+
+    m_bFailed = false;
+    m_sBuffered = 0;
+    m_uOffset = bAppend ? (uint64_t)GetFileSize(m_fd) : 0;
+
+    if (uSizeHint > 0)
+    { // only a layout hint, the file size is still whatever gets written
+#if defined(__APPLE__)
+        fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)uSizeHint, 0};
+        if (-1 == fcntl(m_fd, F_PREALLOCATE, &store))
+        {
+            store.fst_flags = F_ALLOCATEALL;
+            fcntl(m_fd, F_PREALLOCATE, &store);
+        }
+#elif defined(__linux__)
+        fallocate(m_fd, FALLOC_FL_KEEP_SIZE, (off_t)m_uOffset, (off_t)uSizeHint);
+#endif
+    }
+    return true;
+}
+
+bool ZFileWriter::Write(const void *pData, size_t sLen)
+{
+    const char *pCursor = (const char *)pData;
+    while (sLen > 0 && !m_bFailed)
+    {
+        if (0 == m_sBuffered && sLen >= FILE_WRITER_BUFFER_SIZE)
+        { // whole buffers go out directly from the caller's memory
+            size_t sDirect = sLen - (sLen % FILE_WRITER_BUFFER_SIZE);
+            PWrite(pCursor, sDirect);
+            pCursor += sDirect;
+            sLen -= sDirect;
+            continue;
+        }
+
+        if (NULL == GetBuffer())
+        {
+            break;
+        }
+
+        size_t sCopy = min(sLen, (size_t)FILE_WRITER_BUFFER_SIZE - m_sBuffered);
+        memcpy(m_pBuffer + m_sBuffered, pCursor, sCopy);
+        m_sBuffered += sCopy;
+        pCursor += sCopy;
+        sLen -= sCopy;
+        if (FILE_WRITER_BUFFER_SIZE == m_sBuffered)
+        {
+            Flush();
+        }
+    }
+    return (m_fd >= 0 && !m_bFailed);
+}
+
+bool ZFileWriter::Write(const string &strData) { return Write(strData.data(), strData.size()); }
+
+bool ZFileWriter::WriteZero(uint64_t uLen)
+{
+    while (uLen > 0 && !m_bFailed && NULL != GetBuffer())
+    {
+        size_t sFill = (size_t)min(uLen, (uint64_t)(FILE_WRITER_BUFFER_SIZE - m_sBuffered));
+        memset(m_pBuffer + m_sBuffered, 0, sFill);
+        m_sBuffered += sFill;
+        uLen -= sFill;
+        if (FILE_WRITER_BUFFER_SIZE == m_sBuffered)
+        {
+            Flush();
+        }
+    }
+    return (m_fd >= 0 && !m_bFailed);
+}
+
+bool ZFileWriter::WriteFrom(int fdSrc, uint64_t uSrcOffset, uint64_t uLen)
+{
+    if (m_fd < 0 || !Flush())
+    {
+        return false;
+    }
+
+    if (fdSrc < 0)
+    {
+        m_bFailed = true;
+        return false;
+    }
+
+#if defined(__linux__)
+    struct file_clone_range range = {(int64_t)fdSrc, uSrcOffset, uLen, m_uOffset};
+    if (uLen > 0 && 0 == ioctl(m_fd, FICLONERANGE, &range))
+    { // reflink, needs block aligned offsets on a filesystem that shares extents
+        m_uOffset += uLen;
+        return true;
+    }
+
+    loff_t nSrcOffset = (loff_t)uSrcOffset;
+    loff_t nDstOffset = (loff_t)m_uOffset;
+    while (uLen > 0)
+    {
+        ssize_t nCopy = copy_file_range(fdSrc, &nSrcOffset, m_fd, &nDstOffset, (size_t)uLen, 0);
+        if (nCopy < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (nCopy <= 0)
+        {
+            break;
+        }
+        uSrcOffset += (uint64_t)nCopy;
+        m_uOffset += (uint64_t)nCopy;
+        uLen -= (uint64_t)nCopy;
+    }
+
+    if (uLen > 0 && (off_t)m_uOffset == lseek(m_fd, (off_t)m_uOffset, SEEK_SET))
+    { // sendfile writes at the descriptor position rather than an explicit offset
+        off_t nOffset = (off_t)uSrcOffset;
+        while (uLen > 0)
+        {
+            ssize_t nSend = sendfile(m_fd, fdSrc, &nOffset, (size_t)uLen);
+            if (nSend < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            if (nSend <= 0)
+            {
+                break;
+            }
+            uSrcOffset += (uint64_t)nSend;
+            m_uOffset += (uint64_t)nSend;
+            uLen -= (uint64_t)nSend;
+        }
+    }
+#endif
+
+    while (uLen > 0 && !m_bFailed && NULL != GetBuffer())
+    { // userspace fallback, one buffer at a time
+        size_t sRead = (size_t)min(uLen, (uint64_t)FILE_WRITER_BUFFER_SIZE);
+        ssize_t nRead = pread(fdSrc, m_pBuffer, sRead, (off_t)uSrcOffset);
+        if (nRead < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (nRead <= 0)
+        {
+            m_bFailed = true;
+            break;
+        }
+        PWrite(m_pBuffer, (size_t)nRead);
+        uSrcOffset += (uint64_t)nRead;
+        uLen -= (uint64_t)nRead;
+    }
+    return !m_bFailed;
+}
+
+bool ZFileWriter::Close()
+{
+    if (m_fd < 0)
+    {
+        return false;
+    }
+
+    Flush();
+    if (0 != close(m_fd))
+    {
+        m_bFailed = true;
+    }
+    m_fd = -1;
+    return !m_bFailed;
+}
+
+bool ZFileWriter::Flush()
+{
+    if (m_sBuffered > 0)
+    {
+        PWrite(m_pBuffer, m_sBuffered);
+        m_sBuffered = 0;
+    }
+    return !m_bFailed;
+}
+
+bool ZFileWriter::PWrite(const char *pData, size_t sLen)
+{
+    if (!m_bFailed && !_PWriteAll(m_fd, pData, sLen, m_uOffset))
+    {
+        m_bFailed = true;
+    }
+    m_uOffset += m_bFailed ? 0 : sLen;
+    return !m_bFailed;
+}
+
+char *ZFileWriter::GetBuffer()
+{ // allocated on the first streamed write, whole-buffer writes never need it
+    if (NULL == m_pBuffer)
+    {
+        m_pBuffer = m_Buffer.GetBuffer(FILE_WRITER_BUFFER_SIZE);
+        m_bFailed = m_bFailed || (NULL == m_pBuffer);
+    }
+    return m_pBuffer;
+}
+
+ZSHASumCache::ZSHASumCache(bool bSHA1)
+{
+    m_bSHA1 = bSHA1;
+    m_uHashed = 0;
+    m_uShared = 0;
+}
+
+bool ZSHASumCache::SHASumBase64File(const char *szFile, uint64_t uDevice, uint64_t uInode, string &strSHA1Base64,
+                                    string &strSHA256Base64)
+{
+    if (0 == uInode)
+    { // no file id from the walk, nothing to share it with
+        m_uHashed++;
+        return ::SHASumBase64File(szFile, strSHA1Base64, strSHA256Base64, m_bSHA1);
+    }
+
+    pair<uint64_t, uint64_t> inode(uDevice, uInode);
+    map<pair<uint64_t, uint64_t>, size_t>::iterator itInode = m_mapInodes.find(inode);
+    if (itInode != m_mapInodes.end())
+    { // hardlink, or the same path again, nothing is read
+        m_uShared++;
+        strSHA1Base64 = m_arrEntries[itInode->second].strSHA1Base64;
+        strSHA256Base64 = m_arrEntries[itInode->second].strSHA256Base64;
+        return ((!m_bSHA1 || !strSHA1Base64.empty()) && !strSHA256Base64.empty());
+    }
+
+    // only hardlinks are shared, separate files with identical content are each hashed
+    Entry entry;
+    m_uHashed++;
+    bool bRet = ::SHASumBase64File(szFile, entry.strSHA1Base64, entry.strSHA256Base64, m_bSHA1);
+    m_mapInodes[inode] = m_arrEntries.size();
+    m_arrEntries.push_back(entry);
+
+    strSHA1Base64 = entry.strSHA1Base64;
+    strSHA256Base64 = entry.strSHA256Base64;
+    return bRet;
+}
+
+size_t ZSHASumCache::GetHashedCount() const { return m_uHashed; }
+
+size_t ZSHASumCache::GetSharedCount() const { return m_uShared; }
+
+void ZSHASumCache::Clear()
+{
+    m_uHashed = 0;
+    m_uShared = 0;
+    m_arrEntries.clear();
+    m_mapInodes.clear();
+}
+
 ZTimer::ZTimer() { Reset(); }
 
 uint64_t ZTimer::Reset()
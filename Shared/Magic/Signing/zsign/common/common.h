@@ -75,7 +75,8 @@ int64_t GetFileSizeV(const char *szFormatPath, ...);
 string GetFileSizeString(const char *szFile);
 bool IsZipFile(const char *szFile);
 string GetCanonicalizePath(const char *szPath);
-void *MapFile(const char *path, size_t offset, size_t size, size_t *psize, bool ro);
+void *MapFile(const char *path, size_t offset, size_t size, size_t *psize, bool ro, bool populate = false);
+bool CloneFile(const char *szSrcFile, const char *szDstFile);
 bool IsPathSuffix(const string &strPath, const char *suffix);
 
 const char *StringFormat(string &strFormat, const char *szFormatArgs, ...);
@@ -86,7 +87,7 @@ string FormatSize(int64_t size, int64_t base = 1024);
 time_t GetUnixStamp();
 uint64_t GetMicroSecond();
 bool SystemExec(const char *szFormatCmd, ...);
-uint32_t ByteAlign(uint32_t uValue, uint32_t uAlign);
+uint64_t ByteAlign(uint64_t uValue, uint64_t uAlign);
 
 enum
 {
@@ -94,13 +95,40 @@ enum
     E_SHASUM_TYPE_256 = 2,
 };
 
+/**
+ * Incremental SHA-1/SHA-256 over a digest fetched once per process.
+ * The EVP_MD_CTX is allocated with the hasher and reset by Init, so one hasher can digest many buffers.
+ */
+class ZSHAHasher
+{
+  public:
+    ZSHAHasher(int nSumType);
+    ~ZSHAHasher();
+
+  public:
+    bool Init();
+    bool Update(const uint8_t *data, size_t size);
+    bool Final(string &strOutput);
+    bool Sum(const uint8_t *data, size_t size, string &strOutput);
+    uint32_t GetHashSize() const;
+
+  private:
+    ZSHAHasher(const ZSHAHasher &);
+    ZSHAHasher &operator=(const ZSHAHasher &);
+
+  private:
+    int m_nSumType;
+    void *m_pCtx;
+};
+
 bool SHASum(int nSumType, uint8_t *data, size_t size, string &strOutput);
+bool SHASumPages(int nSumType, const uint8_t *data, size_t size, uint32_t uPageSize, string &strOutput);
 bool SHASum(int nSumType, const string &strData, string &strOutput);
 bool SHASum(const string &strData, string &strSHA1, string &strSHA256);
 bool SHA1Text(const string &strData, string &strOutput);
-bool SHASumFile(const char *szFile, string &strSHA1, string &strSHA256);
+bool SHASumFile(const char *szFile, string &strSHA1, string &strSHA256, bool bSHA1 = true);
 bool SHASumBase64(const string &strData, string &strSHA1Base64, string &strSHA256Base64);
-bool SHASumBase64File(const char *szFile, string &strSHA1Base64, string &strSHA256Base64);
+bool SHASumBase64File(const char *szFile, string &strSHA1Base64, string &strSHA256Base64, bool bSHA1 = true);
 void PrintSHASum(const char *prefix, const uint8_t *hash, uint32_t size, const char *suffix = "\n");
 void PrintSHASum(const char *prefix, const string &strSHASum, const char *suffix = "\n");
 void PrintDataSHASum(const char *prefix, int nSumType, const string &strData, const char *suffix = "\n");
@@ -123,6 +151,70 @@ class ZBuffer
     uint32_t m_uSize;
 };
 
+/**
+ * Sequential file writer that keeps one descriptor open for the whole output.
+ * Data is staged in a 1 MiB buffer and issued as pwrite()s at buffer-aligned offsets, large runs bypass the
+ * buffer, and the expected size is preallocated up front so a slice is laid out without repeated extension.
+ * WriteFrom copies a range of another descriptor in-kernel (reflink, copy_file_range, sendfile) where it can.
+ */
+class ZFileWriter
+{
+  public:
+    ZFileWriter();
+    ~ZFileWriter();
+
+  public:
+    bool Open(const char *szFile, uint64_t uSizeHint = 0, bool bAppend = false);
+    bool Write(const void *pData, size_t sLen);
+    bool Write(const string &strData);
+    bool WriteZero(uint64_t uLen);
+    bool WriteFrom(int fdSrc, uint64_t uSrcOffset, uint64_t uLen);
+    bool Close();
+
+  private:
+    bool Flush();
+    bool PWrite(const char *pData, size_t sLen);
+    char *GetBuffer();
+
+  private:
+    ZFileWriter(const ZFileWriter &);
+    ZFileWriter &operator=(const ZFileWriter &);
+
+  private:
+    int m_fd;
+    bool m_bFailed;
+    uint64_t m_uOffset;
+    ZBuffer m_Buffer;
+    char *m_pBuffer;
+    size_t m_sBuffered;
+};
+
+class ZSHASumCache
+{
+  public:
+    ZSHASumCache(bool bSHA1 = true);
+
+  public:
+    bool SHASumBase64File(const char *szFile, uint64_t uDevice, uint64_t uInode, string &strSHA1Base64,
+                          string &strSHA256Base64);
+    size_t GetHashedCount() const;
+    size_t GetSharedCount() const;
+    void Clear();
+
+  private:
+    struct Entry
+    {
+        string strSHA1Base64;
+        string strSHA256Base64;
+    };
+
+    bool m_bSHA1;
+    size_t m_uHashed;
+    size_t m_uShared;
+    vector<Entry> m_arrEntries;
+    map<pair<uint64_t, uint64_t>, size_t> m_mapInodes;
+};
+
 class ZTimer
 {
   public:
@@ -0,0 +1,221 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#include "dirwalk.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+
+#define DIR_BATCH_SIZE (64 * 1024)
+
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+ZPathArena::ZPathArena(size_t uBlockSize)
+{
+    m_uBlockSize = uBlockSize;
+    m_uBlockUsed = 0;
+}
+
+ZPathArena::~ZPathArena() { Clear(); }
+
+const char *ZPathArena::Intern(const char *szPath, size_t uLength)
+{
+    size_t uNeed = uLength + 1;
+    if (m_arrBlocks.empty() || m_uBlockUsed + uNeed > m_uBlockSize)
+    {
+        char *pBlock = (char *)malloc(uNeed > m_uBlockSize ? uNeed : m_uBlockSize);
+        if (NULL == pBlock)
+        {
+            return NULL;
+        }
+
+        if (uNeed > m_uBlockSize && !m_arrBlocks.empty())
+        { // oversized path, keep filling the current block afterwards
+            m_arrBlocks.insert(m_arrBlocks.end() - 1, pBlock);
+            memcpy(pBlock, szPath, uLength);
+            pBlock[uLength] = 0;
+            return pBlock;
+        }
+
+        m_arrBlocks.push_back(pBlock);
+        m_uBlockUsed = 0;
+    }
+
+    char *pPath = m_arrBlocks.back() + m_uBlockUsed;
+    memcpy(pPath, szPath, uLength);
+    pPath[uLength] = 0;
+    m_uBlockUsed += uNeed;
+    return pPath;
+}
+
+const char *ZPathArena::Intern(const string &strPath) { return Intern(strPath.data(), strPath.size()); }
+
+void ZPathArena::Clear()
+{
+    for (size_t i = 0; i < m_arrBlocks.size(); i++)
+    {
+        free(m_arrBlocks[i]);
+    }
+    m_arrBlocks.clear();
+    m_uBlockUsed = 0;
+}
+
+ZDirReader::ZDirReader()
+{
+    m_nFD = -1;
+    m_uDevice = 0;
+    m_uInode = 0;
+#if defined(__linux__)
+    m_pBuffer = NULL;
+    m_nBufferLength = 0;
+    m_nBufferOffset = 0;
+#else
+    m_pDir = NULL;
+#endif
+}
+
+ZDirReader::~ZDirReader() { Close(); }
+
+bool ZDirReader::Open(const char *szFolder)
+{
+    Close();
+    return Attach(open(szFolder, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+}
+
+bool ZDirReader::OpenAt(int nDirFD, const char *szName)
+{
+    Close();
+    return Attach(openat(nDirFD, szName, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW));
+}
+
+bool ZDirReader::Attach(int nFD)
+{
+    if (nFD < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    m_uDevice = (0 == fstat(nFD, &st)) ? (uint64_t)st.st_dev : 0; // every file entry lives on the folder's device
+    m_uInode = 0;
+
+#if defined(__linux__)
+    m_pBuffer = (char *)malloc(DIR_BATCH_SIZE);
+    if (NULL == m_pBuffer)
+    {
+        close(nFD);
+        return false;
+    }
+    m_nBufferLength = 0;
+    m_nBufferOffset = 0;
+#else
+    m_pDir = fdopendir(nFD);
+    if (NULL == m_pDir)
+    {
+        close(nFD);
+        return false;
+    }
+#endif
+
+    m_nFD = nFD;
+    return true;
+}
+
+bool ZDirReader::Read(const char *&szName, bool &bFolder, bool &bFile)
+{
+    while (m_nFD >= 0)
+    {
+        unsigned char uType = DT_UNKNOWN;
+#if defined(__linux__)
+        if (m_nBufferOffset >= m_nBufferLength)
+        {
+            m_nBufferLength = syscall(SYS_getdents64, m_nFD, m_pBuffer, DIR_BATCH_SIZE);
+            m_nBufferOffset = 0;
+            if (m_nBufferLength <= 0)
+            {
+                return false;
+            }
+        }
+
+        linux_dirent64 *pEntry = reinterpret_cast<linux_dirent64 *>(m_pBuffer + m_nBufferOffset);
+        m_nBufferOffset += pEntry->d_reclen;
+        szName = pEntry->d_name;
+        uType = pEntry->d_type;
+        m_uInode = pEntry->d_ino;
+#else
+        dirent *pEntry = readdir(m_pDir);
+        if (NULL == pEntry)
+        {
+            return false;
+        }
+        szName = pEntry->d_name;
+        uType = pEntry->d_type;
+        m_uInode = (uint64_t)pEntry->d_ino;
+#endif
+
+        if ('.' == szName[0] && (0 == szName[1] || ('.' == szName[1] && 0 == szName[2])))
+        {
+            continue;
+        }
+
+        if (DT_UNKNOWN == uType)
+        { // entry type can be unknown depending on the underlying file system
+            struct stat st;
+            if (0 == fstatat(m_nFD, szName, &st, AT_SYMLINK_NOFOLLOW))
+            {
+                uType = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN);
+                m_uInode = (uint64_t)st.st_ino;
+            }
+        }
+
+        bFolder = (DT_DIR == uType);
+        bFile = (DT_REG == uType);
+        return true;
+    }
+    return false;
+}
+
+int ZDirReader::GetFD() const { return m_nFD; }
+
+uint64_t ZDirReader::GetDevice() const { return m_uDevice; }
+
+uint64_t ZDirReader::GetInode() const { return m_uInode; }
+
+void ZDirReader::Close()
+{
+#if defined(__linux__)
+    if (NULL != m_pBuffer)
+    {
+        free(m_pBuffer);
+        m_pBuffer = NULL;
+    }
+    if (m_nFD >= 0)
+    {
+        close(m_nFD);
+    }
+#else
+    if (NULL != m_pDir)
+    {
+        closedir(m_pDir); // owns m_nFD
+        m_pDir = NULL;
+    }
+#endif
+    m_nFD = -1;
+}
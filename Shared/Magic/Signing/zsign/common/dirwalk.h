@@ -0,0 +1,81 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#pragma once
+#include "common.h"
+
+/**
+ * Bump allocator for the relative paths collected while walking a bundle.
+ * Paths live until the arena is cleared or destroyed.
+ */
+class ZPathArena
+{
+  public:
+    ZPathArena(size_t uBlockSize = 64 * 1024);
+    ~ZPathArena();
+
+  public:
+    const char *Intern(const char *szPath, size_t uLength);
+    const char *Intern(const string &strPath);
+    void Clear();
+
+  private:
+    size_t m_uBlockSize;
+    size_t m_uBlockUsed;
+    vector<char *> m_arrBlocks;
+};
+
+/**
+ * A regular file found by a folder walk, with the file id its directory entry already carried.
+ */
+struct ZDirFile
+{
+    const char *szPath;
+    uint64_t uDevice;
+    uint64_t uInode;
+};
+
+/**
+ * Reads the entries of one directory through its file descriptor, so children can be
+ * opened with openat/fstatat instead of resolving the full path again.
+ * Entries are read in large getdents64 batches on Linux and through readdir elsewhere.
+ */
+class ZDirReader
+{
+  public:
+    ZDirReader();
+    ~ZDirReader();
+
+  public:
+    bool Open(const char *szFolder);
+    bool OpenAt(int nDirFD, const char *szName);
+    bool Read(const char *&szName, bool &bFolder, bool &bFile);
+    int GetFD() const;
+    uint64_t GetDevice() const;
+    uint64_t GetInode() const;
+    void Close();
+
+  private:
+    bool Attach(int nFD);
+
+  private:
+    int m_nFD;
+    uint64_t m_uDevice;
+    uint64_t m_uInode; // of the entry Read returned last
+#if defined(__linux__)
+    char *m_pBuffer;
+    long m_nBufferLength;
+    long m_nBufferOffset;
+#else
+    DIR *m_pDir;
+#endif
+};
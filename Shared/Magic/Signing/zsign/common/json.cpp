@@ -17,8 +17,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <tuple>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #ifndef WIN32
 #define _atoi64(val) strtoll(val, NULL, 10)
@@ -43,6 +52,13 @@ JValue::JValue(const string &val) : m_eType(E_STRING) { m_Value.vString = NewStr
 
 JValue::JValue(const JValue &other) { CopyValue(other); }
 
+JValue::JValue(JValue &&other) noexcept : m_eType(other.m_eType)
+{
+    m_Value = other.m_Value;
+    other.m_eType = E_NULL;
+    other.m_Value.vFloat = 0;
+}
+
 JValue::JValue(const char *val, size_t len) : m_eType(E_DATA)
 {
     m_Value.vData = new string();
@@ -132,7 +148,8 @@ void JValue::CopyValue(const JValue &src)
             m_Value.vArray = (NULL == src.m_Value.vArray) ? NULL : new vector<JValue>(*(src.m_Value.vArray));
             break;
         case E_OBJECT:
-            m_Value.vObject = (NULL == src.m_Value.vObject) ? NULL : new map<string, JValue>(*(src.m_Value.vObject));
+            m_Value.vObject =
+                (NULL == src.m_Value.vObject) ? NULL : new map<string, JValue, less<>>(*(src.m_Value.vObject));
             break;
         case E_STRING:
             m_Value.vString = (NULL == src.m_Value.vString) ? NULL : NewString(src.m_Value.vString);
@@ -232,6 +249,16 @@ JValue &JValue::operator=(const JValue &other)
     return (*this);
 }
 
+JValue &JValue::operator=(JValue &&other) noexcept
+{
+    if (this != &other)
+    { // other may live inside this tree, take it out before the old value is freed
+        JValue jvTake(std::move(other));
+        swap(jvTake);
+    }
+    return (*this);
+}
+
 JValue &JValue::operator=(int val)
 {
     Free();
@@ -474,36 +501,38 @@ const JValue &JValue::operator[](size_t index) const
     return null;
 }
 
-JValue &JValue::operator[](const string &key) { return (*this)[key.c_str()]; }
+JValue &JValue::operator[](const string &key) { return (*this)[string_view(key)]; }
+
+const JValue &JValue::operator[](const string &key) const { return (*this)[string_view(key)]; }
 
-const JValue &JValue::operator[](const string &key) const { return (*this)[key.c_str()]; }
+JValue &JValue::operator[](const char *key) { return (*this)[string_view(key)]; }
 
-JValue &JValue::operator[](const char *key)
+const JValue &JValue::operator[](const char *key) const { return (*this)[string_view(key)]; }
+
+JValue &JValue::operator[](string_view key)
 {
-    map<string, JValue>::iterator it;
     if (E_OBJECT != m_eType || NULL == m_Value.vObject)
     {
         Free();
         m_eType = E_OBJECT;
-        m_Value.vObject = new map<string, JValue>();
+        m_Value.vObject = new map<string, JValue, less<>>();
     }
-    else
+
+    // the key string is only built when a new member is inserted, right at its sorted position
+    map<string, JValue, less<>>::iterator it = m_Value.vObject->lower_bound(key);
+    if (it != m_Value.vObject->end() && it->first == key)
     {
-        it = m_Value.vObject->find(key);
-        if (it != m_Value.vObject->end())
-        {
-            return it->second;
-        }
+        return it->second;
     }
-    it = m_Value.vObject->insert(m_Value.vObject->end(), make_pair(key, null));
+    it = m_Value.vObject->emplace_hint(it, piecewise_construct, forward_as_tuple(key), forward_as_tuple());
     return it->second;
 }
 
-const JValue &JValue::operator[](const char *key) const
+const JValue &JValue::operator[](string_view key) const
 {
     if (E_OBJECT == m_eType && NULL != m_Value.vObject)
     {
-        map<string, JValue>::const_iterator it = m_Value.vObject->find(key);
+        map<string, JValue, less<>>::const_iterator it = m_Value.vObject->find(key);
         if (it != m_Value.vObject->end())
         {
             return it->second;
@@ -512,7 +541,7 @@ const JValue &JValue::operator[](const char *key) const
     return null;
 }
 
-bool JValue::has(const char *key) const
+bool JValue::has(string_view key) const
 {
     if (E_OBJECT == m_eType && NULL != m_Value.vObject)
     {
@@ -569,14 +598,15 @@ bool JValue::remove(size_t index)
     return false;
 }
 
-bool JValue::remove(const char *key)
+bool JValue::remove(string_view key)
 {
     if (E_OBJECT == m_eType && NULL != m_Value.vObject)
     {
-        if (m_Value.vObject->end() != m_Value.vObject->find(key))
+        map<string, JValue, less<>>::iterator it = m_Value.vObject->find(key);
+        if (m_Value.vObject->end() != it)
         {
-            m_Value.vObject->erase(key);
-            return !has(key);
+            m_Value.vObject->erase(it);
+            return true;
         }
     }
     return false;
@@ -587,8 +617,8 @@ bool JValue::keys(vector<string> &arrKeys) const
     if (E_OBJECT == m_eType && NULL != m_Value.vObject)
     {
         arrKeys.reserve(m_Value.vObject->size());
-        map<string, JValue>::iterator itbeg = m_Value.vObject->begin();
-        map<string, JValue>::iterator itend = m_Value.vObject->end();
+        map<string, JValue, less<>>::iterator itbeg = m_Value.vObject->begin();
+        map<string, JValue, less<>>::iterator itend = m_Value.vObject->end();
         for (; itbeg != itend; itbeg++)
         {
             arrKeys.push_back((itbeg->first).c_str());
@@ -701,6 +731,63 @@ bool JValue::append(JValue &jv)
     return false;
 }
 
+bool JValue::splice(JValue &jv)
+{
+    if (this == &jv)
+    {
+        return false;
+    }
+
+    if ((E_OBJECT == m_eType || E_NULL == m_eType) && E_OBJECT == jv.type())
+    {
+        if (NULL != jv.m_Value.vObject)
+        {
+            map<string, JValue, less<>>::iterator it = jv.m_Value.vObject->begin();
+            for (; it != jv.m_Value.vObject->end(); it++)
+            {
+                (*this)[it->first] = std::move(it->second);
+            }
+        }
+        jv.clear();
+        return true;
+    }
+    else if ((E_ARRAY == m_eType || E_NULL == m_eType) && E_ARRAY == jv.type())
+    {
+        if (NULL != jv.m_Value.vArray)
+        {
+            for (size_t i = 0; i < jv.m_Value.vArray->size(); i++)
+            {
+                emplace_back() = std::move((*jv.m_Value.vArray)[i]);
+            }
+        }
+        jv.clear();
+        return true;
+    }
+
+    return false;
+}
+
+JValue JValue::steal(string_view key)
+{
+    JValue jv;
+    if (E_OBJECT == m_eType && NULL != m_Value.vObject)
+    {
+        map<string, JValue, less<>>::iterator it = m_Value.vObject->find(key);
+        if (it != m_Value.vObject->end())
+        {
+            jv = std::move(it->second);
+            m_Value.vObject->erase(it);
+        }
+    }
+    return jv;
+}
+
+void JValue::swap(JValue &other) noexcept
+{
+    std::swap(m_eType, other.m_eType);
+    std::swap(m_Value, other.m_Value);
+}
+
 bool JValue::push_back(int val) { return push_back(JValue(val)); }
 
 bool JValue::push_back(bool val) { return push_back(JValue(val)); }
@@ -723,8 +810,38 @@ bool JValue::push_back(const JValue &jval)
     return false;
 }
 
+bool JValue::push_back(JValue &&jval)
+{
+    if (E_ARRAY == m_eType || E_NULL == m_eType)
+    { // jval may be one of our own elements, take it out before the array grows
+        JValue jvTake(std::move(jval));
+        emplace_back().swap(jvTake);
+        return true;
+    }
+    return false;
+}
+
 bool JValue::push_back(const char *val, size_t len) { return push_back(JValue(val, len)); }
 
+JValue &JValue::emplace_back(TYPE type)
+{
+    if (E_ARRAY != m_eType || NULL == m_Value.vArray)
+    {
+        Free();
+        m_eType = E_ARRAY;
+        m_Value.vArray = new vector<JValue>();
+    }
+    m_Value.vArray->emplace_back(type);
+    return m_Value.vArray->back();
+}
+
+JValue &JValue::emplace(string_view key, JValue &&jval)
+{
+    JValue &jvSlot = (*this)[key];
+    jvSlot = std::move(jval);
+    return jvSlot;
+}
+
 std::string JValue::styleWrite() const
 {
     string strDoc;
@@ -800,9 +917,12 @@ string JValue::asData() const
             {
                 ZBase64 b64;
                 int nDataLen = 0;
-                const char *pdata = b64.Decode(m_Value.vString + 5, 0, &nDataLen);
+                const char *pdata = b64.Decode(m_Value.vString + 5, (int)strlen(m_Value.vString + 5), &nDataLen);
                 string strdata;
-                strdata.append(pdata, nDataLen);
+                if (NULL != pdata)
+                {
+                    strdata.append(pdata, nDataLen);
+                }
                 return strdata;
             }
         }
@@ -991,9 +1111,18 @@ bool JValue::writeFile(const char *file)
 
 bool JValue::writePListFile(const char *file)
 {
-    string strdata;
-    writePList(strdata);
-    return WriteDataToFile(file, strdata.data(), strdata.size());
+    if (NULL == file)
+    {
+        return false;
+    }
+
+    int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool bRet = PWriter::FastWrite(*this, fd);
+    return (0 == close(fd)) && bRet;
 }
 
 bool JValue::styleWriteFile(const char *file)
@@ -2817,166 +2946,357 @@ void PReader::XMLUnescape(string &strval)
 }
 
 //////////////////////////////////////////////////////////////////////////
+#define PWRITER_BUFFER_SIZE (1024 * 1024)
+
+static const char s_szPListHeader[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+    "<plist version=\"1.0\">\n";
+static const char s_szPListFooter[] = "</plist>";
+
+PWriter::PWriter(string &strout, int fd) : m_strOut(strout), m_fd(fd), m_bFailed(false) {}
+
 void PWriter::FastWrite(const JValue &pval, string &strdoc)
 {
     strdoc.clear();
-    strdoc =
-        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-        "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
-        "<plist version=\"1.0\">\n";
+    strdoc.reserve(MeasureDocument(pval));
+    PWriter writer(strdoc, -1);
+    writer.WriteDocument(pval);
+}
 
-    string strindent;
-    FastWriteValue(pval, strdoc, strindent);
+bool PWriter::FastWrite(const JValue &pval, int fd)
+{
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    string strbuf;
+    strbuf.reserve(min(MeasureDocument(pval), (size_t)PWRITER_BUFFER_SIZE) + 4096);
+    PWriter writer(strbuf, fd);
+    writer.WriteDocument(pval);
+    return writer.Flush();
+}
 
-    strdoc += "</plist>";
+void PWriter::Put(const char *data, size_t size)
+{
+    m_strOut.append(data, size);
+    if (m_fd >= 0 && m_strOut.size() >= PWRITER_BUFFER_SIZE)
+    {
+        Flush();
+    }
+}
+
+void PWriter::PutIndent(size_t depth)
+{
+    m_strOut.append(depth, '\t');
 }
 
-void PWriter::FastWriteValue(const JValue &pval, string &strdoc, string &strindent)
+void PWriter::PutEscaped(const char *data, size_t size)
+{
+    const char *end = data + size;
+    while (data < end)
+    {
+        const char *special = FindSpecial(data, end);
+        m_strOut.append(data, special - data);
+        if (special < end)
+        {
+            m_strOut += ('&' == *special) ? "&amp;" : "&lt;";
+            special++;
+        }
+        data = special;
+    }
+}
+
+bool PWriter::Flush()
+{
+    if (m_fd >= 0 && !m_bFailed)
+    {
+        const char *data = m_strOut.data();
+        size_t towrite = m_strOut.size();
+        while (towrite > 0)
+        {
+            ssize_t nwrite = write(m_fd, data, towrite);
+            if (nwrite < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            if (nwrite <= 0)
+            {
+                m_bFailed = true;
+                break;
+            }
+            data += nwrite;
+            towrite -= (size_t)nwrite;
+        }
+        m_strOut.clear();
+    }
+    return !m_bFailed;
+}
+
+void PWriter::WriteDocument(const JValue &pval)
+{
+    Put(s_szPListHeader, sizeof(s_szPListHeader) - 1);
+    WriteValue(pval, 0);
+    Put(s_szPListFooter, sizeof(s_szPListFooter) - 1);
+}
+
+void PWriter::WriteValue(const JValue &pval, size_t depth)
 {
     if (pval.isObject())
     {
-        strdoc += strindent;
+        PutIndent(depth);
         if (pval.isEmpty())
         {
-            strdoc += "<dict/>\n";
+            Put("<dict/>\n");
             return;
         }
-        strdoc += "<dict>\n";
-        vector<string> arrKeys;
-        if (pval.keys(arrKeys))
+        Put("<dict>\n");
+        map<string, JValue, less<>>::const_iterator it = pval.m_Value.vObject->begin();
+        for (; it != pval.m_Value.vObject->end(); it++)
         {
-            strindent.push_back('\t');
-            for (size_t i = 0; i < arrKeys.size(); i++)
+            if (!it->second.isNull())
             {
-                if (!pval[arrKeys[i].c_str()].isNull())
-                {
-                    string strkey = arrKeys[i];
-                    XMLEscape(strkey);
-                    strdoc += strindent;
-                    strdoc += "<key>";
-                    strdoc += strkey;
-                    strdoc += "</key>\n";
-                    FastWriteValue(pval[arrKeys[i].c_str()], strdoc, strindent);
-                }
+                PutIndent(depth + 1);
+                Put("<key>");
+                PutEscaped(it->first.data(), it->first.size());
+                Put("</key>\n");
+                WriteValue(it->second, depth + 1);
             }
-            strindent.erase(strindent.end() - 1);
         }
-        strdoc += strindent;
-        strdoc += "</dict>\n";
+        PutIndent(depth);
+        Put("</dict>\n");
     }
     else if (pval.isArray())
     {
-        strdoc += strindent;
+        PutIndent(depth);
         if (pval.isEmpty())
         {
-            strdoc += "<array/>\n";
+            Put("<array/>\n");
             return;
         }
-        strdoc += "<array>\n";
-        strindent.push_back('\t');
+        Put("<array>\n");
         for (size_t i = 0; i < pval.size(); i++)
         {
-            FastWriteValue(pval[i], strdoc, strindent);
+            WriteValue(pval[i], depth + 1);
         }
-        strindent.erase(strindent.end() - 1);
-        strdoc += strindent;
-        strdoc += "</array>\n";
+        PutIndent(depth);
+        Put("</array>\n");
     }
     else if (pval.isDate())
     {
-        strdoc += strindent;
-        strdoc += "<date>";
-        strdoc += JWriter::d2s(pval.asDate());
-        strdoc += "</date>\n";
+        PutIndent(depth);
+        Put("<date>");
+        Put(JWriter::d2s(pval.asDate()).c_str());
+        Put("</date>\n");
     }
     else if (pval.isData())
     {
-        ZBase64 b64;
-        string strdata = pval.asData();
-        strdoc += strindent;
-        strdoc += "<data>\n";
-        strdoc += strindent;
-        strdoc += b64.Encode(strdata.data(), (int)strdata.size());
-        strdoc += "\n";
-        strdoc += strindent;
-        strdoc += "</data>\n";
+        PutIndent(depth);
+        Put("<data>\n");
+        PutIndent(depth);
+        const string *pdata = pval.m_Value.vData;
+        if (NULL != pdata && !pdata->empty())
+        {
+            ZBase64 b64;
+            const char *szb64 = b64.Encode(pdata->data(), (int)pdata->size());
+            Put(szb64, (pdata->size() + 2) / 3 * 4);
+        }
+        Put("\n");
+        PutIndent(depth);
+        Put("</data>\n");
     }
     else if (pval.isString())
     {
-        strdoc += strindent;
+        PutIndent(depth);
+        const char *szval = pval.asCString();
         if (pval.isDateString())
         {
-            strdoc += "<date>";
-            strdoc += pval.asString().c_str() + 5;
-            strdoc += "</date>\n";
+            Put("<date>");
+            Put(szval + 5);
+            Put("</date>\n");
         }
         else if (pval.isDataString())
         {
-            strdoc += "<data>\n";
-            strdoc += strindent;
-            strdoc += pval.asString().c_str() + 5;
-            strdoc += "\n";
-            strdoc += strindent;
-            strdoc += "</data>\n";
+            Put("<data>\n");
+            PutIndent(depth);
+            Put(szval + 5);
+            Put("\n");
+            PutIndent(depth);
+            Put("</data>\n");
         }
         else
         {
-            string strval = pval.asCString();
-            XMLEscape(strval);
-            strdoc += "<string>";
-            strdoc += strval;
-            strdoc += "</string>\n";
+            Put("<string>");
+            PutEscaped(szval, strlen(szval));
+            Put("</string>\n");
         }
     }
     else if (pval.isBool())
     {
-        strdoc += strindent;
-        strdoc += (pval.asBool() ? "<true/>\n" : "<false/>\n");
+        PutIndent(depth);
+        Put(pval.asBool() ? "<true/>\n" : "<false/>\n");
     }
-    else if (pval.isInt())
+    else if (pval.isInt() || pval.isFloat())
     {
-        strdoc += strindent;
-        strdoc += "<integer>";
-        char temp[32] = {0};
-        sprintf(temp, "%" PRId64, pval.asInt64());
-        strdoc += temp;
-        strdoc += "</integer>\n";
+        char temp[64] = {0};
+        size_t len = FormatNumber(pval, temp, sizeof(temp));
+        PutIndent(depth);
+        Put(pval.isInt() ? "<integer>" : "<real>");
+        Put(temp, len);
+        Put(pval.isInt() ? "</integer>\n" : "</real>\n");
+    }
+}
+
+size_t PWriter::MeasureDocument(const JValue &pval)
+{
+    return (sizeof(s_szPListHeader) - 1) + MeasureValue(pval, 0) + (sizeof(s_szPListFooter) - 1);
+}
+
+size_t PWriter::MeasureValue(const JValue &pval, size_t depth)
+{ // mirrors WriteValue byte for byte, so the document is reserved once
+    size_t size = 0;
+    if (pval.isObject())
+    {
+        if (pval.isEmpty())
+        {
+            return depth + 8;
+        }
+        size = depth + 7 + depth + 8;
+        map<string, JValue, less<>>::const_iterator it = pval.m_Value.vObject->begin();
+        for (; it != pval.m_Value.vObject->end(); it++)
+        {
+            if (!it->second.isNull())
+            {
+                size += depth + 1 + 5 + EscapedSize(it->first.data(), it->first.size()) + 7;
+                size += MeasureValue(it->second, depth + 1);
+            }
+        }
     }
-    else if (pval.isFloat())
+    else if (pval.isArray())
     {
-        strdoc += strindent;
-        strdoc += "<real>";
+        if (pval.isEmpty())
+        {
+            return depth + 9;
+        }
+        size = depth + 8 + depth + 9;
+        for (size_t i = 0; i < pval.size(); i++)
+        {
+            size += MeasureValue(pval[i], depth + 1);
+        }
+    }
+    else if (pval.isDate())
+    {
+        size = depth + 6 + JWriter::d2s(pval.asDate()).size() + 8;
+    }
+    else if (pval.isData())
+    {
+        const string *pdata = pval.m_Value.vData;
+        size = depth + 7 + depth + ((NULL == pdata) ? 0 : (pdata->size() + 2) / 3 * 4) + 1 + depth + 8;
+    }
+    else if (pval.isString())
+    {
+        const char *szval = pval.asCString();
+        size_t len = strlen(szval);
+        if (pval.isDateString())
+        {
+            size = depth + 6 + (len - 5) + 8;
+        }
+        else if (pval.isDataString())
+        {
+            size = depth + 7 + depth + (len - 5) + 1 + depth + 8;
+        }
+        else
+        {
+            size = depth + 8 + EscapedSize(szval, len) + 10;
+        }
+    }
+    else if (pval.isBool())
+    {
+        size = depth + (pval.asBool() ? 8 : 9);
+    }
+    else if (pval.isInt() || pval.isFloat())
+    {
+        char temp[64] = {0};
+        size = depth + FormatNumber(pval, temp, sizeof(temp)) + (pval.isInt() ? 9 + 11 : 6 + 8);
+    }
+    return size;
+}
 
+size_t PWriter::FormatNumber(const JValue &pval, char *buf, size_t size)
+{
+    int len = 0;
+    if (pval.isInt())
+    {
+        len = snprintf(buf, size, "%" PRId64, pval.asInt64());
+    }
+    else
+    {
         double v = pval.asFloat();
         if (numeric_limits<double>::infinity() == v)
         {
-            strdoc += "+infinity";
+            len = snprintf(buf, size, "+infinity");
+        }
+        else if (floor(v) == v)
+        {
+            len = snprintf(buf, size, "%" PRId64, (int64_t)v);
         }
         else
         {
-            char temp[32] = {0};
-            if (floor(v) == v)
-            {
-                sprintf(temp, "%" PRId64, (int64_t)v);
-            }
-            else
-            {
-                sprintf(temp, "%.15lf", v);
-            }
-            strdoc += temp;
+            len = snprintf(buf, size, "%.15lf", v);
         }
+    }
+    return (len > 0) ? min((size_t)len, size - 1) : 0;
+}
+
+size_t PWriter::EscapedSize(const char *data, size_t size)
+{
+    const char *end = data + size;
+    const char *special = FindSpecial(data, end);
+    while (special < end)
+    {
+        size += ('&' == *special) ? 4 : 3;
+        special = FindSpecial(special + 1, end);
+    }
+    return size;
+}
 
-        strdoc += "</real>\n";
+const char *PWriter::FindSpecial(const char *data, const char *end)
+{ // eight bytes per step, a zero byte in (word ^ pattern) marks an '&' or a '<'
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    while (end - data >= 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, data, 8);
+        uint64_t amp = word ^ (ones * '&');
+        uint64_t lt = word ^ (ones * '<');
+        if (((amp - ones) & ~amp & highs) || ((lt - ones) & ~lt & highs))
+        {
+            break;
+        }
+        data += 8;
+    }
+    while (data < end && '&' != *data && '<' != *data)
+    {
+        data++;
     }
+    return data;
 }
 
 void PWriter::XMLEscape(string &strval)
 {
-    StringReplace(strval, "&", "&amp;");
-    StringReplace(strval, "<", "&lt;");
-    // StringReplace(strval, ">", "&gt;");		//option
-    // StringReplace(strval, "'", "&apos;");		//option
-    // StringReplace(strval, "\"", "&quot;");	//option
+    size_t size = EscapedSize(strval.data(), strval.size());
+    if (size == strval.size())
+    {
+        return;
+    }
+
+    string strescaped;
+    strescaped.reserve(size);
+    PWriter writer(strescaped, -1);
+    writer.PutEscaped(strval.data(), strval.size());
+    strval.swap(strescaped);
 }
 
 string &PWriter::StringReplace(string &context, const string &from, const string &to)
@@ -53,6 +53,7 @@ typedef unsigned long long int uint64_t;
 #include <map>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <vector>
 using namespace std;
 
@@ -121,6 +122,12 @@ class JValue
      */
     JValue(const JValue &other);
 
+    /**
+     * Move constructor, takes over the other value's storage and leaves it null
+     * @param other The JValue to move from
+     */
+    JValue(JValue &&other) noexcept;
+
     /**
      * Constructor that creates a JValue from a C-string of specified length
      * @param val The C-string value
@@ -151,16 +158,21 @@ class JValue
     JValue &at(size_t index);
     JValue &at(const char *key);
 
-    bool has(const char *key) const;
+    bool has(string_view key) const;
     int index(const char *ele) const;
     bool keys(vector<string> &arrKeys) const;
 
     bool join(JValue &jv);
     bool append(JValue &jv);
 
+    // move counterparts of join() and remove(), jv is left null and the stolen value owns the subtree
+    bool splice(JValue &jv);
+    JValue steal(string_view key);
+    void swap(JValue &other) noexcept;
+
     bool remove(int index);
     bool remove(size_t index);
-    bool remove(const char *key);
+    bool remove(string_view key);
 
     JValue &back();
     JValue &front();
@@ -172,8 +184,13 @@ class JValue
     bool push_back(const char *val);
     bool push_back(const string &val);
     bool push_back(const JValue &jval);
+    bool push_back(JValue &&jval);
     bool push_back(const char *val, size_t len);
 
+    // build children in place instead of filling a local and copying it in
+    JValue &emplace_back(TYPE type = E_NULL);
+    JValue &emplace(string_view key, JValue &&jval);
+
     bool isInt() const;
     bool isNull() const;
     bool isBool() const;
@@ -195,6 +212,7 @@ class JValue
     operator const char *() const;
 
     JValue &operator=(const JValue &other);
+    JValue &operator=(JValue &&other) noexcept;
     JValue &operator=(int val);
     JValue &operator=(bool val);
     JValue &operator=(double val);
@@ -217,6 +235,10 @@ class JValue
     JValue &operator[](const string &key);
     const JValue &operator[](const string &key) const;
 
+    // objects compare keys transparently, so none of the key overloads builds a temporary string to look up
+    JValue &operator[](string_view key);
+    const JValue &operator[](string_view key) const;
+
     friend bool operator==(const JValue &jv, const char *psz) { return (0 == strcmp(jv.asCString(), psz)); }
 
     friend bool operator==(const char *psz, const JValue &jv) { return (0 == strcmp(jv.asCString(), psz)); }
@@ -236,6 +258,8 @@ class JValue
     static const string nullData;
 
   private:
+    friend class PWriter;
+
     union HOLD
     {
         bool vBool;
@@ -243,7 +267,7 @@ class JValue
         int64_t vInt64;
         char *vString;
         vector<JValue> *vArray;
-        map<string, JValue> *vObject;
+        map<string, JValue, less<>> *vObject;
         time_t vDate;
         string *vData;
         wchar_t *vUnicode;
@@ -500,15 +524,42 @@ class PReader
     uint8_t m_uDictParamSize;
 };
 
+/**
+ * XML plist serializer. A sizing pass reserves the whole document up front, and text is escaped
+ * by a word-at-a-time scan that copies runs straight through when no '&' or '<' shows up.
+ * The descriptor variant streams through a fixed buffer instead of building the document in memory.
+ */
 class PWriter
 {
   public:
     static void FastWrite(const JValue &pval, string &strdoc);
-    static void FastWriteValue(const JValue &pval, string &strdoc, string &strindent);
+    static bool FastWrite(const JValue &pval, int fd);
 
   public:
     static void XMLEscape(string &strval);
     static string &StringReplace(string &context, const string &from, const string &to);
+
+  private:
+    PWriter(string &strout, int fd);
+
+    void Put(const char *data, size_t size);
+    void Put(const char *str) { Put(str, strlen(str)); }
+    void PutIndent(size_t depth);
+    void PutEscaped(const char *data, size_t size);
+    bool Flush();
+    void WriteDocument(const JValue &pval);
+    void WriteValue(const JValue &pval, size_t depth);
+
+    static size_t MeasureDocument(const JValue &pval);
+    static size_t MeasureValue(const JValue &pval, size_t depth);
+    static size_t FormatNumber(const JValue &pval, char *buf, size_t size);
+    static size_t EscapedSize(const char *data, size_t size);
+    static const char *FindSpecial(const char *data, const char *end);
+
+  private:
+    string &m_strOut;
+    int m_fd;
+    bool m_bFailed;
 };
 
 #endif // JSON_INCLUDED
@@ -148,6 +148,8 @@ typedef int vm_prot_t;
 
 #define FAT_MAGIC 0xcafebabe
 #define FAT_CIGAM 0xbebafeca
+#define FAT_MAGIC_64 0xcafebabf
+#define FAT_CIGAM_64 0xbfbafeca
 
 #define MH_MAGIC 0xfeedface
 #define MH_CIGAM 0xcefaedfe
@@ -327,6 +329,16 @@ struct fat_arch
     uint32_t align;           /* alignment as a power of 2 */
 };
 
+struct fat_arch_64
+{
+    cpu_type_t cputype;       /* cpu specifier (int) */
+    cpu_subtype_t cpusubtype; /* machine specifier (int) */
+    uint64_t offset;          /* file offset to this object file */
+    uint64_t size;            /* size of this object file */
+    uint32_t align;           /* alignment as a power of 2 */
+    uint32_t reserved;        /* reserved */
+};
+
 struct mach_header
 {
     uint32_t magic;           /* mach magic number identifier */
@@ -479,6 +491,13 @@ struct dylib_command
     struct dylib dylib; /* the library identification */
 };
 
+struct rpath_command
+{
+    uint32_t cmd;       /* LC_RPATH */
+    uint32_t cmdsize;   /* includes string */
+    union lc_str path;  /* path to add to run path */
+};
+
 #pragma pack(pop)
 
 //////CodeSignature
@@ -525,6 +544,7 @@ enum
     CS_HASH_MAX_SIZE = 48, /* max size of the hash we'll support */
     CS_EXECSEG_MAIN_BINARY = 0x1,
     CS_EXECSEG_ALLOW_UNSIGNED = 0x10,
+    CS_ADHOC = 0x2, /* ad hoc signed, no CMS */
 
     /*
      * Currently only to support Legacy VPN plugins,
@@ -0,0 +1,771 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#include "deb.h"
+#include "common/json.h"
+
+#if defined(__APPLE__)
+#include <compression.h>
+#else
+#include <zlib.h>
+#endif
+
+#define DEB_CHUNK_SIZE (64 * 1024)
+#define DEB_META_LIMIT (64 * 1024)
+#define DEB_SUBSTRATE_PATH "/Library/Frameworks/CydiaSubstrate.framework/CydiaSubstrate"
+#define DEB_SUBSTRATE_RPATH "@rpath/CydiaSubstrate.framework/CydiaSubstrate"
+
+enum
+{
+    E_DEB_CODEC_NONE = 0,
+    E_DEB_CODEC_GZIP = 1,
+    E_DEB_CODEC_XZ = 2,
+};
+
+enum
+{
+    E_DEB_ENTRY_SKIP = 0,
+    E_DEB_ENTRY_DYLIB = 1,
+    E_DEB_ENTRY_FRAMEWORK = 2,
+    E_DEB_ENTRY_BUNDLE = 3,
+};
+
+static bool _ReadAll(int nFD, void *pData, size_t uSize)
+{
+    uint8_t *p = (uint8_t *)pData;
+    while (uSize > 0)
+    {
+        ssize_t nRead = read(nFD, p, uSize);
+        if (nRead < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (nRead <= 0)
+        {
+            return false;
+        }
+        p += nRead;
+        uSize -= nRead;
+    }
+    return true;
+}
+
+static bool _WriteAll(int nFD, const void *pData, size_t uSize)
+{
+    const uint8_t *p = (const uint8_t *)pData;
+    while (uSize > 0)
+    {
+        ssize_t nWrite = write(nFD, p, uSize);
+        if (nWrite < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (nWrite <= 0)
+        {
+            return false;
+        }
+        p += nWrite;
+        uSize -= nWrite;
+    }
+    return true;
+}
+
+static uint64_t _ParseTarNumber(const char *szField, size_t uSize)
+{
+    uint64_t uValue = 0;
+    if (0x80 & (uint8_t)szField[0])
+    { // gnu base-256
+        for (size_t i = 1; i < uSize; i++)
+        {
+            uValue = (uValue << 8) | (uint8_t)szField[i];
+        }
+        return uValue;
+    }
+
+    for (size_t i = 0; i < uSize && 0 != szField[i]; i++)
+    {
+        if (szField[i] >= '0' && szField[i] <= '7')
+        {
+            uValue = (uValue << 3) | (uint64_t)(szField[i] - '0');
+        }
+    }
+    return uValue;
+}
+
+static bool _CreateParentFolders(const string &strPath, size_t uFrom)
+{
+    for (size_t uPos = strPath.find('/', uFrom); string::npos != uPos; uPos = strPath.find('/', uPos + 1))
+    {
+        string strFolder = strPath.substr(0, uPos);
+        if (0 != mkdir(strFolder.c_str(), 0755) && EEXIST != errno)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(__APPLE__)
+// returns the header length, 0 if more data is needed or -1 if it is not a gzip stream
+static int _ParseGzipHeader(const string &strHeader)
+{
+    const uint8_t *p = (const uint8_t *)strHeader.data();
+    size_t uSize = strHeader.size();
+    if (uSize < 10)
+    {
+        return 0;
+    }
+    if (0x1f != p[0] || 0x8b != p[1] || 8 != p[2])
+    {
+        return -1;
+    }
+
+    uint8_t uFlags = p[3];
+    size_t uOffset = 10;
+    if (uFlags & 0x04)
+    { // FEXTRA
+        if (uOffset + 2 > uSize)
+        {
+            return 0;
+        }
+        uOffset += 2 + (p[uOffset] | (p[uOffset + 1] << 8));
+    }
+    for (int nField = 0x08; nField <= 0x10; nField <<= 1)
+    { // FNAME, FCOMMENT
+        if (uFlags & nField)
+        {
+            while (uOffset < uSize && 0 != p[uOffset])
+            {
+                uOffset++;
+            }
+            if (uOffset++ >= uSize)
+            {
+                return 0;
+            }
+        }
+    }
+    if (uFlags & 0x02)
+    { // FHCRC
+        uOffset += 2;
+    }
+    return (uOffset <= uSize) ? (int)uOffset : 0;
+}
+#endif
+
+ZDebPackage::ZDebPackage()
+{
+    m_nCodec = E_DEB_CODEC_NONE;
+    m_pStream = NULL;
+    m_bStreamEnd = false;
+    m_uHeaderFill = 0;
+    m_uEntryRemaining = 0;
+    m_uPadRemaining = 0;
+    m_nZeroBlocks = 0;
+    m_nEntryFD = -1;
+    m_cMetaType = 0;
+    m_nPaxSize = -1;
+}
+
+ZDebPackage::~ZDebPackage()
+{
+    FreeCodec();
+    if (m_nEntryFD >= 0)
+    {
+        close(m_nEntryFD);
+    }
+}
+
+const vector<string> &ZDebPackage::GetInjectPaths() const { return m_arrInjectPaths; }
+
+const vector<pair<string, string>> &ZDebPackage::GetChangePaths() const { return m_arrChangePaths; }
+
+int ZDebPackage::Extract(const char *szDebFile, const string &strAppFolder)
+{
+    m_strAppFolder = strAppFolder;
+    m_arrInjectPaths.clear();
+    m_arrChangePaths.clear();
+    m_arrDyLibs.clear();
+    m_setFrameworks.clear();
+
+    int nFD = open(szDebFile, O_RDONLY | O_CLOEXEC);
+    if (nFD < 0)
+    {
+        ZLog::ErrorV(">>> Can't Open Deb File! %s, %s\n", szDebFile, strerror(errno));
+        return E_DEB_EXTRACT_FAILED;
+    }
+
+    char szMagic[8] = {0};
+    if (!_ReadAll(nFD, szMagic, sizeof(szMagic)) || 0 != memcmp(szMagic, "!<arch>\n", sizeof(szMagic)))
+    {
+        ZLog::ErrorV(">>> Invalid Deb File! %s\n", szDebFile);
+        close(nFD);
+        return E_DEB_EXTRACT_FAILED;
+    }
+
+    string strDebName = szDebFile;
+    strDebName = strDebName.substr(strDebName.rfind('/') + 1);
+
+    bool bUnsupported = false;
+    bool bFound = false;
+    bool bRet = true;
+    char szHeader[60] = {0};
+    while (bRet && !bFound && _ReadAll(nFD, szHeader, sizeof(szHeader)))
+    {
+        string strName(szHeader, 16);
+        strName.erase(strName.find_last_not_of(" /") + 1);
+        uint64_t uSize = strtoull(string(szHeader + 48, 10).c_str(), NULL, 10);
+
+        if (0 == strName.compare(0, 8, "data.tar"))
+        {
+            int nCodec = -1;
+            if ("data.tar" == strName)
+            {
+                nCodec = E_DEB_CODEC_NONE;
+            }
+            else if ("data.tar.gz" == strName)
+            {
+                nCodec = E_DEB_CODEC_GZIP;
+            }
+#if defined(__APPLE__)
+            else if ("data.tar.xz" == strName)
+            {
+                nCodec = E_DEB_CODEC_XZ;
+            }
+#endif
+
+            if (nCodec < 0)
+            {
+                ZLog::WarnV(">>> Unsupported Deb Compression! %s\n", strName.c_str());
+                bUnsupported = true;
+                bRet = false;
+                break;
+            }
+
+            ZLog::PrintV(">>> Extract Deb: %s (%s)\n", strDebName.c_str(), strName.c_str());
+            bRet = ExtractData(nFD, uSize, nCodec);
+            bFound = true;
+        }
+        else if (lseek(nFD, (off_t)(uSize + (uSize & 1)), SEEK_CUR) < 0)
+        {
+            bRet = false;
+        }
+    }
+    close(nFD);
+
+    if (bUnsupported)
+    {
+        return E_DEB_EXTRACT_UNSUPPORTED;
+    }
+
+    if (!bFound && bRet)
+    {
+        ZLog::ErrorV(">>> Can't Find data.tar In Deb File! %s\n", szDebFile);
+        return E_DEB_EXTRACT_FAILED;
+    }
+
+    if (bRet)
+    {
+        CollectExtractedBinaries();
+    }
+    return bRet ? E_DEB_EXTRACT_DONE : E_DEB_EXTRACT_FAILED;
+}
+
+bool ZDebPackage::ExtractData(int nFD, uint64_t uSize, int nCodec)
+{
+    if (!InitCodec(nCodec))
+    {
+        return false;
+    }
+
+    m_uHeaderFill = 0;
+    m_uEntryRemaining = 0;
+    m_uPadRemaining = 0;
+    m_nZeroBlocks = 0;
+    m_cMetaType = 0;
+    m_strLongName.clear();
+    m_strPaxPath.clear();
+    m_nPaxSize = -1;
+
+    uint8_t *pBuffer = (uint8_t *)m_bufRead.GetBuffer(DEB_CHUNK_SIZE);
+    if (NULL == pBuffer)
+    {
+        return false;
+    }
+
+    bool bRet = true;
+    while (bRet && uSize > 0)
+    {
+        size_t uRead = (size_t)min((uint64_t)DEB_CHUNK_SIZE, uSize);
+        if (!_ReadAll(nFD, pBuffer, uRead))
+        {
+            ZLog::Error(">>> Read Deb File Failed!\n");
+            bRet = false;
+            break;
+        }
+        uSize -= uRead;
+        bRet = Decompress(pBuffer, uRead, (0 == uSize));
+    }
+
+    if (m_nEntryFD >= 0)
+    { // truncated archive
+        close(m_nEntryFD);
+        m_nEntryFD = -1;
+        bRet = false;
+    }
+
+    FreeCodec();
+    return bRet;
+}
+
+bool ZDebPackage::InitCodec(int nCodec)
+{
+    FreeCodec();
+    m_nCodec = nCodec;
+    m_bStreamEnd = false;
+    m_strGzipHeader.clear();
+    if (E_DEB_CODEC_NONE == nCodec)
+    {
+        return true;
+    }
+
+#if defined(__APPLE__)
+    compression_stream *pStream = new compression_stream;
+    compression_algorithm algorithm = (E_DEB_CODEC_XZ == nCodec) ? COMPRESSION_LZMA : COMPRESSION_ZLIB;
+    if (COMPRESSION_STATUS_OK != compression_stream_init(pStream, COMPRESSION_STREAM_DECODE, algorithm))
+    {
+        delete pStream;
+        return false;
+    }
+#else
+    z_stream *pStream = new z_stream;
+    memset(pStream, 0, sizeof(z_stream));
+    if (Z_OK != inflateInit2(pStream, 16 + MAX_WBITS))
+    {
+        delete pStream;
+        return false;
+    }
+#endif
+
+    m_pStream = pStream;
+    return true;
+}
+
+void ZDebPackage::FreeCodec()
+{
+    if (NULL == m_pStream)
+    {
+        return;
+    }
+
+#if defined(__APPLE__)
+    compression_stream *pStream = (compression_stream *)m_pStream;
+    compression_stream_destroy(pStream);
+#else
+    z_stream *pStream = (z_stream *)m_pStream;
+    inflateEnd(pStream);
+#endif
+    delete pStream;
+    m_pStream = NULL;
+}
+
+bool ZDebPackage::Decompress(const uint8_t *pData, size_t uSize, bool bFinal)
+{
+    if (E_DEB_CODEC_NONE == m_nCodec)
+    {
+        return WriteTar(pData, uSize);
+    }
+
+    if (m_bStreamEnd)
+    { // trailer
+        return true;
+    }
+
+#if defined(__APPLE__)
+    string strInput;
+    if (E_DEB_CODEC_GZIP == m_nCodec && "-" != m_strGzipHeader)
+    { // libcompression only decodes the raw deflate stream, "-" marks the header as consumed
+        m_strGzipHeader.append((const char *)pData, uSize);
+        int nHeader = _ParseGzipHeader(m_strGzipHeader);
+        if (nHeader < 0 || (0 == nHeader && (bFinal || m_strGzipHeader.size() > DEB_META_LIMIT)))
+        {
+            ZLog::Error(">>> Invalid Gzip Header In Deb File!\n");
+            return false;
+        }
+        if (0 == nHeader)
+        {
+            return true;
+        }
+        strInput = m_strGzipHeader.substr(nHeader);
+        m_strGzipHeader = "-";
+        pData = (const uint8_t *)strInput.data();
+        uSize = strInput.size();
+    }
+#endif
+
+    uint8_t *pOutput = (uint8_t *)m_bufOutput.GetBuffer(DEB_CHUNK_SIZE);
+    if (NULL == pOutput)
+    {
+        return false;
+    }
+
+#if defined(__APPLE__)
+    compression_stream *pStream = (compression_stream *)m_pStream;
+    pStream->src_ptr = pData;
+    pStream->src_size = uSize;
+    do
+    {
+        pStream->dst_ptr = pOutput;
+        pStream->dst_size = DEB_CHUNK_SIZE;
+        compression_status status = compression_stream_process(pStream, bFinal ? COMPRESSION_STREAM_FINALIZE : 0);
+        if (COMPRESSION_STATUS_ERROR == status)
+        {
+            ZLog::Error(">>> Decompress Deb Data Failed!\n");
+            return false;
+        }
+
+        size_t uOutput = DEB_CHUNK_SIZE - pStream->dst_size;
+        if (uOutput > 0 && !WriteTar(pOutput, uOutput))
+        {
+            return false;
+        }
+
+        if (COMPRESSION_STATUS_END == status)
+        {
+            m_bStreamEnd = true;
+            break;
+        }
+    } while (pStream->src_size > 0 || 0 == pStream->dst_size);
+#else
+    z_stream *pStream = (z_stream *)m_pStream;
+    pStream->next_in = (Bytef *)pData;
+    pStream->avail_in = (uInt)uSize;
+    do
+    {
+        pStream->next_out = pOutput;
+        pStream->avail_out = DEB_CHUNK_SIZE;
+        int nStatus = inflate(pStream, Z_NO_FLUSH);
+        if (Z_OK != nStatus && Z_STREAM_END != nStatus && Z_BUF_ERROR != nStatus)
+        {
+            ZLog::Error(">>> Decompress Deb Data Failed!\n");
+            return false;
+        }
+
+        size_t uOutput = DEB_CHUNK_SIZE - pStream->avail_out;
+        if (uOutput > 0 && !WriteTar(pOutput, uOutput))
+        {
+            return false;
+        }
+
+        if (Z_STREAM_END == nStatus)
+        {
+            m_bStreamEnd = true;
+            break;
+        }
+    } while (pStream->avail_in > 0 || 0 == pStream->avail_out);
+#endif
+
+    if (bFinal && !m_bStreamEnd)
+    {
+        ZLog::Error(">>> Truncated Deb Data!\n");
+        return false;
+    }
+    return true;
+}
+
+bool ZDebPackage::WriteTar(const uint8_t *pData, size_t uSize)
+{
+    while (uSize > 0 && m_nZeroBlocks < 2)
+    {
+        if (m_uEntryRemaining > 0)
+        {
+            size_t uChunk = (size_t)min((uint64_t)uSize, m_uEntryRemaining);
+            if (m_nEntryFD >= 0 && !_WriteAll(m_nEntryFD, pData, uChunk))
+            {
+                ZLog::ErrorV(">>> Write Deb Entry Failed! %s\n", strerror(errno));
+                return false;
+            }
+            if (0 != m_cMetaType && m_strMeta.size() + uChunk <= DEB_META_LIMIT)
+            {
+                m_strMeta.append((const char *)pData, uChunk);
+            }
+
+            pData += uChunk;
+            uSize -= uChunk;
+            m_uEntryRemaining -= uChunk;
+            if (0 == m_uEntryRemaining)
+            {
+                EndEntry();
+            }
+            continue;
+        }
+
+        if (m_uPadRemaining > 0)
+        {
+            size_t uChunk = (size_t)min((uint64_t)uSize, m_uPadRemaining);
+            pData += uChunk;
+            uSize -= uChunk;
+            m_uPadRemaining -= uChunk;
+            continue;
+        }
+
+        size_t uChunk = min(uSize, sizeof(m_szHeader) - m_uHeaderFill);
+        memcpy(m_szHeader + m_uHeaderFill, pData, uChunk);
+        pData += uChunk;
+        uSize -= uChunk;
+        m_uHeaderFill += uChunk;
+        if (m_uHeaderFill == sizeof(m_szHeader))
+        {
+            m_uHeaderFill = 0;
+            if (!BeginEntry())
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ZDebPackage::BeginEntry()
+{
+    uint32_t uSum = 0;
+    bool bZero = true;
+    for (size_t i = 0; i < sizeof(m_szHeader); i++)
+    {
+        uSum += (i >= 148 && i < 156) ? ' ' : (uint8_t)m_szHeader[i];
+        bZero = bZero && (0 == m_szHeader[i]);
+    }
+    if (bZero)
+    {
+        m_nZeroBlocks++;
+        return true;
+    }
+    m_nZeroBlocks = 0;
+
+    if (uSum != _ParseTarNumber(m_szHeader + 148, 8))
+    {
+        ZLog::Error(">>> Invalid Tar Header In Deb File!\n");
+        return false;
+    }
+
+    char cType = m_szHeader[156];
+    uint64_t uSize = _ParseTarNumber(m_szHeader + 124, 12);
+    string strName(m_szHeader, strnlen(m_szHeader, 100));
+    if (0 == memcmp(m_szHeader + 257, "ustar", 5) && 0 != m_szHeader[345])
+    {
+        strName = string(m_szHeader + 345, strnlen(m_szHeader + 345, 155)) + "/" + strName;
+    }
+
+    m_cMetaType = 0;
+    m_strMeta.clear();
+    if ('L' == cType || 'x' == cType || 'g' == cType)
+    { // gnu long name, pax headers
+        m_cMetaType = cType;
+    }
+    else
+    {
+        if (!m_strPaxPath.empty())
+        {
+            strName = m_strPaxPath;
+        }
+        else if (!m_strLongName.empty())
+        {
+            strName = m_strLongName;
+        }
+        if (m_nPaxSize >= 0)
+        {
+            uSize = (uint64_t)m_nPaxSize;
+        }
+        m_strLongName.clear();
+        m_strPaxPath.clear();
+        m_nPaxSize = -1;
+
+        string strDest;
+        string strFramework;
+        int nKind = ('0' == cType || 0 == cType || '7' == cType || '5' == cType)
+                        ? MapEntryPath(strName, strDest, strFramework)
+                        : E_DEB_ENTRY_SKIP;
+        if (E_DEB_ENTRY_SKIP != nKind)
+        {
+            if (!_CreateParentFolders(strDest, m_strAppFolder.size() + 1))
+            {
+                ZLog::ErrorV(">>> Can't Create Folder For %s! %s\n", strDest.c_str(), strerror(errno));
+                return false;
+            }
+
+            if ('5' == cType)
+            {
+                CreateFolder(strDest.c_str());
+            }
+            else
+            {
+                mode_t uMode = (_ParseTarNumber(m_szHeader + 100, 8) & 0111) ? 0755 : 0644;
+                m_nEntryFD = open(strDest.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, uMode);
+                if (m_nEntryFD < 0 && EEXIST != errno)
+                {
+                    ZLog::ErrorV(">>> Can't Create Deb Entry! %s, %s\n", strDest.c_str(), strerror(errno));
+                    return false;
+                }
+
+                if (m_nEntryFD < 0)
+                { // same behaviour as moving the file in: keep what the app already ships, still load it
+                    ZLog::WarnV(">>> Deb Entry Already Exists, Skip! %s\n", strDest.c_str());
+                }
+                if (E_DEB_ENTRY_DYLIB == nKind)
+                {
+                    m_arrDyLibs.push_back(strDest.substr(strDest.rfind('/') + 1));
+                }
+            }
+
+            if (E_DEB_ENTRY_FRAMEWORK == nKind)
+            {
+                m_setFrameworks.insert(strFramework);
+            }
+        }
+    }
+
+    m_uEntryRemaining = ('5' == cType || '1' == cType || '2' == cType) ? 0 : uSize;
+    m_uPadRemaining = (m_uEntryRemaining % 512) ? (512 - m_uEntryRemaining % 512) : 0;
+    if (0 == m_uEntryRemaining)
+    {
+        EndEntry();
+    }
+    return true;
+}
+
+void ZDebPackage::EndEntry()
+{
+    if (m_nEntryFD >= 0)
+    {
+        close(m_nEntryFD);
+        m_nEntryFD = -1;
+    }
+
+    if ('L' == m_cMetaType)
+    {
+        m_strLongName = m_strMeta.c_str();
+    }
+    else if ('x' == m_cMetaType)
+    { // "<length> <key>=<value>\n" records
+        size_t uPos = 0;
+        while (uPos < m_strMeta.size())
+        {
+            size_t uLength = strtoul(m_strMeta.c_str() + uPos, NULL, 10);
+            size_t uSpace = m_strMeta.find(' ', uPos);
+            if (0 == uLength || string::npos == uSpace || uPos + uLength > m_strMeta.size())
+            {
+                break;
+            }
+
+            string strRecord = m_strMeta.substr(uSpace + 1, uPos + uLength - uSpace - 2);
+            if (0 == strRecord.compare(0, 5, "path="))
+            {
+                m_strPaxPath = strRecord.substr(5);
+            }
+            else if (0 == strRecord.compare(0, 5, "size="))
+            {
+                m_nPaxSize = strtoll(strRecord.c_str() + 5, NULL, 10);
+            }
+            uPos += uLength;
+        }
+    }
+    m_cMetaType = 0;
+    m_strMeta.clear();
+}
+
+int ZDebPackage::MapEntryPath(const string &strName, string &strDest, string &strFramework)
+{
+    string strPath = strName;
+    while (0 == strPath.compare(0, 2, "./"))
+    {
+        strPath.erase(0, 2);
+    }
+    strPath.erase(0, strPath.find_first_not_of('/'));
+    strPath.erase(strPath.find_last_not_of('/') + 1);
+    if (0 == strPath.compare(0, 7, "var/jb/"))
+    { // rootless
+        strPath.erase(0, 7);
+    }
+
+    vector<string> arrParts;
+    StringSplit(strPath, "/", arrParts);
+    for (size_t i = 0; i < arrParts.size(); i++)
+    {
+        if (arrParts[i].empty() || "." == arrParts[i] || ".." == arrParts[i])
+        {
+            return E_DEB_ENTRY_SKIP;
+        }
+    }
+
+    if (4 == arrParts.size() && "Library" == arrParts[0] && "MobileSubstrate" == arrParts[1] &&
+        "DynamicLibraries" == arrParts[2] && IsPathSuffix(arrParts[3], ".dylib"))
+    {
+        strDest = m_strAppFolder + "/Frameworks/" + arrParts[3];
+        return E_DEB_ENTRY_DYLIB;
+    }
+
+    if (arrParts.size() >= 3 && "Library" == arrParts[0] && "Frameworks" == arrParts[1] &&
+        IsPathSuffix(arrParts[2], ".framework"))
+    {
+        strFramework = arrParts[2];
+        strDest = m_strAppFolder + "/Frameworks/" + strPath.substr(strlen("Library/Frameworks/"));
+        return E_DEB_ENTRY_FRAMEWORK;
+    }
+
+    if (arrParts.size() >= 3 && "Library" == arrParts[0] && "Application Support" == arrParts[1])
+    {
+        for (size_t i = 2; i < arrParts.size(); i++)
+        {
+            if (IsPathSuffix(arrParts[i], ".bundle"))
+            { // bundles go to the app root
+                strDest = m_strAppFolder;
+                for (size_t j = i; j < arrParts.size(); j++)
+                {
+                    strDest += "/" + arrParts[j];
+                }
+                return E_DEB_ENTRY_BUNDLE;
+            }
+        }
+    }
+
+    return E_DEB_ENTRY_SKIP;
+}
+
+void ZDebPackage::CollectExtractedBinaries()
+{
+    vector<string> arrBinaries;
+    for (size_t i = 0; i < m_arrDyLibs.size(); i++)
+    {
+        arrBinaries.push_back(m_arrDyLibs[i]);
+    }
+    for (set<string>::iterator it = m_setFrameworks.begin(); it != m_setFrameworks.end(); ++it)
+    {
+        JValue jvInfo;
+        jvInfo.readPListPath("%s/Frameworks/%s/Info.plist", m_strAppFolder.c_str(), it->c_str());
+        string strExecutable = jvInfo["CFBundleExecutable"];
+        if (strExecutable.empty())
+        {
+            ZLog::WarnV(">>> Can't Find CFBundleExecutable Of %s!\n", it->c_str());
+            continue;
+        }
+        arrBinaries.push_back(*it + "/" + strExecutable);
+    }
+
+    for (size_t i = 0; i < arrBinaries.size(); i++)
+    {
+        m_arrInjectPaths.push_back("@executable_path/Frameworks/" + arrBinaries[i]);
+    }
+
+    if (!arrBinaries.empty())
+    { // tweaks linked against the rootful substrate path load ellekit through @rpath, changed while signing
+        m_arrChangePaths.push_back(make_pair(string(DEB_SUBSTRATE_PATH), string(DEB_SUBSTRATE_RPATH)));
+    }
+}
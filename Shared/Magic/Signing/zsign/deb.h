@@ -0,0 +1,77 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#pragma once
+#include "common/common.h"
+
+/**
+ * Streams a tweak .deb into an app bundle. The ar container and its data.tar member are read in
+ * fixed-size chunks, decompressed on the fly and only the dylibs, frameworks and resource bundles
+ * an app can load are written out; nothing is staged in memory or in a temporary folder.
+ */
+class ZDebPackage
+{
+  public:
+    ZDebPackage();
+    ~ZDebPackage();
+
+  public:
+    enum
+    {
+        E_DEB_EXTRACT_DONE = 0,
+        E_DEB_EXTRACT_UNSUPPORTED = 1, // data.tar codec this reader lacks, nothing was written
+        E_DEB_EXTRACT_FAILED = 2,
+    };
+
+  public:
+    int Extract(const char *szDebFile, const string &strAppFolder);
+    const vector<string> &GetInjectPaths() const;
+    const vector<pair<string, string>> &GetChangePaths() const;
+
+  private:
+    bool ExtractData(int nFD, uint64_t uSize, int nCodec);
+    bool InitCodec(int nCodec);
+    bool Decompress(const uint8_t *pData, size_t uSize, bool bFinal);
+    void FreeCodec();
+
+    bool WriteTar(const uint8_t *pData, size_t uSize);
+    bool BeginEntry();
+    void EndEntry();
+    int MapEntryPath(const string &strName, string &strDest, string &strFramework);
+    void CollectExtractedBinaries();
+
+  private:
+    string m_strAppFolder;
+    vector<string> m_arrInjectPaths;
+    vector<pair<string, string>> m_arrChangePaths;
+    vector<string> m_arrDyLibs;
+    set<string> m_setFrameworks;
+
+    int m_nCodec;
+    void *m_pStream;
+    bool m_bStreamEnd;
+    string m_strGzipHeader;
+    ZBuffer m_bufRead;
+    ZBuffer m_bufOutput;
+
+    char m_szHeader[512];
+    size_t m_uHeaderFill;
+    uint64_t m_uEntryRemaining;
+    uint64_t m_uPadRemaining;
+    int m_nZeroBlocks;
+    int m_nEntryFD;
+    char m_cMetaType;
+    string m_strMeta;
+    string m_strLongName;
+    string m_strPaxPath;
+    int64_t m_nPaxSize;
+};
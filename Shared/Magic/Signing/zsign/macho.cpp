@@ -19,13 +19,17 @@ ZMachO::ZMachO()
     m_pBase = NULL;
     m_sSize = 0;
     m_bCSRealloced = false;
+    m_bReadOnly = false;
+    m_uPageSize = 0;
+    m_uSignSlack = CODESIGN_SLACK_DEFAULT;
 }
 
 ZMachO::~ZMachO() { FreeArchOes(); }
 
-bool ZMachO::Init(const char *szFile)
+bool ZMachO::Init(const char *szFile, bool bReadOnly)
 {
     m_strFile = szFile;
+    m_bReadOnly = bReadOnly;
     return OpenFile(szFile);
 }
 
@@ -46,7 +50,7 @@ bool ZMachO::Free()
     return CloseFile();
 }
 
-bool ZMachO::NewArchO(uint8_t *pBase, uint32_t uLength)
+bool ZMachO::NewArchO(uint8_t *pBase, uint64_t uLength)
 {
     ZArchO *archo = new ZArchO();
     if (archo->Init(pBase, uLength))
@@ -58,6 +62,325 @@ bool ZMachO::NewArchO(uint8_t *pBase, uint32_t uLength)
     return false;
 }
 
+bool ZMachO::GetFatArches(vector<fat_arch_64> &arrArches, bool &bFat64, bool &bSwap) const
+{
+    return ParseFatArches(m_pBase, m_sSize, m_sSize, arrArches, bFat64, bSwap);
+}
+
+bool ZMachO::ParseFatArches(const uint8_t *pData, uint64_t uDataSize, uint64_t uFileSize,
+                            vector<fat_arch_64> &arrArches, bool &bFat64, bool &bSwap)
+{ // fat_arch and fat_arch_64 entries are both returned widened and in host order
+    arrArches.clear();
+    if (uDataSize < sizeof(fat_header))
+    {
+        return false;
+    }
+
+    uint32_t magic = *((const uint32_t *)pData);
+    bFat64 = (FAT_MAGIC_64 == magic || FAT_CIGAM_64 == magic);
+    bSwap = (FAT_CIGAM == magic || FAT_CIGAM_64 == magic);
+
+    const fat_header *pFatHeader = reinterpret_cast<const fat_header *>(pData);
+    uint32_t uFatArch = bSwap ? LE(pFatHeader->nfat_arch) : pFatHeader->nfat_arch;
+    size_t sArchSize = bFat64 ? sizeof(fat_arch_64) : sizeof(fat_arch);
+    if (sizeof(fat_header) + (uint64_t)uFatArch * sArchSize > uDataSize)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < uFatArch; i++)
+    {
+        fat_arch_64 arch;
+        const uint8_t *pArch = pData + sizeof(fat_header) + sArchSize * i;
+        if (bFat64)
+        {
+            arch = *(reinterpret_cast<const fat_arch_64 *>(pArch));
+            arch.offset = bSwap ? LE(arch.offset) : arch.offset;
+            arch.size = bSwap ? LE(arch.size) : arch.size;
+        }
+        else
+        {
+            const fat_arch *pFatArch = reinterpret_cast<const fat_arch *>(pArch);
+            arch.offset = bSwap ? LE(pFatArch->offset) : pFatArch->offset;
+            arch.size = bSwap ? LE(pFatArch->size) : pFatArch->size;
+            arch.align = pFatArch->align;
+            arch.cputype = pFatArch->cputype;
+            arch.cpusubtype = pFatArch->cpusubtype;
+            arch.reserved = 0;
+        }
+        arch.cputype = bSwap ? (cpu_type_t)LE((uint32_t)arch.cputype) : arch.cputype;
+        arch.cpusubtype = bSwap ? (cpu_subtype_t)LE((uint32_t)arch.cpusubtype) : arch.cpusubtype;
+        arch.align = bSwap ? LE(arch.align) : arch.align;
+
+        if (arch.offset > uFileSize || arch.size > uFileSize - arch.offset)
+        {
+            return false;
+        }
+        arrArches.push_back(arch);
+    }
+    return true;
+}
+
+static bool _PReadFull(int fd, uint64_t uOffset, size_t sSize, string &strData)
+{
+    strData.resize(sSize);
+    size_t sRead = 0;
+    while (sRead < sSize)
+    {
+        ssize_t nRead = pread(fd, &strData[sRead], sSize - sRead, (off_t)(uOffset + sRead));
+        if (nRead < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (nRead <= 0)
+        {
+            return false;
+        }
+        sRead += (size_t)nRead;
+    }
+    return true;
+}
+
+bool ZMachO::Probe(const char *szFile, vector<ZMachOProbe> &arrProbes, bool bSignature)
+{ // preads the fat header, each slice's load commands and, if asked, its signature blob, nothing else
+    arrProbes.clear();
+    int fd = open(szFile, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    uint64_t uFileSize = (uint64_t)GetFileSize(fd);
+    string strHeader;
+    bool bRet = (uFileSize >= sizeof(fat_header)) && _PReadFull(fd, 0, sizeof(fat_header), strHeader);
+    uint32_t magic = bRet ? *((const uint32_t *)strHeader.data()) : 0;
+    if (FAT_CIGAM == magic || FAT_MAGIC == magic || FAT_CIGAM_64 == magic || FAT_MAGIC_64 == magic)
+    {
+        bool bFat64 = (FAT_MAGIC_64 == magic || FAT_CIGAM_64 == magic);
+        bool bSwap = (FAT_CIGAM == magic || FAT_CIGAM_64 == magic);
+        uint32_t uFatArch = ((const fat_header *)strHeader.data())->nfat_arch;
+        uFatArch = bSwap ? LE(uFatArch) : uFatArch;
+        uint64_t uFatSize =
+            sizeof(fat_header) + (uint64_t)uFatArch * (bFat64 ? sizeof(fat_arch_64) : sizeof(fat_arch));
+
+        vector<fat_arch_64> arrArches;
+        bRet = (uFatSize <= uFileSize) && _PReadFull(fd, 0, (size_t)uFatSize, strHeader) &&
+               ParseFatArches((const uint8_t *)strHeader.data(), uFatSize, uFileSize, arrArches, bFat64, bSwap);
+        for (size_t i = 0; bRet && i < arrArches.size(); i++)
+        {
+            arrProbes.push_back(ZMachOProbe());
+            bRet = ProbeArch(fd, arrArches[i].offset, arrArches[i].size, bSignature, arrProbes.back());
+        }
+    }
+    else if (bRet)
+    {
+        arrProbes.push_back(ZMachOProbe());
+        bRet = ProbeArch(fd, 0, uFileSize, bSignature, arrProbes.back());
+    }
+    close(fd);
+
+    return bRet && !arrProbes.empty();
+}
+
+bool ZMachO::ProbeDependencies(const char *szFile, vector<pair<uint32_t, string>> &arrDylibs,
+                               vector<string> &arrRPaths)
+{ // slices usually share their load commands, keep the first occurrence of each
+    vector<ZMachOProbe> arrProbes;
+    if (!Probe(szFile, arrProbes, false))
+    {
+        return false;
+    }
+
+    set<string> setDylibs;
+    set<string> setRPaths;
+    for (size_t i = 0; i < arrProbes.size(); i++)
+    {
+        for (size_t j = 0; j < arrProbes[i].arrDylibs.size(); j++)
+        {
+            if (setDylibs.insert(arrProbes[i].arrDylibs[j].second).second)
+            {
+                arrDylibs.push_back(arrProbes[i].arrDylibs[j]);
+            }
+        }
+        for (size_t j = 0; j < arrProbes[i].arrRPaths.size(); j++)
+        {
+            if (setRPaths.insert(arrProbes[i].arrRPaths[j]).second)
+            {
+                arrRPaths.push_back(arrProbes[i].arrRPaths[j]);
+            }
+        }
+    }
+    return true;
+}
+
+bool ZMachO::ProbeArch(int fd, uint64_t uOffset, uint64_t uSize, bool bSignature, ZMachOProbe &probe)
+{
+    probe.cputype = 0;
+    probe.cpusubtype = 0;
+    probe.filetype = 0;
+    probe.bEncrypted = false;
+    probe.bSigned = false;
+
+    string strCommands;
+    if (uSize < sizeof(mach_header_64) || !_PReadFull(fd, uOffset, sizeof(mach_header_64), strCommands))
+    {
+        return false;
+    }
+
+    const mach_header *pHeader = reinterpret_cast<const mach_header *>(strCommands.data());
+    uint32_t magic = pHeader->magic;
+    if (MH_MAGIC != magic && MH_CIGAM != magic && MH_MAGIC_64 != magic && MH_CIGAM_64 != magic)
+    {
+        return false;
+    }
+
+    bool bSwap = (MH_CIGAM == magic || MH_CIGAM_64 == magic);
+    auto BO32 = [bSwap](uint32_t uValue) { return bSwap ? LE(uValue) : uValue; };
+    bool b64 = (MH_MAGIC_64 == magic || MH_CIGAM_64 == magic);
+    uint64_t uHeaderSize = b64 ? sizeof(mach_header_64) : sizeof(mach_header);
+    uint32_t uCommands = BO32(pHeader->ncmds);
+    uint64_t uCommandsEnd = uHeaderSize + BO32(pHeader->sizeofcmds);
+    probe.cputype = (cpu_type_t)BO32((uint32_t)pHeader->cputype);
+    probe.cpusubtype = (cpu_subtype_t)BO32((uint32_t)pHeader->cpusubtype);
+    probe.filetype = BO32(pHeader->filetype);
+    if (uCommandsEnd > uSize || !_PReadFull(fd, uOffset, (size_t)uCommandsEnd, strCommands))
+    {
+        return false;
+    }
+
+    uint32_t uSignOffset = 0;
+    uint32_t uSignSize = 0;
+    const uint8_t *pCommands = (const uint8_t *)strCommands.data();
+    uint64_t uCursor = uHeaderSize;
+    for (uint32_t i = 0; i < uCommands && uCursor + sizeof(load_command) <= uCommandsEnd; i++)
+    {
+        const uint8_t *pLoadCommand = pCommands + uCursor;
+        uint32_t uLoadType = BO32(reinterpret_cast<const load_command *>(pLoadCommand)->cmd);
+        uint32_t uCmdSize = BO32(reinterpret_cast<const load_command *>(pLoadCommand)->cmdsize);
+        if (uCmdSize < sizeof(load_command) || uCursor + uCmdSize > uCommandsEnd)
+        {
+            break;
+        }
+
+        uint32_t uNameOffset = 0;
+        if (LC_LOAD_DYLIB == uLoadType || LC_LOAD_WEAK_DYLIB == uLoadType || LC_REEXPORT_DYLIB == uLoadType ||
+            LC_LAZY_LOAD_DYLIB == uLoadType || LC_LOAD_UPWARD_DYLIB == uLoadType)
+        {
+            uNameOffset = (uCmdSize >= sizeof(dylib_command))
+                              ? BO32(reinterpret_cast<const dylib_command *>(pLoadCommand)->dylib.name.offset)
+                              : 0;
+        }
+        else if (LC_RPATH == uLoadType)
+        {
+            uNameOffset = (uCmdSize >= sizeof(rpath_command))
+                              ? BO32(reinterpret_cast<const rpath_command *>(pLoadCommand)->path.offset)
+                              : 0;
+        }
+        else if ((LC_ENCRYPTION_INFO == uLoadType || LC_ENCRYPTION_INFO_64 == uLoadType) &&
+                 uCmdSize >= sizeof(encryption_info_command))
+        {
+            const encryption_info_command *crypt_cmd = reinterpret_cast<const encryption_info_command *>(pLoadCommand);
+            probe.bEncrypted = probe.bEncrypted || (0 != BO32(crypt_cmd->cryptid));
+        }
+        else if (LC_CODE_SIGNATURE == uLoadType && uCmdSize >= sizeof(codesignature_command))
+        {
+            const codesignature_command *pcslc = reinterpret_cast<const codesignature_command *>(pLoadCommand);
+            uSignOffset = BO32(pcslc->dataoff);
+            uSignSize = BO32(pcslc->datasize);
+        }
+
+        if (uNameOffset > 0 && uNameOffset < uCmdSize)
+        {
+            const char *szName = reinterpret_cast<const char *>(pLoadCommand + uNameOffset);
+            string strName(szName, strnlen(szName, uCmdSize - uNameOffset));
+            if (LC_RPATH == uLoadType)
+            {
+                probe.arrRPaths.push_back(strName);
+            }
+            else
+            {
+                probe.arrDylibs.push_back(make_pair(uLoadType, strName));
+            }
+        }
+        uCursor += uCmdSize;
+    }
+
+    probe.bSigned = (uSignSize > 0 && (uint64_t)uSignOffset + uSignSize <= uSize);
+    if (bSignature && probe.bSigned)
+    {
+        string strSignature;
+        if (!_PReadFull(fd, uOffset + uSignOffset, uSignSize, strSignature))
+        {
+            return false;
+        }
+        ProbeSignature(strSignature, probe);
+    }
+    return true;
+}
+
+void ZMachO::ProbeSignature(const string &strSignature, ZMachOProbe &probe)
+{ // the embedded signature is big endian whatever the slice is
+    const uint8_t *pBase = (const uint8_t *)strSignature.data();
+    const CS_SuperBlob *psb = reinterpret_cast<const CS_SuperBlob *>(pBase);
+    if (strSignature.size() < sizeof(CS_SuperBlob) || CSMAGIC_EMBEDDED_SIGNATURE != BE(psb->magic))
+    {
+        probe.bSigned = false;
+        return;
+    }
+
+    uint32_t uCount = BE(psb->count);
+    if (sizeof(CS_SuperBlob) + (uint64_t)uCount * sizeof(CS_BlobIndex) > strSignature.size())
+    {
+        probe.bSigned = false;
+        return;
+    }
+
+    const CS_CodeDirectory *pcd = NULL;
+    const CS_CodeDirectory *pcd256 = NULL;
+    const CS_BlobIndex *pbi = reinterpret_cast<const CS_BlobIndex *>(pBase + sizeof(CS_SuperBlob));
+    for (uint32_t i = 0; i < uCount; i++)
+    {
+        uint32_t uSlotType = BE(pbi[i].type);
+        uint32_t uSlotOffset = BE(pbi[i].offset);
+        if (CSSLOT_CODEDIRECTORY != uSlotType &&
+            (uSlotType < CSSLOT_ALTERNATE_CODEDIRECTORIES || uSlotType >= CSSLOT_ALTERNATE_CODEDIRECTORY_LIMIT))
+        {
+            continue;
+        }
+
+        const CS_CodeDirectory *pSlot = reinterpret_cast<const CS_CodeDirectory *>(pBase + uSlotOffset);
+        if ((uint64_t)uSlotOffset + offsetof(CS_CodeDirectory, scatterOffset) > strSignature.size() ||
+            CSMAGIC_CODEDIRECTORY != BE(pSlot->magic) || BE(pSlot->length) > strSignature.size() - uSlotOffset)
+        {
+            continue;
+        }
+
+        pcd = (CSSLOT_CODEDIRECTORY == uSlotType) ? pSlot : pcd;
+        pcd256 = (2 == pSlot->hashType) ? pSlot : pcd256;
+    }
+
+    if (NULL != pcd)
+    {
+        uint32_t uLength = BE(pcd->length);
+        uint32_t uTeamOffset = (uLength >= offsetof(CS_CodeDirectory, spare3)) ? BE(pcd->teamOffset) : 0;
+        if (BE(pcd->version) >= 0x20200 && uTeamOffset > 0 && uTeamOffset < uLength)
+        {
+            const char *szTeamID = reinterpret_cast<const char *>(pcd) + uTeamOffset;
+            probe.strTeamID.assign(szTeamID, strnlen(szTeamID, uLength - uTeamOffset));
+        }
+    }
+
+    if (NULL != pcd256)
+    { // truncated sha256, as the kernel and CodeResources record it
+        SHASum(E_SHASUM_TYPE_256, (uint8_t *)pcd256, BE(pcd256->length), probe.strCDHash);
+        probe.strCDHash.resize(20);
+    }
+    else if (NULL != pcd)
+    {
+        SHASum(E_SHASUM_TYPE_1, (uint8_t *)pcd, BE(pcd->length), probe.strCDHash);
+    }
+}
+
 void ZMachO::FreeArchOes()
 {
     for (size_t i = 0; i < m_arrArchOes.size(); i++)
@@ -75,20 +398,29 @@ bool ZMachO::OpenFile(const char *szPath)
     FreeArchOes();
 
     m_sSize = 0;
-    m_pBase = (uint8_t *)MapFile(szPath, 0, 0, &m_sSize, false);
+    m_pBase = (uint8_t *)MapFile(szPath, 0, 0, &m_sSize, m_bReadOnly);
     if (NULL != m_pBase && m_sSize > 0)
     {
+        if (m_bReadOnly)
+        { // queries only touch the headers and load commands, skip read-ahead of the rest
+            madvise(m_pBase, m_sSize, MADV_RANDOM);
+        }
+
         uint32_t magic = *((uint32_t *)m_pBase);
-        if (FAT_CIGAM == magic || FAT_MAGIC == magic)
+        if (FAT_CIGAM == magic || FAT_MAGIC == magic || FAT_CIGAM_64 == magic || FAT_MAGIC_64 == magic)
         {
-            fat_header *pFatHeader = reinterpret_cast<fat_header *>(m_pBase);
-            int nFatArch = (FAT_MAGIC == magic) ? pFatHeader->nfat_arch : LE(pFatHeader->nfat_arch);
-            for (int i = 0; i < nFatArch; i++)
+            bool bFat64 = false;
+            bool bSwap = false;
+            vector<fat_arch_64> arrArches;
+            if (!GetFatArches(arrArches, bFat64, bSwap))
+            {
+                ZLog::ErrorV(">>> Invalid Fat Macho File!\n");
+                return false;
+            }
+
+            for (size_t i = 0; i < arrArches.size(); i++)
             {
-                fat_arch *pFatArch = reinterpret_cast<fat_arch *>(m_pBase + sizeof(fat_header) + sizeof(fat_arch) * i);
-                uint8_t *pArchBase = m_pBase + ((FAT_MAGIC == magic) ? pFatArch->offset : LE(pFatArch->offset));
-                uint32_t uArchLength = (FAT_MAGIC == magic) ? pFatArch->size : LE(pFatArch->size);
-                if (!NewArchO(pArchBase, uArchLength))
+                if (!NewArchO(m_pBase + arrArches[i].offset, arrArches[i].size))
                 {
                     ZLog::ErrorV(">>> Invalid Arch File In Fat Macho File!\n");
                     return false;
@@ -97,7 +429,7 @@ bool ZMachO::OpenFile(const char *szPath)
         }
         else if (MH_MAGIC == magic || MH_CIGAM == magic || MH_MAGIC_64 == magic || MH_CIGAM_64 == magic)
         {
-            if (!NewArchO(m_pBase, (uint32_t)m_sSize))
+            if (!NewArchO(m_pBase, m_sSize))
             {
                 ZLog::ErrorV(">>> Invalid Macho File!\n");
                 return false;
@@ -128,6 +460,16 @@ bool ZMachO::CloseFile()
     return true;
 }
 
+bool ZMachO::IsWritable() const
+{
+    if (m_bReadOnly)
+    {
+        ZLog::ErrorV(">>> Macho File Opened Read-Only! %s\n", m_strFile.c_str());
+        return false;
+    }
+    return true;
+}
+
 void ZMachO::PrintInfo()
 {
     for (size_t i = 0; i < m_arrArchOes.size(); i++)
@@ -138,13 +480,20 @@ void ZMachO::PrintInfo()
 }
 
 bool ZMachO::Sign(ZSignAsset *pSignAsset, bool bForce, string strBundleId, string strInfoPlistSHA1,
-                  string strInfoPlistSHA256, const string &strCodeResourcesData)
+                  string strInfoPlistSHA256, const string &strCodeResourcesData, bool bSHA256Only)
 {
-    if (NULL == m_pBase || m_arrArchOes.empty())
+    if (NULL == m_pBase || m_arrArchOes.empty() || !IsWritable())
     {
         return false;
     }
 
+    m_strCDHash.clear();
+    for (size_t i = 0; i < m_arrArchOes.size(); i++)
+    { // before any slice signs, a realloc sizes every slice
+        m_arrArchOes[i]->SetPageSize(m_uPageSize);
+        m_arrArchOes[i]->SetSignatureSlack(m_uSignSlack);
+    }
+
     for (size_t i = 0; i < m_arrArchOes.size(); i++)
     {
         ZArchO *archo = m_arrArchOes[i];
@@ -172,34 +521,64 @@ bool ZMachO::Sign(ZSignAsset *pSignAsset, bool bForce, string strBundleId, strin
             }
         }
 
-        if (!archo->Sign(pSignAsset, bForce, strBundleId, strInfoPlistSHA1, strInfoPlistSHA256, strCodeResourcesData))
+        if (archo->Sign(pSignAsset, bForce, strBundleId, strInfoPlistSHA1, strInfoPlistSHA256, strCodeResourcesData,
+                        bSHA256Only))
+        { // prefer the arm64 slice, it is the one the device validates
+            uint32_t uCPUType = (uint32_t)archo->m_pHeader->cputype;
+            uCPUType = archo->m_bBigEndian ? LE(uCPUType) : uCPUType;
+            if (m_strCDHash.empty() || CPU_TYPE_ARM64 == (int)uCPUType)
+            {
+                m_strCDHash = archo->m_strCDHash;
+            }
+        }
+        else
         {
             if (!archo->m_bEnoughSpace && !m_bCSRealloced)
             {
                 m_bCSRealloced = true;
+                for (size_t j = i + 1; j < m_arrArchOes.size(); j++)
+                { // the slices not reached yet are sized as well, a file is reallocated only once
+                    m_arrArchOes[j]->m_uNeedSignLength =
+                        m_arrArchOes[j]->EstimateSignLength(pSignAsset, strBundleId, bSHA256Only);
+                }
                 if (ReallocCodeSignSpace())
                 {
                     return Sign(pSignAsset, bForce, strBundleId, strInfoPlistSHA1, strInfoPlistSHA256,
-                                strCodeResourcesData);
+                                strCodeResourcesData, bSHA256Only);
                 }
             }
             return false;
         }
     }
 
+    if (!CompactCodeSignSpace())
+    {
+        ZLog::ErrorV(">>> Can't Compact CodeSignature Space! %s\n", m_strFile.c_str());
+        return false;
+    }
     return CloseFile();
 }
 
+bool ZMachO::GetCDHash(string &strCDHash) const
+{
+    strCDHash = m_strCDHash;
+    return !strCDHash.empty();
+}
+
+void ZMachO::SetPageSize(uint32_t uPageSize) { m_uPageSize = uPageSize; }
+
+void ZMachO::SetSignatureSlack(uint32_t uSlack) { m_uSignSlack = uSlack; }
+
 bool ZMachO::ReallocCodeSignSpace()
 {
     ZLog::Warn(">>> Realloc CodeSignature Space... \n");
 
-    vector<uint32_t> arrMachOesSizes;
+    vector<uint64_t> arrMachOesSizes;
     for (size_t i = 0; i < m_arrArchOes.size(); i++)
     {
         string strNewArchOFile;
         StringFormat(strNewArchOFile, "%s.archo.%d", m_strFile.c_str(), i);
-        uint32_t uNewLength = m_arrArchOes[i]->ReallocCodeSignSpace(strNewArchOFile);
+        uint64_t uNewLength = m_arrArchOes[i]->ReallocCodeSignSpace(strNewArchOFile);
         if (uNewLength == 0)
         {
             ZLog::Error(">>> Failed!\n");
@@ -221,86 +600,191 @@ bool ZMachO::ReallocCodeSignSpace()
     }
     else
     { // fat
-        uint32_t uAlign = 16384;
-        vector<fat_arch> arrArches;
-        fat_header fath = *(reinterpret_cast<fat_header *>(m_pBase));
-        int nFatArch = (FAT_MAGIC == fath.magic) ? fath.nfat_arch : LE(fath.nfat_arch);
-        for (int i = 0; i < nFatArch; i++)
+        return RepackFatFile(arrMachOesSizes, vector<uint64_t>());
+    }
+
+    return false;
+}
+
+bool ZMachO::CompactCodeSignSpace()
+{ // slices whose signature space was right-sized are cut to their new length
+    if (1 == m_arrArchOes.size())
+    {
+        uint64_t uLength = m_arrArchOes[0]->m_uLength;
+        if (uLength >= m_sSize)
         {
-            fat_arch arch = *(reinterpret_cast<fat_arch *>(m_pBase + sizeof(fat_header) + sizeof(fat_arch) * i));
-            arrArches.push_back(arch);
+            return true;
         }
-        CloseFile();
 
-        if (arrArches.size() != m_arrArchOes.size())
+        CloseFile();
+        if (0 != truncate(m_strFile.c_str(), (off_t)uLength))
         {
             return false;
         }
+        return OpenFile(m_strFile.c_str());
+    }
 
-        uint32_t uFatHeaderSize = sizeof(fat_header) + arrArches.size() * sizeof(fat_arch);
-        uint32_t uPadding1 = (uAlign - uFatHeaderSize % uAlign);
-        uint32_t uOffset = uFatHeaderSize + uPadding1;
-        for (size_t i = 0; i < arrArches.size(); i++)
-        {
-            fat_arch &arch = arrArches[i];
-            uint32_t uMachOSize = arrMachOesSizes[i];
+    bool bFat64 = false;
+    bool bSwap = false;
+    vector<fat_arch_64> arrArches;
+    if (!GetFatArches(arrArches, bFat64, bSwap) || arrArches.size() != m_arrArchOes.size())
+    {
+        return false;
+    }
 
-            arch.align = (FAT_MAGIC == fath.magic) ? 14 : BE((uint32_t)14);
-            arch.offset = (FAT_MAGIC == fath.magic) ? uOffset : BE(uOffset);
-            arch.size = (FAT_MAGIC == fath.magic) ? uMachOSize : BE(uMachOSize);
+    bool bShrunk = false;
+    for (size_t i = 0; i < arrArches.size(); i++)
+    {
+        bShrunk = bShrunk || (m_arrArchOes[i]->m_uLength < arrArches[i].size);
+    }
+    if (!bShrunk)
+    {
+        return true;
+    }
 
-            uOffset += uMachOSize;
-            uOffset = uOffset + (uAlign - uOffset % uAlign);
-        }
+    vector<uint64_t> arrMachOesSizes;
+    vector<uint64_t> arrMachOesOffsets;
+    for (size_t i = 0; i < m_arrArchOes.size(); i++)
+    { // the shrunk slices are copied straight out of the signed file
+        ZArchO *archo = m_arrArchOes[i];
+        arrMachOesSizes.push_back(archo->m_uLength);
+        arrMachOesOffsets.push_back((uint64_t)(archo->m_pBase - m_pBase));
+    }
+    return RepackFatFile(arrMachOesSizes, arrMachOesOffsets);
+}
 
-        string strNewFatMachOFile = m_strFile + ".fato";
+bool ZMachO::RepackFatFile(const vector<uint64_t> &arrMachOesSizes, const vector<uint64_t> &arrMachOesOffsets)
+{ // slices come from <file> at the given offsets, or from <file>.archo.<n> when there are none
+    uint32_t uAlign = 16384;
+    bool bFat64 = false;
+    bool bSwap = false;
+    vector<fat_arch_64> arrArches;
+    bool bParsed = GetFatArches(arrArches, bFat64, bSwap);
+    CloseFile();
 
-        string strFatHeader;
-        strFatHeader.append((const char *)&fath, sizeof(fat_header));
+    if (!bParsed || arrArches.size() != m_arrArchOes.size())
+    {
+        return false;
+    }
+
+    uint64_t uOffset = 0;
+    for (int nPass = 0; nPass < 2; nPass++)
+    { // a slice that ends up past 4 GiB promotes the fat header to fat_arch_64
+        uint64_t uFatHeaderSize =
+            sizeof(fat_header) + arrArches.size() * (bFat64 ? sizeof(fat_arch_64) : sizeof(fat_arch));
+        uOffset = ByteAlign(uFatHeaderSize, uAlign);
+        bool bFits = true;
         for (size_t i = 0; i < arrArches.size(); i++)
         {
-            fat_arch &arch = arrArches[i];
-            strFatHeader.append((const char *)&arch, sizeof(fat_arch));
+            fat_arch_64 &arch = arrArches[i];
+            arch.align = 14;
+            arch.offset = uOffset;
+            arch.size = arrMachOesSizes[i];
+            bFits = bFits && (arch.offset + arch.size <= UINT32_MAX);
+
+            uOffset = ByteAlign(uOffset + arch.size, uAlign);
+        }
+        if (bFat64 || bFits)
+        {
+            break;
         }
+        bFat64 = true;
+    }
 
-        string strPadding1;
-        strPadding1.append(uPadding1, 0);
+    string strNewFatMachOFile = m_strFile + ".fato";
 
-        AppendFile(strNewFatMachOFile.c_str(), strFatHeader);
-        AppendFile(strNewFatMachOFile.c_str(), strPadding1);
+    fat_header fath;
+    fath.magic = bFat64 ? FAT_MAGIC_64 : FAT_MAGIC;
+    fath.magic = bSwap ? BE(fath.magic) : fath.magic;
+    fath.nfat_arch = bSwap ? BE((uint32_t)arrArches.size()) : (uint32_t)arrArches.size();
 
-        for (size_t i = 0; i < arrArches.size(); i++)
+    string strFatHeader;
+    strFatHeader.append((const char *)&fath, sizeof(fat_header));
+    for (size_t i = 0; i < arrArches.size(); i++)
+    {
+        fat_arch_64 arch = arrArches[i];
+        arch.cputype = bSwap ? (cpu_type_t)BE((uint32_t)arch.cputype) : arch.cputype;
+        arch.cpusubtype = bSwap ? (cpu_subtype_t)BE((uint32_t)arch.cpusubtype) : arch.cpusubtype;
+        arch.align = bSwap ? BE(arch.align) : arch.align;
+        if (bFat64)
         {
-            size_t sSize = 0;
-            string strNewArchOFile = m_strFile + ".archo." + JValue((int)i).asString();
-            uint8_t *pData = (uint8_t *)MapFile(strNewArchOFile.c_str(), 0, 0, &sSize, true);
-            if (NULL == pData)
-            {
-                RemoveFile(strNewFatMachOFile.c_str());
-                return false;
-            }
-            string strPadding;
-            strPadding.append((uAlign - sSize % uAlign), 0);
+            arch.offset = bSwap ? BE(arch.offset) : arch.offset;
+            arch.size = bSwap ? BE(arch.size) : arch.size;
+            strFatHeader.append((const char *)&arch, sizeof(fat_arch_64));
+        }
+        else
+        {
+            fat_arch arch32;
+            arch32.cputype = arch.cputype;
+            arch32.cpusubtype = arch.cpusubtype;
+            arch32.offset = bSwap ? BE((uint32_t)arch.offset) : (uint32_t)arch.offset;
+            arch32.size = bSwap ? BE((uint32_t)arch.size) : (uint32_t)arch.size;
+            arch32.align = arch.align;
+            strFatHeader.append((const char *)&arch32, sizeof(fat_arch));
+        }
+    }
+    ZFileWriter writer;
+    if (!writer.Open(strNewFatMachOFile.c_str(), uOffset + uAlign))
+    {
+        return false;
+    }
+    writer.Write(strFatHeader);
+    writer.WriteZero(arrArches[0].offset - strFatHeader.size());
 
-            AppendFile(strNewFatMachOFile.c_str(), (const char *)pData, sSize);
-            AppendFile(strNewFatMachOFile.c_str(), strPadding);
+    int fdFile = arrMachOesOffsets.empty() ? -1 : open(m_strFile.c_str(), O_RDONLY);
+    for (size_t i = 0; i < arrArches.size(); i++)
+    {
+        int fdSrc = fdFile;
+        uint64_t uSrcOffset = 0;
+        string strNewArchOFile = m_strFile + ".archo." + JValue((int)i).asString();
+        if (arrMachOesOffsets.empty())
+        {
+            fdSrc = open(strNewArchOFile.c_str(), O_RDONLY);
+        }
+        else
+        {
+            uSrcOffset = arrMachOesOffsets[i];
+        }
 
-            munmap(static_cast<void *>(pData), sSize);
+        bool bCopied = writer.WriteFrom(fdSrc, uSrcOffset, arrMachOesSizes[i]) &&
+                       writer.WriteZero(uAlign - arrMachOesSizes[i] % uAlign);
+        if (fdSrc != fdFile)
+        {
+            close(fdSrc);
             RemoveFile(strNewArchOFile.c_str());
         }
 
-        RemoveFile(m_strFile.c_str());
-        if (0 == rename(strNewFatMachOFile.c_str(), m_strFile.c_str()))
+        if (!bCopied)
         {
-            return OpenFile(m_strFile.c_str());
+            break;
         }
     }
+    if (fdFile >= 0)
+    {
+        close(fdFile);
+    }
 
+    if (!writer.Close())
+    {
+        RemoveFile(strNewFatMachOFile.c_str());
+        return false;
+    }
+
+    RemoveFile(m_strFile.c_str());
+    if (0 == rename(strNewFatMachOFile.c_str(), m_strFile.c_str()))
+    {
+        return OpenFile(m_strFile.c_str());
+    }
     return false;
 }
 
 bool ZMachO::InjectDyLib(bool bWeakInject, const char *szDyLibPath, bool &bCreate)
 {
+    if (!IsWritable())
+    {
+        return false;
+    }
+
     ZLog::WarnV(">>> Inject DyLib: %s ... \n", szDyLibPath);
 
     vector<uint32_t> arrMachOesSizes;
@@ -318,6 +802,11 @@ bool ZMachO::InjectDyLib(bool bWeakInject, const char *szDyLibPath, bool &bCreat
 
 bool ZMachO::ChangeDylibPath(const char *oldPath, const char *newPath)
 {
+    if (!IsWritable())
+    {
+        return false;
+    }
+
     ZLog::WarnV(">>> Change DyLib Path: %s -> %s ... \n", oldPath, newPath);
 
     bool pathChanged = true;
@@ -351,8 +840,39 @@ std::vector<std::string> ZMachO::ListDylibs()
 
     return dylibList;
 }
+void ZMachO::GetDependencies(vector<pair<uint32_t, string>> &arrDylibs, vector<string> &arrRPaths)
+{ // slices usually share their load commands, keep the first occurrence of each
+    set<string> setDylibs;
+    set<string> setRPaths;
+    for (size_t i = 0; i < m_arrArchOes.size(); i++)
+    {
+        vector<pair<uint32_t, string>> arrArchDylibs;
+        vector<string> arrArchRPaths;
+        m_arrArchOes[i]->GetDependencies(arrArchDylibs, arrArchRPaths);
+        for (size_t j = 0; j < arrArchDylibs.size(); j++)
+        {
+            if (setDylibs.insert(arrArchDylibs[j].second).second)
+            {
+                arrDylibs.push_back(arrArchDylibs[j]);
+            }
+        }
+        for (size_t j = 0; j < arrArchRPaths.size(); j++)
+        {
+            if (setRPaths.insert(arrArchRPaths[j]).second)
+            {
+                arrRPaths.push_back(arrArchRPaths[j]);
+            }
+        }
+    }
+}
+
 bool ZMachO::RemoveDylib(const std::set<std::string> &dylibNames)
 {
+    if (!IsWritable())
+    {
+        return false;
+    }
+
     ZLog::Warn(">>> Removing specified dylibs...\n");
 
     bool removalSuccessful = true;
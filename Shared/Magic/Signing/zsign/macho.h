@@ -13,6 +13,23 @@
 #pragma once
 #include "archo.h"
 
+/**
+ * One slice as seen by ZMachO::Probe, read from the headers, load commands and signature blob only.
+ * strCDHash holds the raw 20 byte cdhash, the SHA-256 CodeDirectory's when the slice carries one.
+ */
+struct ZMachOProbe
+{
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+    uint32_t filetype;
+    bool bEncrypted;
+    bool bSigned;
+    string strCDHash;
+    string strTeamID;
+    vector<pair<uint32_t, string>> arrDylibs;
+    vector<string> arrRPaths;
+};
+
 class ZMachO
 {
   public:
@@ -20,29 +37,50 @@ class ZMachO
     ~ZMachO();
 
   public:
-    bool Init(const char *szFile);
+    bool Init(const char *szFile, bool bReadOnly = false);
     bool InitV(const char *szFormatPath, ...);
     bool Free();
     void PrintInfo();
     bool Sign(ZSignAsset *pSignAsset, bool bForce, string strBundleId, string strInfoPlistSHA1,
-              string strInfoPlistSHA256, const string &strCodeResourcesData);
+              string strInfoPlistSHA256, const string &strCodeResourcesData, bool bSHA256Only = false);
     bool InjectDyLib(bool bWeakInject, const char *szDyLibPath, bool &bCreate);
     bool ChangeDylibPath(const char *oldPath, const char *newPath);
     std::vector<std::string> ListDylibs();
+    void GetDependencies(vector<pair<uint32_t, string>> &arrDylibs, vector<string> &arrRPaths);
     bool RemoveDylib(const std::set<std::string> &dylibNames);
+    bool GetCDHash(string &strCDHash) const;
+    void SetPageSize(uint32_t uPageSize);
+    void SetSignatureSlack(uint32_t uSlack);
+
+  public:
+    static bool Probe(const char *szFile, vector<ZMachOProbe> &arrProbes, bool bSignature = true);
+    static bool ProbeDependencies(const char *szFile, vector<pair<uint32_t, string>> &arrDylibs,
+                                  vector<string> &arrRPaths);
 
   private:
     bool OpenFile(const char *szPath);
     bool CloseFile();
+    bool IsWritable() const;
 
-    bool NewArchO(uint8_t *pBase, uint32_t uLength);
+    bool NewArchO(uint8_t *pBase, uint64_t uLength);
+    bool GetFatArches(vector<fat_arch_64> &arrArches, bool &bFat64, bool &bSwap) const;
+    static bool ParseFatArches(const uint8_t *pData, uint64_t uDataSize, uint64_t uFileSize,
+                               vector<fat_arch_64> &arrArches, bool &bFat64, bool &bSwap);
+    static bool ProbeArch(int fd, uint64_t uOffset, uint64_t uSize, bool bSignature, ZMachOProbe &probe);
+    static void ProbeSignature(const string &strSignature, ZMachOProbe &probe);
     void FreeArchOes();
     bool ReallocCodeSignSpace();
+    bool CompactCodeSignSpace();
+    bool RepackFatFile(const vector<uint64_t> &arrMachOesSizes, const vector<uint64_t> &arrMachOesOffsets);
 
   private:
     size_t m_sSize;
     string m_strFile;
     uint8_t *m_pBase;
     bool m_bCSRealloced;
+    bool m_bReadOnly;
+    uint32_t m_uPageSize;
+    uint32_t m_uSignSlack;
     vector<ZArchO *> m_arrArchOes;
+    string m_strCDHash;
 };
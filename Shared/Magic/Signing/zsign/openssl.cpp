@@ -10,6 +10,8 @@
 #include "openssl.h"
 #include "common/base64.h"
 #include "common/common.h"
+#include "registry.h"
+#include "sslptr.h"
 
 #include <openssl/cms.h>
 #include <openssl/conf.h>
@@ -126,104 +128,114 @@ bool CMSError()
 ASN1_TYPE *_GenerateASN1Type(const string &value)
 {
     long errline = -1;
-    char *genstr = NULL;
-    BIO *ldapbio = BIO_new(BIO_s_mem());
-    CONF *cnf = NCONF_new(NULL);
-
-    if (cnf == NULL)
+    ZSSLPtr<BIO> ldapbio(BIO_new(BIO_s_mem()));
+    ZSSLPtr<CONF> cnf(NCONF_new(NULL));
+    if (!ldapbio || !cnf)
     {
         ZLog::Error(">>> NCONF_new failed\n");
-        BIO_free(ldapbio);
+        return NULL;
     }
+
     string a = "asn1=SEQUENCE:A\n[A]\nC=OBJECT:sha256\nB=FORMAT:HEX,OCT:" + value + "\n";
-    [[maybe_unused]] int code = BIO_puts(ldapbio, a.c_str());
-    if (NCONF_load_bio(cnf, ldapbio, &errline) <= 0)
+    BIO_puts(ldapbio.get(), a.c_str());
+    if (NCONF_load_bio(cnf.get(), ldapbio.get(), &errline) <= 0)
     {
-        BIO_free(ldapbio);
-        NCONF_free(cnf);
         ZLog::PrintV(">>> NCONF_load_bio failed %d\n", errline);
+        return NULL;
     }
-    BIO_free(ldapbio);
-    genstr = NCONF_get_string(cnf, "default", "asn1");
 
+    char *genstr = NCONF_get_string(cnf.get(), "default", "asn1");
     if (genstr == NULL)
     {
         ZLog::Error(">>> NCONF_get_string failed\n");
-        NCONF_free(cnf);
+        return NULL;
     }
-    ASN1_TYPE *ret = ASN1_generate_nconf(genstr, cnf);
-    NCONF_free(cnf);
-    return ret;
+    return ASN1_generate_nconf(genstr, cnf.get());
 }
 
-bool _GenerateCMS(X509 *scert, EVP_PKEY *spkey, const string &strCDHashData, const string &strCDHashPlist,
-                  const string &strCodeDirectorySlotSHA1, const string &strAltnateCodeDirectorySlot256,
-                  string &strCMSOutput)
+static STACK_OF(X509) * _NewAppleCertChain(const char *szIntermediateCert)
 {
-    if (!scert || !spkey)
+    ZSSLPtr<BIO> bother1(BIO_new_mem_buf(szIntermediateCert, (int)strlen(szIntermediateCert)));
+    ZSSLPtr<BIO> bother2(BIO_new_mem_buf(appleRootCACert, (int)strlen(appleRootCACert)));
+    if (!bother1 || !bother2)
     {
-        return CMSError();
+        return NULL;
     }
 
-    BIO *bother1;
-    unsigned long issuerHash = X509_issuer_name_hash(scert);
-    if (0x817d2f7a == issuerHash)
+    ZSSLPtr<X509> ocert1(PEM_read_bio_X509(bother1.get(), NULL, 0, NULL));
+    ZSSLPtr<X509> ocert2(PEM_read_bio_X509(bother2.get(), NULL, 0, NULL));
+    ZSSLPtr<STACK_OF(X509)> otherCerts(sk_X509_new_null());
+    if (!ocert1 || !ocert2 || !otherCerts)
     {
-        bother1 = BIO_new_mem_buf(appleDevCACert, (int)strlen(appleDevCACert));
+        return NULL;
     }
-    else if (0x9b16b75c == issuerHash)
+
+    if (!sk_X509_push(otherCerts.get(), ocert1.get()))
     {
-        bother1 = BIO_new_mem_buf(appleDevCACertG3, (int)strlen(appleDevCACertG3));
+        return NULL;
     }
-    else
+    ocert1.release();
+
+    if (!sk_X509_push(otherCerts.get(), ocert2.get()))
     {
-        ZLog::Error(">>> Unknown Issuer Hash!\n");
-        return false;
+        return NULL;
     }
+    ocert2.release();
 
-    BIO *bother2 = BIO_new_mem_buf(appleRootCACert, (int)strlen(appleRootCACert));
-    if (!bother1 || !bother2)
+    return otherCerts.release();
+}
+
+static STACK_OF(X509) * _GetAppleCertChain(unsigned long issuerHash)
+{ // parsed once, CMS_sign only takes references to the certificates
+    static ZSSLPtr<STACK_OF(X509)> s_devCAChain(_NewAppleCertChain(appleDevCACert));
+    static ZSSLPtr<STACK_OF(X509)> s_devCAG3Chain(_NewAppleCertChain(appleDevCACertG3));
+    if (0x817d2f7a == issuerHash)
     {
-        return CMSError();
+        return s_devCAChain.get();
     }
-
-    X509 *ocert1 = PEM_read_bio_X509(bother1, NULL, 0, NULL);
-    X509 *ocert2 = PEM_read_bio_X509(bother2, NULL, 0, NULL);
-    if (!ocert1 || !ocert2)
+    else if (0x9b16b75c == issuerHash)
     {
-        return CMSError();
+        return s_devCAG3Chain.get();
     }
+    return NULL;
+}
 
-    STACK_OF(X509) *otherCerts = sk_X509_new_null();
-    if (!otherCerts)
+bool _GenerateCMS(X509 *scert, EVP_PKEY *spkey, const string &strCDHashData, const string &strCDHashPlist,
+                  const string &strCodeDirectorySlotSHA1, const string &strAltnateCodeDirectorySlot256,
+                  string &strCMSOutput)
+{
+    if (!scert || !spkey)
     {
         return CMSError();
     }
 
-    if (!sk_X509_push(otherCerts, ocert1))
+    unsigned long issuerHash = X509_issuer_name_hash(scert);
+    if (0x817d2f7a != issuerHash && 0x9b16b75c != issuerHash)
     {
-        return CMSError();
+        ZLog::Error(">>> Unknown Issuer Hash!\n");
+        return false;
     }
 
-    if (!sk_X509_push(otherCerts, ocert2))
+    STACK_OF(X509) *otherCerts = _GetAppleCertChain(issuerHash);
+    if (!otherCerts)
     {
         return CMSError();
     }
 
-    BIO *in = BIO_new_mem_buf(strCDHashData.c_str(), (int)strCDHashData.size());
+    ZSSLPtr<BIO> in(BIO_new_mem_buf(strCDHashData.c_str(), (int)strCDHashData.size()));
     if (!in)
     {
         return CMSError();
     }
 
     int nFlags = CMS_PARTIAL | CMS_DETACHED | CMS_NOSMIMECAP | CMS_BINARY;
-    CMS_ContentInfo *cms = CMS_sign(NULL, NULL, otherCerts, NULL, nFlags);
+    ZSSLPtr<CMS_ContentInfo> cms(CMS_sign(NULL, NULL, otherCerts, NULL, nFlags));
     if (!cms)
     {
         return CMSError();
     }
 
-    CMS_SignerInfo *si = CMS_add1_signer(cms, scert, spkey, EVP_sha256(), nFlags);
+    CMS_SignerInfo *si = CMS_add1_signer(cms.get(), scert, spkey, EVP_sha256(), nFlags);
     //    CMS_add1_signer(cms, NULL, NULL, EVP_sha1(), nFlags);
     if (!si)
     {
@@ -231,13 +243,15 @@ bool _GenerateCMS(X509 *scert, EVP_PKEY *spkey, const string &strCDHashData, con
     }
 
     // add plist
-    ASN1_OBJECT *obj = OBJ_txt2obj("1.2.840.113635.100.9.1", 1);
-    if (!obj)
+    static ZSSLPtr<ASN1_OBJECT> s_objCDHashes(OBJ_txt2obj("1.2.840.113635.100.9.1", 1));
+    static ZSSLPtr<ASN1_OBJECT> s_objCDHashes2(OBJ_txt2obj("1.2.840.113635.100.9.2", 1));
+    if (!s_objCDHashes || !s_objCDHashes2)
     {
         return CMSError();
     }
 
-    int addHashPlist = CMS_signed_add1_attr_by_OBJ(si, obj, 0x4, strCDHashPlist.c_str(), (int)strCDHashPlist.size());
+    int addHashPlist = CMS_signed_add1_attr_by_OBJ(si, s_objCDHashes.get(), 0x4, strCDHashPlist.c_str(),
+                                                   (int)strCDHashPlist.size());
 
     if (!addHashPlist)
     {
@@ -254,43 +268,41 @@ bool _GenerateCMS(X509 *scert, EVP_PKEY *spkey, const string &strCDHashData, con
     }
     transform(sha256.begin(), sha256.end(), sha256.begin(), ::toupper);
 
-    ASN1_OBJECT *obj2 = OBJ_txt2obj("1.2.840.113635.100.9.2", 1);
-    if (!obj2)
+    ZSSLPtr<X509_ATTRIBUTE> attr(X509_ATTRIBUTE_new());
+    ZSSLPtr<ASN1_TYPE> type_256(_GenerateASN1Type(sha256));
+    if (!attr || !type_256)
     {
         return CMSError();
     }
 
-    X509_ATTRIBUTE *attr = X509_ATTRIBUTE_new();
-    X509_ATTRIBUTE_set1_object(attr, obj2);
-
-    ASN1_TYPE *type_256 = _GenerateASN1Type(sha256);
-    X509_ATTRIBUTE_set1_data(attr, V_ASN1_SEQUENCE, type_256->value.asn1_string->data,
+    X509_ATTRIBUTE_set1_object(attr.get(), s_objCDHashes2.get());
+    X509_ATTRIBUTE_set1_data(attr.get(), V_ASN1_SEQUENCE, type_256->value.asn1_string->data,
                              type_256->value.asn1_string->length);
-    int addHashSHA = CMS_signed_add1_attr(si, attr);
+    int addHashSHA = CMS_signed_add1_attr(si, attr.get());
     if (!addHashSHA)
     {
         return CMSError();
     }
 
-    if (!CMS_final(cms, in, NULL, nFlags))
+    if (!CMS_final(cms.get(), in.get(), NULL, nFlags))
     {
         return CMSError();
     }
 
-    BIO *out = BIO_new(BIO_s_mem());
+    ZSSLPtr<BIO> out(BIO_new(BIO_s_mem()));
     if (!out)
     {
         return CMSError();
     }
 
     // PEM_write_bio_CMS(out, cms);
-    if (!i2d_CMS_bio(out, cms))
+    if (!i2d_CMS_bio(out.get(), cms.get()))
     {
         return CMSError();
     }
 
     BUF_MEM *bptr = NULL;
-    BIO_get_mem_ptr(out, &bptr);
+    BIO_get_mem_ptr(out.get(), &bptr);
     if (!bptr)
     {
         return CMSError();
@@ -298,29 +310,28 @@ bool _GenerateCMS(X509 *scert, EVP_PKEY *spkey, const string &strCDHashData, con
 
     strCMSOutput.clear();
     strCMSOutput.append(bptr->data, bptr->length);
-    ASN1_TYPE_free(type_256);
     return (!strCMSOutput.empty());
 }
 
 bool GenerateCMS(const string &strSignerCertData, const string &strSignerPKeyData, const string &strCDHashData,
                  const string &strCDHashesPlist, string &strCMSOutput)
 {
-    BIO *bcert = BIO_new_mem_buf(strSignerCertData.c_str(), (int)strSignerCertData.size());
-    BIO *bpkey = BIO_new_mem_buf(strSignerPKeyData.c_str(), (int)strSignerPKeyData.size());
+    ZSSLPtr<BIO> bcert(BIO_new_mem_buf(strSignerCertData.c_str(), (int)strSignerCertData.size()));
+    ZSSLPtr<BIO> bpkey(BIO_new_mem_buf(strSignerPKeyData.c_str(), (int)strSignerPKeyData.size()));
 
     if (!bcert || !bpkey)
     {
         return CMSError();
     }
 
-    X509 *scert = PEM_read_bio_X509(bcert, NULL, 0, NULL);
-    EVP_PKEY *spkey = PEM_read_bio_PrivateKey(bpkey, NULL, 0, NULL);
+    ZSSLPtr<X509> scert(PEM_read_bio_X509(bcert.get(), NULL, 0, NULL));
+    ZSSLPtr<EVP_PKEY> spkey(PEM_read_bio_PrivateKey(bpkey.get(), NULL, 0, NULL));
     if (!scert || !spkey)
     {
         return CMSError();
     }
 
-    return ::_GenerateCMS(scert, spkey, strCDHashData, strCDHashesPlist, "", "", strCMSOutput);
+    return ::_GenerateCMS(scert.get(), spkey.get(), strCDHashData, strCDHashesPlist, "", "", strCMSOutput);
 }
 
 bool GetCMSContent(const string &strCMSDataInput, string &strContentOutput)
@@ -330,16 +341,14 @@ bool GetCMSContent(const string &strCMSDataInput, string &strContentOutput)
         return false;
     }
 
-    BIO *in = BIO_new(BIO_s_mem());
-    OPENSSL_assert((size_t)BIO_write(in, strCMSDataInput.data(), (int)strCMSDataInput.size()) ==
-                   strCMSDataInput.size());
-    CMS_ContentInfo *cms = d2i_CMS_bio(in, NULL);
+    ZSSLPtr<BIO> in(BIO_new_mem_buf(strCMSDataInput.data(), (int)strCMSDataInput.size()));
+    ZSSLPtr<CMS_ContentInfo> cms(in ? d2i_CMS_bio(in.get(), NULL) : NULL);
     if (!cms)
     {
         return CMSError();
     }
 
-    ASN1_OCTET_STRING **pos = CMS_get0_content(cms);
+    ASN1_OCTET_STRING **pos = CMS_get0_content(cms.get());
     if (!pos)
     {
         return CMSError();
@@ -394,19 +403,19 @@ bool GetCertSubjectCN(const string &strCertData, string &strSubjectCN)
         return false;
     }
 
-    BIO *bcert = BIO_new_mem_buf(strCertData.c_str(), strCertData.size());
+    ZSSLPtr<BIO> bcert(BIO_new_mem_buf(strCertData.c_str(), strCertData.size()));
     if (!bcert)
     {
         return CMSError();
     }
 
-    X509 *cert = PEM_read_bio_X509(bcert, NULL, 0, NULL);
+    ZSSLPtr<X509> cert(PEM_read_bio_X509(bcert.get(), NULL, 0, NULL));
     if (!cert)
     {
         return CMSError();
     }
 
-    return GetCertSubjectCN(cert, strSubjectCN);
+    return GetCertSubjectCN(cert.get(), strSubjectCN);
 }
 
 void ParseCertSubject(const string &strSubject, JValue &jvSubject)
@@ -431,16 +440,16 @@ string ASN1_TIMEtoString(ASN1_TIME *time)
 string ASN1_TIMEtoString(const ASN1_TIME *time)
 {
 #endif
-    BIO *out = BIO_new(BIO_s_mem());
+    ZSSLPtr<BIO> out(BIO_new(BIO_s_mem()));
     if (!out)
     {
         CMSError();
         return "";
     }
 
-    ASN1_TIME_print(out, time);
+    ASN1_TIME_print(out.get(), time);
     BUF_MEM *bptr = NULL;
-    BIO_get_mem_ptr(out, &bptr);
+    BIO_get_mem_ptr(out.get(), &bptr);
     if (!bptr)
     {
         CMSError();
@@ -463,17 +472,17 @@ bool GetCertInfo(X509 *cert, JValue &jvCertInfo)
     ASN1_INTEGER *asn1_i = X509_get_serialNumber(cert);
     if (asn1_i)
     {
-        BIGNUM *bignum = ASN1_INTEGER_to_BN(asn1_i, NULL);
-        if (bignum)
+        ZSSLPtr<BIGNUM> bignum(ASN1_INTEGER_to_BN(asn1_i, NULL));
+        ZSSLPtr<char> serial(bignum ? BN_bn2hex(bignum.get()) : NULL);
+        if (serial)
         {
-            jvCertInfo["SerialNumber"] = BN_bn2hex(bignum);
+            jvCertInfo["SerialNumber"] = serial.get();
         }
     }
 
     jvCertInfo["SignatureAlgorithm"] = OBJ_nid2ln(X509_get_signature_nid(cert));
 
-    EVP_PKEY *pubkey = X509_get_pubkey(cert);
-    int type = EVP_PKEY_id(pubkey);
+    int type = EVP_PKEY_id(X509_get0_pubkey(cert));
     jvCertInfo["PublicKey"]["Algorithm"] = OBJ_nid2ln(type);
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
@@ -484,8 +493,10 @@ bool GetCertInfo(X509 *cert, JValue &jvCertInfo)
     jvCertInfo["Validity"]["NotAfter"] = ASN1_TIMEtoString(X509_get0_notAfter(cert));
 #endif
 
-    string strIssuer = X509_NAME_oneline(X509_get_issuer_name(cert), NULL, 0);
-    string strSubject = X509_NAME_oneline(X509_get_subject_name(cert), NULL, 0);
+    ZSSLPtr<char> issuer(X509_NAME_oneline(X509_get_issuer_name(cert), NULL, 0));
+    ZSSLPtr<char> subject(X509_NAME_oneline(X509_get_subject_name(cert), NULL, 0));
+    string strIssuer = issuer ? issuer.get() : "";
+    string strSubject = subject ? subject.get() : "";
 
     ParseCertSubject(strIssuer, jvCertInfo["Issuer"]);
     ParseCertSubject(strSubject, jvCertInfo["Subject"]);
@@ -495,22 +506,21 @@ bool GetCertInfo(X509 *cert, JValue &jvCertInfo)
 
 bool GetCMSInfo(uint8_t *pCMSData, uint32_t uCMSLength, JValue &jvOutput)
 {
-    BIO *in = BIO_new(BIO_s_mem());
-    OPENSSL_assert((size_t)BIO_write(in, pCMSData, uCMSLength) == uCMSLength);
-    CMS_ContentInfo *cms = d2i_CMS_bio(in, NULL);
+    ZSSLPtr<BIO> in(BIO_new_mem_buf(pCMSData, (int)uCMSLength));
+    ZSSLPtr<CMS_ContentInfo> cms(in ? d2i_CMS_bio(in.get(), NULL) : NULL);
     if (!cms)
     {
         return CMSError();
     }
 
-    int detached = CMS_is_detached(cms);
+    int detached = CMS_is_detached(cms.get());
     jvOutput["detached"] = detached;
 
-    const ASN1_OBJECT *obj = CMS_get0_type(cms);
+    const ASN1_OBJECT *obj = CMS_get0_type(cms.get());
     const char *sn = OBJ_nid2ln(OBJ_obj2nid(obj));
     jvOutput["contentType"] = sn;
 
-    ASN1_OCTET_STRING **pos = CMS_get0_content(cms);
+    ASN1_OCTET_STRING **pos = CMS_get0_content(cms.get());
     if (pos)
     {
         if ((*pos))
@@ -520,17 +530,17 @@ bool GetCMSInfo(uint8_t *pCMSData, uint32_t uCMSLength, JValue &jvOutput)
         }
     }
 
-    STACK_OF(X509) *certs = CMS_get1_certs(cms);
-    for (int i = 0; i < sk_X509_num(certs); i++)
+    ZSSLPtr<STACK_OF(X509)> certs(CMS_get1_certs(cms.get()));
+    for (int i = 0; i < sk_X509_num(certs.get()); i++)
     {
         JValue jvCertInfo;
-        if (GetCertInfo(sk_X509_value(certs, i), jvCertInfo))
+        if (GetCertInfo(sk_X509_value(certs.get(), i), jvCertInfo))
         {
             jvOutput["certs"].push_back(jvCertInfo);
         }
     }
 
-    STACK_OF(CMS_SignerInfo) *sis = CMS_get0_SignerInfos(cms);
+    STACK_OF(CMS_SignerInfo) *sis = CMS_get0_SignerInfos(cms.get());
     for (int i = 0; i < sk_CMS_SignerInfo_num(sis); i++)
     {
         CMS_SignerInfo *si = sk_CMS_SignerInfo_value(sis, i);
@@ -590,14 +600,12 @@ bool GetCMSInfo(uint8_t *pCMSData, uint32_t uCMSLength, JValue &jvOutput)
                 ASN1_TYPE *av = X509_ATTRIBUTE_get0_type(attr, 0);
                 if (NULL != av)
                 {
-                    BIO *mem = BIO_new(BIO_s_mem());
-                    ASN1_UTCTIME_print(mem, av->value.utctime);
+                    ZSSLPtr<BIO> mem(BIO_new(BIO_s_mem()));
+                    ASN1_UTCTIME_print(mem.get(), av->value.utctime);
                     BUF_MEM *bptr = NULL;
-                    BIO_get_mem_ptr(mem, &bptr);
-                    BIO_set_close(mem, BIO_NOCLOSE);
+                    BIO_get_mem_ptr(mem.get(), &bptr);
                     string strTime;
                     strTime.append(bptr->data, bptr->length);
-                    BIO_free_all(mem);
 
                     jvOutput["attrs"]["SigningTime"]["obj"] = txtobj;
                     jvOutput["attrs"]["SigningTime"]["data"] = strTime;
@@ -613,15 +621,13 @@ bool GetCMSInfo(uint8_t *pCMSData, uint32_t uCMSLength, JValue &jvOutput)
                     {
                         ASN1_STRING *s = av->value.sequence;
 
-                        BIO *mem = BIO_new(BIO_s_mem());
+                        ZSSLPtr<BIO> mem(BIO_new(BIO_s_mem()));
 
-                        ASN1_parse_dump(mem, s->data, s->length, 2, 0);
+                        ASN1_parse_dump(mem.get(), s->data, s->length, 2, 0);
                         BUF_MEM *bptr = NULL;
-                        BIO_get_mem_ptr(mem, &bptr);
-                        BIO_set_close(mem, BIO_NOCLOSE);
+                        BIO_get_mem_ptr(mem.get(), &bptr);
                         string strData;
                         strData.append(bptr->data, bptr->length);
-                        BIO_free_all(mem);
 
                         string strSHASum;
                         size_t pos1 = strData.find("[HEX DUMP]:");
@@ -670,13 +676,17 @@ bool GetCMSInfo(uint8_t *pCMSData, uint32_t uCMSLength, JValue &jvOutput)
 
 ZSignAsset::ZSignAsset()
 {
+    m_bAdhoc = false;
     m_evpPKey = NULL;
     m_x509Cert = NULL;
 }
 
+ZSignAsset::~ZSignAsset() { Free(); }
+
 bool ZSignAsset::Init(const string &strSignerCertFile, const string &strSignerPKeyFile, const string &strProvisionFile,
-                      const string &strEntitlementsFile, const string &strPassword)
+                      const string &strEntitlementsFile, const string &strPassword, ZSignRegistry *pRegistry)
 {
+    m_bAdhoc = false;
     ReadFile(strProvisionFile.c_str(), m_strProvisionData);
     ReadFile(strEntitlementsFile.c_str(), m_strEntitlementsData);
     if (m_strProvisionData.empty())
@@ -685,16 +695,37 @@ bool ZSignAsset::Init(const string &strSignerCertFile, const string &strSignerPK
         return false;
     }
 
-    JValue jvProv;
-    string strProvContent;
-    if (GetCMSContent(m_strProvisionData, strProvContent))
+    JValue jvProfile;
+    vector<string> arrCertData;
+    if (NULL != pRegistry && pRegistry->GetProfile(m_strProvisionData, jvProfile))
+    { // decoded once, then served from the registry cache
+        m_strTeamId = jvProfile["team"].asString();
+        if (m_strEntitlementsData.empty())
+        {
+            m_strEntitlementsData = jvProfile["entitlements"].asString();
+        }
+        for (size_t i = 0; i < jvProfile["certs"].size(); i++)
+        {
+            arrCertData.push_back(jvProfile["certs"][i]["der"].asData());
+        }
+    }
+    else
     {
-        if (jvProv.readPList(strProvContent))
+        JValue jvProv;
+        string strProvContent;
+        if (GetCMSContent(m_strProvisionData, strProvContent))
         {
-            m_strTeamId = jvProv["TeamIdentifier"][0].asCString();
-            if (m_strEntitlementsData.empty())
+            if (jvProv.readPList(strProvContent))
             {
-                jvProv["Entitlements"].writePList(m_strEntitlementsData);
+                m_strTeamId = jvProv["TeamIdentifier"][0].asCString();
+                if (m_strEntitlementsData.empty())
+                {
+                    jvProv["Entitlements"].writePList(m_strEntitlementsData);
+                }
+                for (size_t i = 0; i < jvProv["DeveloperCertificates"].size(); i++)
+                {
+                    arrCertData.push_back(jvProv["DeveloperCertificates"][i].asData());
+                }
             }
         }
     }
@@ -705,108 +736,140 @@ bool ZSignAsset::Init(const string &strSignerCertFile, const string &strSignerPK
         return false;
     }
 
-    X509 *x509Cert = NULL;
-    EVP_PKEY *evpPKey = NULL;
-    BIO *bioPKey = BIO_new_file(strSignerPKeyFile.c_str(), "r");
-    if (NULL != bioPKey)
+    X509 *pP12Cert = NULL;
+    EVP_PKEY *pPKey = NULL;
+    ZSSLPtr<BIO> bioPKey(BIO_new_file(strSignerPKeyFile.c_str(), "r"));
+    if (bioPKey)
     {
-        evpPKey = PEM_read_bio_PrivateKey(bioPKey, NULL, NULL, (void *)strPassword.c_str());
-        if (NULL == evpPKey)
+        pPKey = PEM_read_bio_PrivateKey(bioPKey.get(), NULL, NULL, (void *)strPassword.c_str());
+        if (NULL == pPKey)
         {
-            BIO_reset(bioPKey);
-            evpPKey = d2i_PrivateKey_bio(bioPKey, NULL);
-            if (NULL == evpPKey)
+            BIO_reset(bioPKey.get());
+            pPKey = d2i_PrivateKey_bio(bioPKey.get(), NULL);
+            if (NULL == pPKey)
             {
-                BIO_reset(bioPKey);
+                BIO_reset(bioPKey.get());
                 OSSL_PROVIDER_load(NULL, "legacy");
-                PKCS12 *p12 = d2i_PKCS12_bio(bioPKey, NULL);
-                if (NULL != p12)
+                ZSSLPtr<PKCS12> p12(d2i_PKCS12_bio(bioPKey.get(), NULL));
+                if (p12)
                 {
-                    if (0 == PKCS12_parse(p12, strPassword.c_str(), &evpPKey, &x509Cert, NULL))
+                    if (0 == PKCS12_parse(p12.get(), strPassword.c_str(), &pPKey, &pP12Cert, NULL))
                     {
                         CMSError();
                     }
-                    PKCS12_free(p12);
                 }
             }
         }
-        BIO_free(bioPKey);
     }
 
-    if (NULL == evpPKey)
+    ZSSLPtr<EVP_PKEY> evpPKey(pPKey);
+    ZSSLPtr<X509> x509Cert(pP12Cert);
+    if (!evpPKey)
     {
         ZLog::Error(">>> Can't Load P12 or PrivateKey File! Please Input The Correct File And Password!\n");
         return false;
     }
 
-    if (NULL == x509Cert && !strSignerCertFile.empty())
+    if (!x509Cert && !strSignerCertFile.empty())
     {
-        BIO *bioCert = BIO_new_file(strSignerCertFile.c_str(), "r");
-        if (NULL != bioCert)
+        ZSSLPtr<BIO> bioCert(BIO_new_file(strSignerCertFile.c_str(), "r"));
+        if (bioCert)
         {
-            x509Cert = PEM_read_bio_X509(bioCert, NULL, 0, NULL);
-            if (NULL == x509Cert)
+            x509Cert.reset(PEM_read_bio_X509(bioCert.get(), NULL, 0, NULL));
+            if (!x509Cert)
             {
-                BIO_reset(bioCert);
-                x509Cert = d2i_X509_bio(bioCert, NULL);
+                BIO_reset(bioCert.get());
+                x509Cert.reset(d2i_X509_bio(bioCert.get(), NULL));
             }
-            BIO_free(bioCert);
         }
     }
 
-    if (NULL != x509Cert)
+    if (x509Cert && !X509_check_private_key(x509Cert.get(), evpPKey.get()))
     {
-        if (!X509_check_private_key(x509Cert, evpPKey))
-        {
-            X509_free(x509Cert);
-            x509Cert = NULL;
-        }
+        x509Cert.reset();
     }
 
-    if (NULL == x509Cert)
+    string strPairedCert;
+    if (!x509Cert && NULL != pRegistry &&
+        pRegistry->FindPairedCert(jvProfile["key"].asString(), ZSignRegistry::GetPublicKeyFP(evpPKey.get()),
+                                  strPairedCert))
+    { // same public key, no need to try every certificate against the key
+        const unsigned char *pDER = (const unsigned char *)strPairedCert.data();
+        x509Cert.reset(d2i_X509(NULL, &pDER, (long)strPairedCert.size()));
+    }
+
+    for (size_t i = 0; !x509Cert && i < arrCertData.size(); i++)
     {
-        for (size_t i = 0; i < jvProv["DeveloperCertificates"].size(); i++)
+        const unsigned char *pDER = (const unsigned char *)arrCertData[i].data();
+        x509Cert.reset(d2i_X509(NULL, &pDER, (long)arrCertData[i].size()));
+        if (x509Cert && !X509_check_private_key(x509Cert.get(), evpPKey.get()))
         {
-            string strCertData = jvProv["DeveloperCertificates"][i].asData();
-            BIO *bioCert = BIO_new_mem_buf(strCertData.c_str(), (int)strCertData.size());
-            if (NULL != bioCert)
-            {
-                x509Cert = d2i_X509_bio(bioCert, NULL);
-                if (NULL != x509Cert)
-                {
-                    if (X509_check_private_key(x509Cert, evpPKey))
-                    {
-                        break;
-                    }
-                    X509_free(x509Cert);
-                    x509Cert = NULL;
-                }
-                BIO_free(bioCert);
-            }
+            x509Cert.reset();
         }
     }
 
-    if (NULL == x509Cert)
+    if (!x509Cert)
     {
         ZLog::Error(">>> Can't Find Paired Certificate And PrivateKey!\n");
         return false;
     }
 
-    if (!GetCertSubjectCN(x509Cert, m_strSubjectCN))
+    if (!GetCertSubjectCN(x509Cert.get(), m_strSubjectCN))
     {
         ZLog::Error(">>> Can't Find Paired Certificate Subject Common Name!\n");
         return false;
     }
 
-    m_evpPKey = evpPKey;
-    m_x509Cert = x509Cert;
+    Free();
+    m_evpPKey = evpPKey.release();
+    m_x509Cert = x509Cert.release();
+    m_cmsTemplate.Init(m_x509Cert, m_evpPKey, _GetAppleCertChain(X509_issuer_name_hash((X509 *)m_x509Cert)));
+    return true;
+}
+
+bool ZSignAsset::InitAdhoc(const string &strEntitlementsFile)
+{ // no identity at all: code directories only, no team, no requirements and no CMS
+    Free();
+    m_bAdhoc = true;
+    m_strTeamId.clear();
+    m_strSubjectCN.clear();
+    m_strProvisionData.clear();
+    m_strEntitlementsData.clear();
+    if (!strEntitlementsFile.empty() && !ReadFile(strEntitlementsFile.c_str(), m_strEntitlementsData))
+    {
+        ZLog::ErrorV(">>> Can't Read Entitlements File! %s\n", strEntitlementsFile.c_str());
+        return false;
+    }
     return true;
 }
 
+void ZSignAsset::Free()
+{
+    m_cmsTemplate.Clear();
+    EVP_PKEY_free((EVP_PKEY *)m_evpPKey);
+    X509_free((X509 *)m_x509Cert);
+    m_evpPKey = NULL;
+    m_x509Cert = NULL;
+}
+
+uint32_t ZSignAsset::GetCMSLengthBound() const
+{ // 0 when unknown, CMS_sign output isn't sized up front
+    return m_bAdhoc ? 0 : (uint32_t)m_cmsTemplate.GetEncodedLengthBound();
+}
+
 bool ZSignAsset::GenerateCMS(const string &strCDHashData, const string &strCDHashesPlist,
                              const string &strCodeDirectorySlotSHA1, const string &strAltnateCodeDirectorySlot256,
                              string &strCMSOutput)
 {
+    if (m_bAdhoc)
+    {
+        return false;
+    }
+
+    if (m_cmsTemplate.IsReady())
+    {
+        return m_cmsTemplate.Encode(strCDHashData, strCDHashesPlist, strAltnateCodeDirectorySlot256, strCMSOutput);
+    }
     return ::_GenerateCMS((X509 *)m_x509Cert, (EVP_PKEY *)m_evpPKey, strCDHashData, strCDHashesPlist,
                           strCodeDirectorySlotSHA1, strAltnateCodeDirectorySlot256, strCMSOutput);
 }
@@ -8,6 +8,7 @@
  */
 
 #pragma once
+#include "cms.h"
 #include "common/json.h"
 
 bool GetCertSubjectCN(const string &strCertData, string &strSubjectCN);
@@ -16,25 +17,37 @@ bool GetCMSContent(const string &strCMSDataInput, string &strContentOutput);
 bool GenerateCMS(const string &strSignerCertData, const string &strSignerPKeyData, const string &strCDHashData,
                  const string &strCDHashesPlist, string &strCMSOutput);
 
+class ZSignRegistry;
+
 class ZSignAsset
 {
   public:
     ZSignAsset();
+    ~ZSignAsset();
 
   public:
     bool GenerateCMS(const string &strCDHashData, const string &strCDHashesPlist,
                      const string &strCodeDirectorySlotSHA1, const string &strAltnateCodeDirectorySlot256,
                      string &strCMSOutput);
     bool Init(const string &strSignerCertFile, const string &strSignerPKeyFile, const string &strProvisionFile,
-              const string &strEntitlementsFile, const string &strPassword);
+              const string &strEntitlementsFile, const string &strPassword, ZSignRegistry *pRegistry = NULL);
+    bool InitAdhoc(const string &strEntitlementsFile);
+    uint32_t GetCMSLengthBound() const;
 
   public:
+    bool m_bAdhoc;
     string m_strTeamId;
     string m_strSubjectCN;
     string m_strProvisionData;
     string m_strEntitlementsData;
 
+  private:
+    ZSignAsset(const ZSignAsset &);
+    ZSignAsset &operator=(const ZSignAsset &);
+    void Free();
+
   private:
     void *m_evpPKey;
     void *m_x509Cert;
+    ZCMSTemplate m_cmsTemplate;
 };
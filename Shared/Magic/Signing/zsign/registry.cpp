@@ -0,0 +1,252 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#include "registry.h"
+#include "openssl.h"
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#define REGISTRY_VERSION 1
+#define REGISTRY_SEEN_INTERVAL (24 * 3600)
+#define REGISTRY_MAX_IDLE (30 * 24 * 3600)
+
+bool GetCertSubjectCN(X509 *cert, string &strSubjectCN);
+
+static int64_t _GetCertExpiry(X509 *x509Cert)
+{
+    struct tm tmTime = {0};
+    const ASN1_TIME *pNotAfter = X509_get0_notAfter(x509Cert);
+    if (NULL == pNotAfter || 1 != ASN1_TIME_to_tm(pNotAfter, &tmTime))
+    {
+        return 0;
+    }
+    return (int64_t)timegm(&tmTime);
+}
+
+static string _GetCertFP(X509 *x509Cert)
+{
+    string strFP;
+    unsigned char *pDER = NULL;
+    int nDER = i2d_X509(x509Cert, &pDER);
+    if (nDER > 0)
+    {
+        SHA1Text(string((const char *)pDER, nDER), strFP);
+        OPENSSL_free(pDER);
+    }
+    return strFP;
+}
+
+ZSignRegistry::ZSignRegistry() { m_bDirty = false; }
+
+string ZSignRegistry::GetPublicKeyFP(void *pEVPPKey)
+{
+    string strFP;
+    unsigned char *pDER = NULL;
+    int nDER = (NULL != pEVPPKey) ? i2d_PUBKEY((EVP_PKEY *)pEVPPKey, &pDER) : 0;
+    if (nDER > 0)
+    {
+        SHA1Text(string((const char *)pDER, nDER), strFP);
+        OPENSSL_free(pDER);
+    }
+    return strFP;
+}
+
+bool ZSignRegistry::Load(const char *szCacheFile)
+{
+    m_strCacheFile = szCacheFile;
+    m_jvRoot.clear();
+    m_mapPairs.clear();
+    m_bDirty = false;
+
+    if (!m_jvRoot.readFile(szCacheFile) || REGISTRY_VERSION != m_jvRoot["version"].asInt())
+    { // missing or written by another layout, rebuilt on demand
+        m_jvRoot.clear();
+        m_jvRoot["version"] = REGISTRY_VERSION;
+        return false;
+    }
+
+    vector<string> arrKeys;
+    m_jvRoot["profiles"].keys(arrKeys);
+    for (size_t i = 0; i < arrKeys.size(); i++)
+    {
+        IndexProfile(arrKeys[i], m_jvRoot["profiles"][arrKeys[i]]);
+    }
+    if (m_jvRoot.has("identities"))
+    { // no longer kept, pairing goes through the profile certificates
+        m_jvRoot.remove("identities");
+        m_bDirty = true;
+    }
+    ZLog::DebugV(">>> Registry: \t%lu profiles\n", arrKeys.size());
+    return true;
+}
+
+bool ZSignRegistry::Save()
+{
+    if (m_strCacheFile.empty())
+    {
+        return true;
+    }
+
+    if (PruneStale("profiles") > 0)
+    { // pairs point into the profile list by index
+        m_mapPairs.clear();
+        vector<string> arrKeys;
+        m_jvRoot["profiles"].keys(arrKeys);
+        for (size_t i = 0; i < arrKeys.size(); i++)
+        {
+            IndexProfile(arrKeys[i], m_jvRoot["profiles"][arrKeys[i]]);
+        }
+    }
+
+    if (!m_bDirty)
+    {
+        return true;
+    }
+
+    string strData;
+    m_jvRoot.write(strData);
+    if (!WriteFile(m_strCacheFile.c_str(), strData))
+    {
+        ZLog::WarnV(">>> Can't Write Registry Cache! %s\n", m_strCacheFile.c_str());
+        return false;
+    }
+    m_bDirty = false;
+    return true;
+}
+
+void ZSignRegistry::TouchEntry(JValue &jvEntry)
+{ // at most once a day, a warm cache isn't rewritten on every run
+    int64_t nNow = (int64_t)time(NULL);
+    if (nNow - jvEntry["seen"].asInt64() >= REGISTRY_SEEN_INTERVAL)
+    {
+        jvEntry["seen"] = nNow;
+        m_bDirty = true;
+    }
+}
+
+size_t ZSignRegistry::PruneStale(const char *szSection)
+{
+    int64_t nNow = (int64_t)time(NULL);
+    vector<string> arrKeys;
+    m_jvRoot[szSection].keys(arrKeys);
+
+    size_t uPruned = 0;
+    for (size_t i = 0; i < arrKeys.size(); i++)
+    {
+        const JValue &jvEntry = m_jvRoot[szSection][arrKeys[i]];
+        int64_t nExpires = jvEntry["expires"].asInt64();
+        if ((nExpires > 0 && nExpires < nNow) || nNow - jvEntry["seen"].asInt64() > REGISTRY_MAX_IDLE)
+        {
+            m_jvRoot[szSection].remove(arrKeys[i]);
+            uPruned++;
+        }
+    }
+
+    if (uPruned > 0)
+    {
+        ZLog::DebugV(">>> Registry: \tpruned %lu stale %s\n", uPruned, szSection);
+        m_bDirty = true;
+    }
+    return uPruned;
+}
+
+void ZSignRegistry::IndexProfile(const string &strProfileKey, const JValue &jvProfile)
+{
+    const JValue &jvCerts = jvProfile["certs"];
+    for (size_t i = 0; i < jvCerts.size(); i++)
+    {
+        m_mapPairs[strProfileKey + ":" + jvCerts[i]["pubkey"].asString()] = i;
+    }
+}
+
+bool ZSignRegistry::ParseProfile(const string &strProvisionData, JValue &jvProfile)
+{
+    JValue jvProv;
+    string strProvContent;
+    if (!GetCMSContent(strProvisionData, strProvContent) || !jvProv.readPList(strProvContent))
+    {
+        return false;
+    }
+
+    jvProfile["name"] = jvProv["Name"].asString();
+    jvProfile["uuid"] = jvProv["UUID"].asString();
+    jvProfile["team"] = jvProv["TeamIdentifier"][0].asString();
+    jvProfile["team_name"] = jvProv["TeamName"].asString();
+    jvProfile["appid"] = jvProv["Entitlements"]["application-identifier"].asString();
+    jvProfile["created"] = (int64_t)jvProv["CreationDate"].asDate();
+    jvProfile["expires"] = (int64_t)jvProv["ExpirationDate"].asDate();
+
+    string strEntitlements;
+    jvProv["Entitlements"].writePList(strEntitlements);
+    jvProfile["entitlements"] = strEntitlements;
+
+    for (size_t i = 0; i < jvProv["DeveloperCertificates"].size(); i++)
+    {
+        string strCertData = jvProv["DeveloperCertificates"][i].asData();
+        const unsigned char *pDER = (const unsigned char *)strCertData.data();
+        X509 *x509Cert = d2i_X509(NULL, &pDER, (long)strCertData.size());
+        if (NULL == x509Cert)
+        {
+            continue;
+        }
+
+        JValue jvCert;
+        string strSubjectCN;
+        GetCertSubjectCN(x509Cert, strSubjectCN);
+        jvCert["sha1"] = _GetCertFP(x509Cert);
+        jvCert["pubkey"] = GetPublicKeyFP(X509_get0_pubkey(x509Cert));
+        jvCert["cn"] = strSubjectCN;
+        jvCert["expires"] = _GetCertExpiry(x509Cert);
+        jvCert["der"].assignData(strCertData.data(), strCertData.size());
+        jvProfile["certs"].push_back(std::move(jvCert));
+        X509_free(x509Cert);
+    }
+    return !jvProfile["team"].asString().empty();
+}
+
+bool ZSignRegistry::GetProfile(const string &strProvisionData, JValue &jvProfile)
+{
+    string strProfileKey;
+    SHA1Text(strProvisionData, strProfileKey);
+    if (m_jvRoot["profiles"].has(strProfileKey.c_str()))
+    {
+        TouchEntry(m_jvRoot["profiles"][strProfileKey]);
+        jvProfile = m_jvRoot["profiles"][strProfileKey];
+        return true;
+    }
+
+    JValue jvNewProfile;
+    jvNewProfile["key"] = strProfileKey;
+    if (!ParseProfile(strProvisionData, jvNewProfile))
+    {
+        return false;
+    }
+
+    jvNewProfile["seen"] = (int64_t)time(NULL);
+    m_jvRoot["profiles"][strProfileKey] = jvNewProfile;
+    IndexProfile(strProfileKey, jvNewProfile);
+    m_bDirty = true;
+    jvProfile = jvNewProfile;
+    return true;
+}
+
+bool ZSignRegistry::FindPairedCert(const string &strProfileKey, const string &strPubKeyFP, string &strCertData) const
+{
+    map<string, size_t>::const_iterator it = m_mapPairs.find(strProfileKey + ":" + strPubKeyFP);
+    if (m_mapPairs.end() == it)
+    {
+        return false;
+    }
+    strCertData = m_jvRoot["profiles"][strProfileKey]["certs"][it->second]["der"].asData();
+    return !strCertData.empty();
+}
@@ -0,0 +1,49 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#pragma once
+#include "common/common.h"
+#include "common/json.h"
+
+/**
+ * Index of imported provisioning profiles, keyed by the SHA-1 of the profile data.
+ * A profile's CMS envelope, plist and developer certificates are decoded once and kept in a JSON cache,
+ * so later launches get the team id, entitlements, expiry and key/cert pairing from a map lookup.
+ * Entries that expired or went unused for a month are dropped when the cache is saved.
+ */
+class ZSignRegistry
+{
+  public:
+    ZSignRegistry();
+
+  public:
+    bool Load(const char *szCacheFile);
+    bool Save();
+
+    bool GetProfile(const string &strProvisionData, JValue &jvProfile);
+    bool FindPairedCert(const string &strProfileKey, const string &strPubKeyFP, string &strCertData) const;
+
+  public:
+    static string GetPublicKeyFP(void *pEVPPKey);
+
+  private:
+    bool ParseProfile(const string &strProvisionData, JValue &jvProfile);
+    void IndexProfile(const string &strProfileKey, const JValue &jvProfile);
+    void TouchEntry(JValue &jvEntry);
+    size_t PruneStale(const char *szSection);
+
+  private:
+    string m_strCacheFile;
+    JValue m_jvRoot;
+    bool m_bDirty;
+    map<string, size_t> m_mapPairs;
+};
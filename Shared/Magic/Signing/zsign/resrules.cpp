@@ -0,0 +1,568 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#include "resrules.h"
+
+#include <ctype.h>
+
+#include <algorithm>
+
+#define RULES_SYMBOL_EOS 256
+#define RULES_MAX_DSTATES 4096
+#define RULES_NO_MATCH INT_MAX
+
+enum
+{
+    E_NS_CHAR = 1,
+    E_NS_SPLIT = 2,
+    E_NS_EOS = 3,
+    E_NS_ACCEPT = 4,
+};
+
+ZResourceRules::ZResourceRules()
+{
+    m_nMark = 0;
+    m_bHasFallback = false;
+}
+
+ZResourceRules::~ZResourceRules() { Clear(); }
+
+void ZResourceRules::Clear()
+{
+    for (size_t i = 0; i < m_arrRules.size(); i++)
+    {
+        if (NULL != m_arrRules[i].pRegex)
+        {
+            regfree(m_arrRules[i].pRegex);
+            delete m_arrRules[i].pRegex;
+        }
+    }
+    m_arrRules.clear();
+    m_arrNStates.clear();
+    m_arrClasses.clear();
+    m_arrDStates.clear();
+    m_mapDStates.clear();
+    m_arrStarts.clear();
+    m_arrMarks.clear();
+    m_nMark = 0;
+    m_bHasFallback = false;
+}
+
+size_t ZResourceRules::GetRuleCount() const { return m_arrRules.size(); }
+
+void ZResourceRules::GetDefaultRules(JValue &jvRules)
+{
+    jvRules["^.*"] = true;
+    jvRules["^.*\\.lproj/"]["optional"] = true;
+    jvRules["^.*\\.lproj/"]["weight"] = 1000.0;
+    jvRules["^.*\\.lproj/locversion.plist$"]["omit"] = true;
+    jvRules["^.*\\.lproj/locversion.plist$"]["weight"] = 1100.0;
+    jvRules["^Base\\.lproj/"]["weight"] = 1010.0;
+    jvRules["^version.plist$"] = true;
+}
+
+void ZResourceRules::GetDefaultRules2(JValue &jvRules2)
+{
+    jvRules2["^.*"] = true;
+    jvRules2[".*\\.dSYM($|/)"]["weight"] = 11.0;
+    jvRules2["^(Frameworks|SharedFrameworks|PlugIns|Plug-ins|XPCServices|Helpers|MacOS|Library/"
+             "(Automator|Spotlight|LoginItems))/"]["nested"] = true;
+    jvRules2["^(Frameworks|SharedFrameworks|PlugIns|Plug-ins|XPCServices|Helpers|MacOS|Library/"
+             "(Automator|Spotlight|LoginItems))/"]["weight"] = 10.0;
+    jvRules2["^(.*/)?\\.DS_Store$"]["omit"] = true;
+    jvRules2["^(.*/)?\\.DS_Store$"]["weight"] = 2000.0;
+    jvRules2["^.*\\.lproj/"]["optional"] = true;
+    jvRules2["^.*\\.lproj/"]["weight"] = 1000.0;
+    jvRules2["^.*\\.lproj/locversion.plist$"]["omit"] = true;
+    jvRules2["^.*\\.lproj/locversion.plist$"]["weight"] = 1100.0;
+    jvRules2["^Base\\.lproj/"]["weight"] = 1010.0;
+    jvRules2["^Info\\.plist$"]["omit"] = true;
+    jvRules2["^Info\\.plist$"]["weight"] = 20.0;
+    jvRules2["^PkgInfo$"]["omit"] = true;
+    jvRules2["^PkgInfo$"]["weight"] = 20.0;
+    jvRules2["^embedded\\.provisionprofile$"]["weight"] = 20.0;
+    jvRules2["^version\\.plist$"]["weight"] = 20.0;
+}
+
+static bool _RuleWeightGreater(const pair<double, size_t> &a, const pair<double, size_t> &b)
+{
+    return (a.first > b.first);
+}
+
+bool ZResourceRules::Compile(const JValue &jvRules)
+{
+    Clear();
+    if (!jvRules.isObject())
+    {
+        return false;
+    }
+
+    vector<string> arrKeys;
+    jvRules.keys(arrKeys);
+
+    vector<Rule> arrRules;
+    vector<pair<double, size_t>> arrOrder;
+    for (size_t i = 0; i < arrKeys.size(); i++)
+    {
+        const JValue &jvRule = jvRules[arrKeys[i]];
+
+        Rule rule;
+        rule.strPattern = arrKeys[i];
+        rule.fWeight = 1.0;
+        rule.uFlags = 0;
+        rule.pRegex = NULL;
+        if (jvRule.isObject())
+        {
+            rule.uFlags |= jvRule["omit"].asBool() ? E_RULE_OMIT : 0;
+            rule.uFlags |= jvRule["optional"].asBool() ? E_RULE_OPTIONAL : 0;
+            rule.uFlags |= jvRule["nested"].asBool() ? E_RULE_NESTED : 0;
+            if (jvRule.has("weight"))
+            {
+                rule.fWeight = jvRule["weight"].asFloat();
+            }
+        }
+        else if (!jvRule.asBool())
+        {
+            continue;
+        }
+
+        arrOrder.push_back(pair<double, size_t>(rule.fWeight, arrRules.size()));
+        arrRules.push_back(rule);
+    }
+
+    // index order is priority order, so the lowest matching index wins
+    stable_sort(arrOrder.begin(), arrOrder.end(), _RuleWeightGreater);
+
+    m_arrClasses.push_back(vector<bool>(256, true)); // class 0 matches any byte
+    for (size_t i = 0; i < arrOrder.size(); i++)
+    {
+        Rule &rule = arrRules[arrOrder[i].second];
+
+        int nStart = -1;
+        if (ParsePattern(rule.strPattern, (int)m_arrRules.size(), nStart))
+        {
+            m_arrStarts.push_back(nStart);
+        }
+        else
+        {
+            rule.pRegex = new regex_t;
+            if (0 != regcomp(rule.pRegex, rule.strPattern.c_str(), REG_EXTENDED | REG_NOSUB))
+            {
+                ZLog::WarnV(">>> Ignore Invalid CodeResources Rule! %s\n", rule.strPattern.c_str());
+                delete rule.pRegex;
+                continue;
+            }
+            m_bHasFallback = true;
+        }
+        m_arrRules.push_back(rule);
+    }
+
+    if (!m_arrStarts.empty())
+    { // dstate 0 is the start state
+        m_arrMarks.resize(m_arrNStates.size(), 0);
+        vector<int> arrStates;
+        vector<int> arrStack;
+        m_nMark++;
+        for (size_t i = 0; i < m_arrStarts.size(); i++)
+        {
+            AddClosure(m_arrStarts[i], arrStates, arrStack);
+        }
+        GetDState(arrStates);
+    }
+
+    return !m_arrRules.empty();
+}
+
+bool ZResourceRules::Match(const char *szPath, uint32_t &uFlags)
+{
+    int nBest = RULES_NO_MATCH;
+    if (!m_arrDStates.empty())
+    {
+        if (m_arrDStates.size() > RULES_MAX_DSTATES)
+        { // drop everything but the start state
+            m_arrDStates.resize(1);
+            m_mapDStates.clear();
+            m_mapDStates[m_arrDStates[0].arrStates] = 0;
+            for (int i = 0; i <= RULES_SYMBOL_EOS; i++)
+            {
+                m_arrDStates[0].arrNext[i] = -2;
+            }
+        }
+
+        int nDState = 0;
+        nBest = m_arrDStates[nDState].nBest;
+        for (const uint8_t *p = (const uint8_t *)szPath; nDState >= 0 && nBest > 0; p++)
+        {
+            nDState = Step(nDState, (0 != *p) ? *p : RULES_SYMBOL_EOS);
+            if (nDState >= 0)
+            {
+                nBest = min(nBest, m_arrDStates[nDState].nBest);
+            }
+            if (0 == *p)
+            {
+                break;
+            }
+        }
+    }
+
+    if (m_bHasFallback)
+    {
+        for (int i = 0; i < nBest && i < (int)m_arrRules.size(); i++)
+        {
+            if (NULL != m_arrRules[i].pRegex && 0 == regexec(m_arrRules[i].pRegex, szPath, 0, NULL, 0))
+            {
+                nBest = i;
+                break;
+            }
+        }
+    }
+
+    if (RULES_NO_MATCH == nBest)
+    {
+        return false;
+    }
+
+    uFlags = m_arrRules[nBest].uFlags;
+    return true;
+}
+
+int ZResourceRules::AddState(int nType, int nClass, int nOut1, int nOut2)
+{
+    NState state;
+    state.nType = nType;
+    state.nClass = nClass;
+    state.nOut1 = nOut1;
+    state.nOut2 = nOut2;
+    m_arrNStates.push_back(state);
+    return (int)m_arrNStates.size() - 1;
+}
+
+void ZResourceRules::Patch(const Fragment &frag, int nState)
+{
+    for (size_t i = 0; i < frag.arrOuts.size(); i++)
+    {
+        NState &state = m_arrNStates[frag.arrOuts[i].first];
+        if (1 == frag.arrOuts[i].second)
+        {
+            state.nOut1 = nState;
+        }
+        else
+        {
+            state.nOut2 = nState;
+        }
+    }
+}
+
+bool ZResourceRules::ParsePattern(const string &strPattern, int nRule, int &nStart)
+{
+    const char *p = strPattern.c_str();
+    bool bAnchored = ('^' == *p);
+    if (bAnchored)
+    {
+        p++;
+    }
+
+    Fragment frag;
+    if (!ParseAlt(p, frag) || 0 != *p)
+    {
+        return false;
+    }
+
+    Patch(frag, AddState(E_NS_ACCEPT, nRule));
+    nStart = frag.nStart;
+    if (!bAnchored)
+    { // unanchored search, skip any prefix
+        int nAny = AddState(E_NS_CHAR, 0);
+        nStart = AddState(E_NS_SPLIT, -1, nAny, frag.nStart);
+        m_arrNStates[nAny].nOut1 = nStart;
+    }
+    return true;
+}
+
+bool ZResourceRules::ParseAlt(const char *&p, Fragment &frag)
+{
+    if (!ParseConcat(p, frag))
+    {
+        return false;
+    }
+
+    while ('|' == *p)
+    {
+        p++;
+        Fragment next;
+        if (!ParseConcat(p, next))
+        {
+            return false;
+        }
+        frag.nStart = AddState(E_NS_SPLIT, -1, frag.nStart, next.nStart);
+        frag.arrOuts.insert(frag.arrOuts.end(), next.arrOuts.begin(), next.arrOuts.end());
+    }
+    return true;
+}
+
+bool ZResourceRules::ParseConcat(const char *&p, Fragment &frag)
+{
+    if (0 == *p || '|' == *p || ')' == *p)
+    { // empty branch
+        frag.nStart = AddState(E_NS_SPLIT);
+        frag.arrOuts.assign(1, pair<int, int>(frag.nStart, 1));
+        return true;
+    }
+
+    if (!ParseRepeat(p, frag))
+    {
+        return false;
+    }
+
+    while (0 != *p && '|' != *p && ')' != *p)
+    {
+        Fragment next;
+        if (!ParseRepeat(p, next))
+        {
+            return false;
+        }
+        Patch(frag, next.nStart);
+        frag.arrOuts.swap(next.arrOuts);
+    }
+    return true;
+}
+
+bool ZResourceRules::ParseRepeat(const char *&p, Fragment &frag)
+{
+    if (!ParseAtom(p, frag))
+    {
+        return false;
+    }
+
+    while ('*' == *p || '+' == *p || '?' == *p)
+    {
+        int nSplit = AddState(E_NS_SPLIT, -1, frag.nStart);
+        if ('*' == *p)
+        {
+            Patch(frag, nSplit);
+            frag.nStart = nSplit;
+            frag.arrOuts.assign(1, pair<int, int>(nSplit, 2));
+        }
+        else if ('+' == *p)
+        {
+            Patch(frag, nSplit);
+            frag.arrOuts.assign(1, pair<int, int>(nSplit, 2));
+        }
+        else
+        {
+            frag.nStart = nSplit;
+            frag.arrOuts.push_back(pair<int, int>(nSplit, 2));
+        }
+        p++;
+    }
+    return ('{' != *p); // bounded repeats are left to regcomp
+}
+
+bool ZResourceRules::ParseAtom(const char *&p, Fragment &frag)
+{
+    int nState = -1;
+    switch (*p)
+    {
+        case '(':
+        {
+            p++;
+            if (!ParseAlt(p, frag) || ')' != *p)
+            {
+                return false;
+            }
+            p++;
+            return true;
+        }
+        case '[':
+        {
+            p++;
+            vector<bool> arrClass(256, false);
+            if (!ParseClass(p, arrClass))
+            {
+                return false;
+            }
+            m_arrClasses.push_back(arrClass);
+            nState = AddState(E_NS_CHAR, (int)m_arrClasses.size() - 1);
+        }
+        break;
+        case '.':
+        {
+            p++;
+            nState = AddState(E_NS_CHAR, 0);
+        }
+        break;
+        case '$':
+        {
+            p++;
+            nState = AddState(E_NS_EOS);
+        }
+        break;
+        case '\\':
+        case '^':
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+        case 0:
+        {
+            if ('\\' != *p || 0 == p[1] || isalnum((uint8_t)p[1]))
+            {
+                return false;
+            }
+            p++;
+        }
+        // fall through
+        default:
+        {
+            vector<bool> arrClass(256, false);
+            arrClass[(uint8_t)*p++] = true;
+            m_arrClasses.push_back(arrClass);
+            nState = AddState(E_NS_CHAR, (int)m_arrClasses.size() - 1);
+        }
+        break;
+    }
+
+    frag.nStart = nState;
+    frag.arrOuts.assign(1, pair<int, int>(nState, 1));
+    return true;
+}
+
+bool ZResourceRules::ParseClass(const char *&p, vector<bool> &arrClass)
+{
+    bool bNegate = ('^' == *p);
+    if (bNegate)
+    {
+        p++;
+    }
+
+    bool bFirst = true;
+    while (0 != *p && (']' != *p || bFirst))
+    {
+        if ('[' == *p && (':' == p[1] || '.' == p[1] || '=' == p[1]))
+        { // named classes are left to regcomp
+            return false;
+        }
+
+        uint8_t uFrom = (uint8_t)*p++;
+        uint8_t uTo = uFrom;
+        if ('-' == p[0] && 0 != p[1] && ']' != p[1])
+        {
+            uTo = (uint8_t)p[1];
+            p += 2;
+        }
+        for (int c = uFrom; c <= uTo; c++)
+        {
+            arrClass[c] = true;
+        }
+        bFirst = false;
+    }
+
+    if (']' != *p)
+    {
+        return false;
+    }
+    p++;
+
+    if (bNegate)
+    {
+        arrClass.flip();
+    }
+    arrClass[0] = false;
+    return true;
+}
+
+void ZResourceRules::AddClosure(int nState, vector<int> &arrStates, vector<int> &arrStack)
+{
+    arrStack.push_back(nState);
+    while (!arrStack.empty())
+    {
+        int nCur = arrStack.back();
+        arrStack.pop_back();
+        if (nCur < 0 || m_nMark == m_arrMarks[nCur])
+        {
+            continue;
+        }
+        m_arrMarks[nCur] = m_nMark;
+
+        const NState &state = m_arrNStates[nCur];
+        if (E_NS_SPLIT == state.nType)
+        {
+            arrStack.push_back(state.nOut2);
+            arrStack.push_back(state.nOut1);
+        }
+        else
+        {
+            arrStates.push_back(nCur);
+        }
+    }
+}
+
+int ZResourceRules::GetDState(vector<int> &arrStates)
+{
+    sort(arrStates.begin(), arrStates.end());
+    map<vector<int>, int>::iterator it = m_mapDStates.find(arrStates);
+    if (it != m_mapDStates.end())
+    {
+        return it->second;
+    }
+
+    DState dstate;
+    dstate.arrStates = arrStates;
+    dstate.nBest = RULES_NO_MATCH;
+    for (size_t i = 0; i < arrStates.size(); i++)
+    {
+        const NState &state = m_arrNStates[arrStates[i]];
+        if (E_NS_ACCEPT == state.nType)
+        {
+            dstate.nBest = min(dstate.nBest, state.nClass);
+        }
+    }
+    for (int i = 0; i <= RULES_SYMBOL_EOS; i++)
+    {
+        dstate.arrNext[i] = -2;
+    }
+
+    m_arrDStates.push_back(dstate);
+    int nDState = (int)m_arrDStates.size() - 1;
+    m_mapDStates[arrStates] = nDState;
+    return nDState;
+}
+
+int ZResourceRules::Step(int nDState, int nSymbol)
+{
+    int nNext = m_arrDStates[nDState].arrNext[nSymbol];
+    if (-2 != nNext)
+    {
+        return nNext;
+    }
+
+    vector<int> arrStates;
+    vector<int> arrStack;
+    m_nMark++;
+    const vector<int> &arrCurrent = m_arrDStates[nDState].arrStates;
+    for (size_t i = 0; i < arrCurrent.size(); i++)
+    {
+        const NState &state = m_arrNStates[arrCurrent[i]];
+        if (E_NS_CHAR == state.nType && RULES_SYMBOL_EOS != nSymbol && m_arrClasses[state.nClass][nSymbol])
+        {
+            AddClosure(state.nOut1, arrStates, arrStack);
+        }
+        else if (E_NS_EOS == state.nType && RULES_SYMBOL_EOS == nSymbol)
+        {
+            AddClosure(state.nOut1, arrStates, arrStack);
+        }
+    }
+
+    nNext = arrStates.empty() ? -1 : GetDState(arrStates);
+    m_arrDStates[nDState].arrNext[nSymbol] = nNext;
+    return nNext;
+}
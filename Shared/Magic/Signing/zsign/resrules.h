@@ -0,0 +1,102 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#pragma once
+#include <regex.h>
+
+#include "common/common.h"
+#include "common/json.h"
+
+/**
+ * Compiled form of a CodeResources "rules"/"rules2" dictionary.
+ * All patterns are merged into one lazily built DFA, so each path is classified in a single pass
+ * no matter how many rules there are. Patterns the DFA can't express fall back to regcomp.
+ */
+class ZResourceRules
+{
+  public:
+    enum
+    {
+        E_RULE_OMIT = 1,
+        E_RULE_OPTIONAL = 2,
+        E_RULE_NESTED = 4,
+    };
+
+  public:
+    ZResourceRules();
+    ~ZResourceRules();
+
+  public:
+    bool Compile(const JValue &jvRules);
+    bool Match(const char *szPath, uint32_t &uFlags);
+    size_t GetRuleCount() const;
+    void Clear();
+
+  public:
+    static void GetDefaultRules(JValue &jvRules);
+    static void GetDefaultRules2(JValue &jvRules2);
+
+  private:
+    struct Rule
+    {
+        string strPattern;
+        double fWeight;
+        uint32_t uFlags;
+        regex_t *pRegex;
+    };
+
+    struct NState
+    {
+        int nType;
+        int nClass;
+        int nOut1;
+        int nOut2;
+    };
+
+    struct DState
+    {
+        vector<int> arrStates;
+        int nBest;
+        int arrNext[257];
+    };
+
+    struct Fragment
+    {
+        int nStart;
+        vector<pair<int, int>> arrOuts;
+    };
+
+  private:
+    int AddState(int nType, int nClass = -1, int nOut1 = -1, int nOut2 = -1);
+    void Patch(const Fragment &frag, int nState);
+    bool ParsePattern(const string &strPattern, int nRule, int &nStart);
+    bool ParseAlt(const char *&p, Fragment &frag);
+    bool ParseConcat(const char *&p, Fragment &frag);
+    bool ParseRepeat(const char *&p, Fragment &frag);
+    bool ParseAtom(const char *&p, Fragment &frag);
+    bool ParseClass(const char *&p, vector<bool> &arrClass);
+
+    void AddClosure(int nState, vector<int> &arrStates, vector<int> &arrStack);
+    int GetDState(vector<int> &arrStates);
+    int Step(int nDState, int nSymbol);
+
+  private:
+    vector<Rule> m_arrRules;
+    vector<NState> m_arrNStates;
+    vector<vector<bool>> m_arrClasses;
+    vector<DState> m_arrDStates;
+    map<vector<int>, int> m_mapDStates;
+    vector<int> m_arrStarts;
+    vector<int> m_arrMarks;
+    int m_nMark;
+    bool m_bHasFallback;
+};
@@ -175,7 +175,7 @@ bool SlotBuildRequirements(const string &strBundleID, const string &strSubjectCN
     strOutput.clear();
     if (strBundleID.empty() || strSubjectCN.empty())
     { // ldid
-        strOutput = "\xfa\xde\x0c\x01\x00\x00\x00\x0c\x00\x00\x00\x00";
+        strOutput.assign("\xfa\xde\x0c\x01\x00\x00\x00\x0c\x00\x00\x00\x00", 12);
         return true;
     }
 
@@ -235,6 +235,35 @@ bool SlotBuildRequirements(const string &strBundleID, const string &strSubjectCN
     return true;
 }
 
+bool GetRequirementsText(const string &strBundleID, const string &strSubjectCN, const string &strCDHash,
+                         string &strOutput)
+{
+    strOutput.clear();
+    if (strBundleID.empty() || strSubjectCN.empty())
+    { // same as the empty requirements slot, pin the cdhash
+        if (strCDHash.empty())
+        {
+            return false;
+        }
+
+        strOutput = "cdhash H\"";
+        for (size_t i = 0; i < strCDHash.size(); i++)
+        {
+            char szHex[4] = {0};
+            snprintf(szHex, sizeof(szHex), "%02x", (uint8_t)strCDHash[i]);
+            strOutput += szHex;
+        }
+        strOutput += "\"";
+        return true;
+    }
+
+    StringFormat(strOutput,
+                 "identifier \"%s\" and anchor apple generic and certificate leaf[subject.CN] = \"%s\" and "
+                 "certificate 1[field.1.2.840.113635.100.6.2.1] /* exists */",
+                 strBundleID.c_str(), strSubjectCN.c_str());
+    return true;
+}
+
 bool SlotParseEntitlements(uint8_t *pSlotBase, CS_BlobIndex *pbi)
 {
     uint32_t uSlotLength = SlotParseGeneralHeader("CSSLOT_ENTITLEMENTS", pSlotBase, pbi);
@@ -371,7 +400,7 @@ bool SlotParseCodeDirectory(uint8_t *pSlotBase, CS_BlobIndex *pbi)
     }
 
     ZLog::PrintV("\tidentifier: \t%s\n", pSlotBase + LE(cdHeader.identOffset));
-    if (uVersion >= 0x20200)
+    if (uVersion >= 0x20200 && cdHeader.teamOffset > 0)
     {
         ZLog::PrintV("\tteamid: \t%s\n", pSlotBase + LE(cdHeader.teamOffset));
     }
@@ -434,15 +463,15 @@ bool SlotParseCodeDirectory(uint8_t *pSlotBase, CS_BlobIndex *pbi)
     return true;
 }
 
-bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint32_t uCodeLength, uint8_t *pCodeSlotsData,
+bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint64_t uCodeLength, uint8_t *pCodeSlotsData,
                             uint32_t uCodeSlotsDataLength, uint64_t execSegLimit, uint64_t execSegFlags,
-                            const string &strBundleId, const string &strTeamId, const string &strInfoPlistSHA,
-                            const string &strRequirementsSlotSHA, const string &strCodeResourcesSHA,
-                            const string &strEntitlementsSlotSHA, const string &strDerEntitlementsSlotSHA,
-                            bool isExecuteArch, string &strOutput)
+                            uint32_t uFlags, uint32_t uPageSize, const string &strBundleId, const string &strTeamId,
+                            const string &strInfoPlistSHA, const string &strRequirementsSlotSHA,
+                            const string &strCodeResourcesSHA, const string &strEntitlementsSlotSHA,
+                            const string &strDerEntitlementsSlotSHA, bool isExecuteArch, string &strOutput)
 {
     strOutput.clear();
-    if (NULL == pCodeBase || uCodeLength <= 0 || strBundleId.empty() || strTeamId.empty())
+    if (NULL == pCodeBase || uCodeLength <= 0 || strBundleId.empty())
     {
         return false;
     }
@@ -454,16 +483,28 @@ bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint32_t uCodeL
     cdHeader.magic = BE(CSMAGIC_CODEDIRECTORY);
     cdHeader.length = 0;
     cdHeader.version = BE(uVersion);
-    cdHeader.flags = 0;
+    cdHeader.flags = BE(uFlags);
     cdHeader.hashOffset = 0;
     cdHeader.identOffset = 0;
     cdHeader.nSpecialSlots = 0;
     cdHeader.nCodeSlots = 0;
-    cdHeader.codeLimit = BE(uCodeLength);
+    if (uCodeLength > UINT32_MAX)
+    { // past 4 GiB the 32-bit limit saturates and codeLimit64 carries the real one
+        cdHeader.codeLimit = BE((uint32_t)UINT32_MAX);
+        cdHeader.codeLimit64 = BE(uCodeLength);
+    }
+    else
+    {
+        cdHeader.codeLimit = BE((uint32_t)uCodeLength);
+    }
     cdHeader.hashSize = bAlternate ? 32 : 20;
     cdHeader.hashType = bAlternate ? 2 : 1;
     cdHeader.spare1 = 0;
     cdHeader.pageSize = 12;
+    while ((1u << cdHeader.pageSize) < uPageSize && cdHeader.pageSize < 16)
+    { // log2 of the page size, 4 KiB at least
+        cdHeader.pageSize++;
+    }
     cdHeader.spare2 = 0;
     cdHeader.scatterOffset = 0;
     cdHeader.teamOffset = 0;
@@ -486,9 +527,9 @@ bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint32_t uCodeL
     arrSpecialSlots.push_back(strRequirementsSlotSHA.empty() ? strEmptySHA : strRequirementsSlotSHA);
     arrSpecialSlots.push_back(strInfoPlistSHA.empty() ? strEmptySHA : strInfoPlistSHA);
 
-    uint32_t uPageSize = (uint32_t)pow(2, cdHeader.pageSize);
-    uint32_t uPages = uCodeLength / uPageSize;
-    uint32_t uRemain = uCodeLength % uPageSize;
+    uPageSize = 1u << cdHeader.pageSize;
+    uint32_t uPages = (uint32_t)(uCodeLength / uPageSize);
+    uint32_t uRemain = (uint32_t)(uCodeLength % uPageSize);
     uint32_t uCodeSlots = uPages + (uRemain > 0 ? 1 : 0);
 
     uint32_t uHeaderLength = 44;
@@ -513,7 +554,7 @@ bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint32_t uCodeL
     }
 
     uint32_t uBundleIDLength = strBundleId.size() + 1;
-    uint32_t uTeamIDLength = strTeamId.size() + 1;
+    uint32_t uTeamIDLength = strTeamId.empty() ? 0 : (uint32_t)strTeamId.size() + 1; // ad-hoc has no team
     uint32_t uSpecialSlotsLength = arrSpecialSlots.size() * cdHeader.hashSize;
     uint32_t uCodeSlotsLength = uCodeSlots * cdHeader.hashSize;
 
@@ -540,7 +581,7 @@ bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint32_t uCodeL
     // Version is always 0x20400, so this check is always true
     {
         uHashOffset += uTeamIDLength;
-        cdHeader.teamOffset = BE(uHeaderLength + uBundleIDLength);
+        cdHeader.teamOffset = (uTeamIDLength > 0) ? BE(uHeaderLength + uBundleIDLength) : 0;
     }
     cdHeader.hashOffset = BE(uHashOffset);
 
@@ -550,7 +591,7 @@ bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint32_t uCodeL
     {
         // todo
     }
-    if (uVersion >= 0x20200)
+    if (uVersion >= 0x20200 && uTeamIDLength > 0)
     {
         strOutput.append(strTeamId.data(), strTeamId.size() + 1);
     }
@@ -566,18 +607,7 @@ bool SlotBuildCodeDirectory(bool bAlternate, uint8_t *pCodeBase, uint32_t uCodeL
     }
     else
     {
-        for (uint32_t i = 0; i < uPages; i++)
-        {
-            string strSHASum;
-            SHASum(cdHeader.hashType, pCodeBase + uPageSize * i, uPageSize, strSHASum);
-            strOutput.append(strSHASum.data(), strSHASum.size());
-        }
-        if (uRemain > 0)
-        {
-            string strSHASum;
-            SHASum(cdHeader.hashType, pCodeBase + uPageSize * uPages, uRemain, strSHASum);
-            strOutput.append(strSHASum.data(), strSHASum.size());
-        }
+        SHASumPages(cdHeader.hashType, pCodeBase, uCodeLength, uPageSize, strOutput);
     }
 
     return true;
@@ -665,12 +695,19 @@ bool SlotBuildCMSSignature(ZSignAsset *pSignAsset, const string &strCodeDirector
     string strCDHashesPlist;
     string strCodeDirectorySlotSHA1;
     string strAltnateCodeDirectorySlot256;
-    SHASum(E_SHASUM_TYPE_1, strCodeDirectorySlot, strCodeDirectorySlotSHA1);
-    SHASum(E_SHASUM_TYPE_256, strAltnateCodeDirectorySlot, strAltnateCodeDirectorySlot256);
-
-    size_t cdHashSize = strCodeDirectorySlotSHA1.size();
-    jvHashes["cdhashes"][0].assignData(strCodeDirectorySlotSHA1.data(), cdHashSize);
-    jvHashes["cdhashes"][1].assignData(strAltnateCodeDirectorySlot256.data(), cdHashSize);
+    size_t cdHashSize = 20;
+    if (strAltnateCodeDirectorySlot.empty())
+    { // SHA-256 only, the primary directory is the one and only cdhash
+        SHASum(E_SHASUM_TYPE_256, strCodeDirectorySlot, strAltnateCodeDirectorySlot256);
+        jvHashes["cdhashes"][0].assignData(strAltnateCodeDirectorySlot256.data(), cdHashSize);
+    }
+    else
+    {
+        SHASum(E_SHASUM_TYPE_1, strCodeDirectorySlot, strCodeDirectorySlotSHA1);
+        SHASum(E_SHASUM_TYPE_256, strAltnateCodeDirectorySlot, strAltnateCodeDirectorySlot256);
+        jvHashes["cdhashes"][0].assignData(strCodeDirectorySlotSHA1.data(), cdHashSize);
+        jvHashes["cdhashes"][1].assignData(strAltnateCodeDirectorySlot256.data(), cdHashSize);
+    }
     jvHashes.writePList(strCDHashesPlist);
 
     string strCMSData;
@@ -699,6 +736,25 @@ uint32_t GetCodeSignatureLength(uint8_t *pCSBase)
     return 0;
 }
 
+uint32_t GetCodeSignatureSlotLength(uint8_t *pCSBase, uint32_t uSlotType)
+{
+    CS_SuperBlob *psb = (CS_SuperBlob *)pCSBase;
+    if (NULL == psb || CSMAGIC_EMBEDDED_SIGNATURE != LE(psb->magic))
+    {
+        return 0;
+    }
+
+    CS_BlobIndex *pbi = (CS_BlobIndex *)(pCSBase + sizeof(CS_SuperBlob));
+    for (uint32_t i = 0; i < LE(psb->count); i++, pbi++)
+    {
+        if (uSlotType == LE(pbi->type))
+        {
+            return LE(((CS_GenericBlob *)(pCSBase + LE(pbi->offset)))->length);
+        }
+    }
+    return 0;
+}
+
 bool ParseCodeSignature(uint8_t *pCSBase)
 {
     CS_SuperBlob *psb = (CS_SuperBlob *)pCSBase;
@@ -768,8 +824,9 @@ bool SlotGetCodeSlotsData(uint8_t *pSlotBase, uint8_t *&pCodeSlots, uint32_t &uC
     return true;
 }
 
-bool GetCodeSignatureExistsCodeSlotsData(uint8_t *pCSBase, uint8_t *&pCodeSlots1Data, uint32_t &uCodeSlots1DataLength,
-                                         uint8_t *&pCodeSlots256Data, uint32_t &uCodeSlots256DataLength)
+bool GetCodeSignatureExistsCodeSlotsData(uint8_t *pCSBase, uint32_t uPageSize, uint8_t *&pCodeSlots1Data,
+                                         uint32_t &uCodeSlots1DataLength, uint8_t *&pCodeSlots256Data,
+                                         uint32_t &uCodeSlots256DataLength)
 {
     pCodeSlots1Data = NULL;
     pCodeSlots256Data = NULL;
@@ -785,33 +842,31 @@ bool GetCodeSignatureExistsCodeSlotsData(uint8_t *pCSBase, uint8_t *&pCodeSlots1
     for (uint32_t i = 0; i < LE(psb->count); i++, pbi++)
     {
         uint8_t *pSlotBase = pCSBase + LE(pbi->offset);
-        switch (LE(pbi->type))
+        uint32_t uType = LE(pbi->type);
+        if (CSSLOT_CODEDIRECTORY != uType && CSSLOT_ALTERNATE_CODEDIRECTORIES != uType)
         {
-            case CSSLOT_CODEDIRECTORY:
-            {
-                CS_CodeDirectory cdHeader = *((CS_CodeDirectory *)pSlotBase);
-                if (LE(cdHeader.length) > 8)
-                {
-                    pCodeSlots1Data = pSlotBase + LE(cdHeader.hashOffset);
-                    uCodeSlots1DataLength = LE(cdHeader.nCodeSlots) * cdHeader.hashSize;
-                }
-            }
-            break;
-            case CSSLOT_ALTERNATE_CODEDIRECTORIES:
-            {
-                CS_CodeDirectory cdHeader = *((CS_CodeDirectory *)pSlotBase);
-                if (LE(cdHeader.length) > 8)
-                {
-                    pCodeSlots256Data = pSlotBase + LE(cdHeader.hashOffset);
-                    uCodeSlots256DataLength = LE(cdHeader.nCodeSlots) * cdHeader.hashSize;
-                }
-            }
-            break;
-            default:
-                break;
+            continue;
+        }
+
+        CS_CodeDirectory cdHeader = *((CS_CodeDirectory *)pSlotBase);
+        if (LE(cdHeader.length) <= 8 || uPageSize != (1u << cdHeader.pageSize))
+        { // slots hashed over another page size can't be reused
+            continue;
+        }
+
+        // a SHA-256 only signature keeps its SHA-256 directory in the primary slot
+        if (CS_HASHTYPE_SHA256 == cdHeader.hashType)
+        {
+            pCodeSlots256Data = pSlotBase + LE(cdHeader.hashOffset);
+            uCodeSlots256DataLength = LE(cdHeader.nCodeSlots) * cdHeader.hashSize;
+        }
+        else if (CS_HASHTYPE_SHA1 == cdHeader.hashType)
+        {
+            pCodeSlots1Data = pSlotBase + LE(cdHeader.hashOffset);
+            uCodeSlots1DataLength = LE(cdHeader.nCodeSlots) * cdHeader.hashSize;
         }
     }
 
-    return ((NULL != pCodeSlots1Data) && (NULL != pCodeSlots256Data) && uCodeSlots1DataLength > 0 &&
-            uCodeSlots256DataLength > 0);
+    return ((NULL != pCodeSlots1Data && uCodeSlots1DataLength > 0) ||
+            (NULL != pCodeSlots256Data && uCodeSlots256DataLength > 0));
 }
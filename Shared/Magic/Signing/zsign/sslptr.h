@@ -0,0 +1,42 @@
+/*
+ * Proprietary Software License Version 1.0
+ *
+ * Copyright (C) 2025 BDG
+ *
+ * Backdoor App Signer is proprietary software. You may not use, modify, or distribute it except as expressly permitted
+ * under the terms of the Proprietary Software License.
+ */
+
+/*
+ */
+
+#pragma once
+#include <openssl/cms.h>
+#include <openssl/conf.h>
+#include <openssl/pkcs12.h>
+#include <openssl/x509.h>
+
+#include <memory>
+
+/**
+ * Owning handles for OpenSSL objects, so every early return in the signing path releases what it allocated.
+ * ZSSLPtr<BIO> bio(BIO_new(...)); passes bio.get() to OpenSSL and frees it on scope exit.
+ */
+struct ZSSLFree
+{
+    void operator()(BIO *p) const { BIO_free_all(p); }
+    void operator()(X509 *p) const { X509_free(p); }
+    void operator()(EVP_PKEY *p) const { EVP_PKEY_free(p); }
+    void operator()(EVP_PKEY_CTX *p) const { EVP_PKEY_CTX_free(p); }
+    void operator()(PKCS12 *p) const { PKCS12_free(p); }
+    void operator()(CMS_ContentInfo *p) const { CMS_ContentInfo_free(p); }
+    void operator()(STACK_OF(X509) * p) const { sk_X509_pop_free(p, X509_free); }
+    void operator()(ASN1_OBJECT *p) const { ASN1_OBJECT_free(p); }
+    void operator()(ASN1_TYPE *p) const { ASN1_TYPE_free(p); }
+    void operator()(X509_ATTRIBUTE *p) const { X509_ATTRIBUTE_free(p); }
+    void operator()(CONF *p) const { NCONF_free(p); }
+    void operator()(BIGNUM *p) const { BN_free(p); }
+    void operator()(char *p) const { OPENSSL_free(p); }
+};
+
+template <typename T> using ZSSLPtr = std::unique_ptr<T, ZSSLFree>;
@@ -25,11 +25,22 @@ extern "C"
 
     bool ChangeDylibPath(NSString *filePath, NSString *oldPath, NSString *newPath);
 
+    bool ChangeBundleDylibPath(NSString *appPath, NSString *oldPath, NSString *newPath);
+
+    int ExtractDeb(NSString *appPath, NSString *debPath, NSMutableArray *injectPathsArray,
+                   NSMutableArray *changeFromArray, NSMutableArray *changeToArray);
+
+    bool AdhocSign(NSString *path, NSString *entitlementsPath, NSArray<NSString *> *injectDylibs,
+                   NSArray<NSString *> *removeDylibs, NSArray<NSString *> *changeFrom, NSArray<NSString *> *changeTo);
+    bool AdhocSignFiles(NSArray<NSString *> *filePaths, NSString *entitlementsPath);
+
     bool ListDylibs(NSString *filePath, NSMutableArray *dylibPathsArray);
+    bool GetDylibGraph(NSString *appPath, NSMutableString *graphJSON);
     bool UninstallDylibs(NSString *filePath, NSArray<NSString *> *dylibPathsArray);
 
     int zsign(NSString *app, NSString *prov, NSString *key, NSString *pass, NSString *bundleid, NSString *displayname,
-              NSString *bundleversion, bool dontGenerateEmbeddedMobileProvision);
+              NSString *bundleversion, bool dontGenerateEmbeddedMobileProvision, NSArray<NSString *> *injectDylibs,
+              NSArray<NSString *> *removeDylibs, NSArray<NSString *> *changeFrom, NSArray<NSString *> *changeTo);
 
 #ifdef __cplusplus
 }
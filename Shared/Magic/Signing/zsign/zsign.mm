@@ -14,8 +14,11 @@
 #include "bundle.h"
 #include "common/common.h"
 #include "common/json.h"
+#include "deb.h"
 #include "macho.h"
 #include "openssl.h"
+#include "registry.h"
+#include "Utils.hpp"
 #include <dirent.h>
 #include <getopt.h>
 #include <libgen.h>
@@ -27,6 +30,23 @@ NSString *getTmpDir()
     return [[[paths objectAtIndex:0] stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"tmp"];
 }
 
+static void _AddDylibEdits(ZAppBundle &bundle, NSArray<NSString *> *injectDylibs, NSArray<NSString *> *removeDylibs,
+                           NSArray<NSString *> *changeFrom, NSArray<NSString *> *changeTo)
+{ // queued here, applied by SignFolder to each binary right before it is signed
+    for (NSUInteger i = 0; i < changeFrom.count && i < changeTo.count; i++)
+    {
+        bundle.AddDylibEdit(ZAppBundle::E_DYLIB_CHANGE, [changeFrom[i] UTF8String], [changeTo[i] UTF8String]);
+    }
+    for (NSString *dylibPath in removeDylibs)
+    {
+        bundle.AddDylibEdit(ZAppBundle::E_DYLIB_REMOVE, [dylibPath UTF8String]);
+    }
+    for (NSString *dylibPath in injectDylibs)
+    {
+        bundle.AddDylibEdit(ZAppBundle::E_DYLIB_INJECT_ROOT, [dylibPath UTF8String]);
+    }
+}
+
 extern "C"
 {
 
@@ -73,7 +93,7 @@ extern "C"
             std::string filePathStr = [filePath UTF8String];
 
             ZMachO machO;
-            bool initSuccess = machO.Init(filePathStr.c_str());
+            bool initSuccess = machO.Init(filePathStr.c_str(), true);
             if (!initSuccess)
             {
                 gtimer.Print(">>> Failed to initialize ZMachO.");
@@ -102,6 +122,30 @@ extern "C"
         }
     }
 
+    bool GetDylibGraph(NSString *appPath, NSMutableString *graphJSON)
+    {
+        ZTimer gtimer;
+        @autoreleasepool
+        {
+            std::string appPathStr = [appPath UTF8String];
+
+            ZAppBundle bundle;
+            JValue jvGraph;
+            if (!bundle.GetDylibGraph(appPathStr, jvGraph))
+            {
+                gtimer.Print(">>> Failed to build dylib graph.");
+                return false;
+            }
+
+            std::string strJSON;
+            jvGraph.write(strJSON);
+            [graphJSON setString:[NSString stringWithUTF8String:strJSON.c_str()]];
+
+            gtimer.Print(">>> Dylib graph built successfully!");
+            return true;
+        }
+    }
+
     bool UninstallDylibs(NSString *filePath, NSArray<NSString *> *dylibPathsArray)
     {
         ZTimer gtimer;
@@ -167,8 +211,123 @@ extern "C"
         }
     }
 
+    bool ChangeBundleDylibPath(NSString *appPath, NSString *oldPath, NSString *newPath)
+    {
+        ZTimer gtimer;
+        @autoreleasepool
+        {
+            std::string appPathStr = [appPath UTF8String];
+            std::string oldPathStr = [oldPath UTF8String];
+            std::string newPathStr = [newPath UTF8String];
+
+            ZAppBundle bundle;
+            bundle.AddDylibEdit(ZAppBundle::E_DYLIB_CHANGE, oldPathStr, newPathStr);
+            bool success = bundle.EditFolder(appPathStr);
+
+            gtimer.Print(success ? ">>> Bundle dylib paths changed successfully!"
+                                 : ">>> Failed to change bundle dylib paths.");
+            return success;
+        }
+    }
+
+    int ExtractDeb(NSString *appPath, NSString *debPath, NSMutableArray *injectPathsArray,
+                   NSMutableArray *changeFromArray, NSMutableArray *changeToArray)
+    { // returns a ZDebPackage::E_DEB_EXTRACT_* code, only UNSUPPORTED leaves the app untouched
+        ZTimer gtimer;
+        @autoreleasepool
+        {
+            std::string appPathStr = [appPath UTF8String];
+            std::string debPathStr = [debPath UTF8String];
+
+            ZDebPackage deb;
+            int nExtract = deb.Extract(debPathStr.c_str(), appPathStr);
+            if (ZDebPackage::E_DEB_EXTRACT_DONE != nExtract)
+            {
+                gtimer.Print(ZDebPackage::E_DEB_EXTRACT_UNSUPPORTED == nExtract ? ">>> Unsupported deb compression."
+                                                                                : ">>> Failed to extract deb.");
+                return nExtract;
+            }
+
+            // the load commands are added and changed by zsign() while it signs each binary
+            for (const std::string &strInjectPath : deb.GetInjectPaths())
+            {
+                [injectPathsArray addObject:[NSString stringWithUTF8String:strInjectPath.c_str()]];
+            }
+            for (const std::pair<std::string, std::string> &change : deb.GetChangePaths())
+            {
+                [changeFromArray addObject:[NSString stringWithUTF8String:change.first.c_str()]];
+                [changeToArray addObject:[NSString stringWithUTF8String:change.second.c_str()]];
+            }
+
+            gtimer.Print(">>> Deb extracted successfully!");
+            return ZDebPackage::E_DEB_EXTRACT_DONE;
+        }
+    }
+
+    bool AdhocSign(NSString *path, NSString *entitlementsPath, NSArray<NSString *> *injectDylibs,
+                   NSArray<NSString *> *removeDylibs, NSArray<NSString *> *changeFrom, NSArray<NSString *> *changeTo)
+    {
+        ZTimer gtimer;
+        @autoreleasepool
+        {
+            std::string pathStr = [path UTF8String];
+            std::string entitlementsPathStr = (nil != entitlementsPath) ? [entitlementsPath UTF8String] : "";
+
+            ZSignAsset zSignAsset;
+            if (!zSignAsset.InitAdhoc(entitlementsPathStr))
+            {
+                gtimer.Print(">>> Failed to prepare ad-hoc signing.");
+                return false;
+            }
+
+            ZAppBundle bundle;
+            _AddDylibEdits(bundle, injectDylibs, removeDylibs, changeFrom, changeTo);
+
+            bool success = false;
+            if (IsFolder(pathStr.c_str()))
+            {
+                success = bundle.SignFolder(&zSignAsset, pathStr, "", "", "", "", true, false, false, false);
+            }
+            else
+            {
+                success = bundle.SignFiles(&zSignAsset, std::vector<std::string>(1, pathStr), true);
+            }
+
+            gtimer.Print(success ? ">>> Ad-hoc signed successfully!" : ">>> Failed to ad-hoc sign.");
+            return success;
+        }
+    }
+
+    bool AdhocSignFiles(NSArray<NSString *> *filePaths, NSString *entitlementsPath)
+    {
+        ZTimer gtimer;
+        @autoreleasepool
+        {
+            std::vector<std::string> arrFiles;
+            for (NSString *filePath in filePaths)
+            {
+                arrFiles.push_back([filePath UTF8String]);
+            }
+            std::string entitlementsPathStr = (nil != entitlementsPath) ? [entitlementsPath UTF8String] : "";
+
+            ZSignAsset zSignAsset;
+            if (!zSignAsset.InitAdhoc(entitlementsPathStr))
+            {
+                gtimer.Print(">>> Failed to prepare ad-hoc signing.");
+                return false;
+            }
+
+            ZAppBundle bundle;
+            bool success = bundle.SignFiles(&zSignAsset, arrFiles, true);
+
+            gtimer.Print(success ? ">>> Files ad-hoc signed successfully!" : ">>> Failed to ad-hoc sign files.");
+            return success;
+        }
+    }
+
     int zsign(NSString *app, NSString *prov, NSString *key, NSString *pass, NSString *bundleid, NSString *displayname,
-              NSString *bundleversion, bool dontGenerateEmbeddedMobileProvision)
+              NSString *bundleversion, bool dontGenerateEmbeddedMobileProvision, NSArray<NSString *> *injectDylibs,
+              NSArray<NSString *> *removeDylibs, NSArray<NSString *> *changeFrom, NSArray<NSString *> *changeTo)
     {
         ZTimer gtimer;
 
@@ -186,6 +345,7 @@ extern "C"
         string strOutputFile;
         string strDisplayName;
         string strEntitlementsFile;
+        string strCacheFile;
 
         bForce = true;
         strPKeyFile = [key cStringUsingEncoding:NSUTF8StringEncoding];
@@ -210,7 +370,7 @@ extern "C"
             if (!bZipFile)
             { // macho file
                 ZMachO macho;
-                if (macho.Init(strPath.c_str()))
+                if (macho.Init(strPath.c_str(), strDyLibFile.empty()))
                 {
                     if (!strDyLibFile.empty())
                     { // inject dylib
@@ -229,17 +389,21 @@ extern "C"
 
         ZTimer timer;
         ZSignAsset zSignAsset;
+        ZSignRegistry zSignRegistry;
+        zSignRegistry.Load(StringFormat(strCacheFile, "%s/.zsign_registry.json", getDocumentsDirectory()));
 
-        if (!zSignAsset.Init(strCertFile, strPKeyFile, strProvFile, strEntitlementsFile, strPassword))
+        if (!zSignAsset.Init(strCertFile, strPKeyFile, strProvFile, strEntitlementsFile, strPassword, &zSignRegistry))
         {
             return -1;
         }
+        zSignRegistry.Save();
 
         bool bEnableCache = true;
         string strFolder = strPath;
 
         timer.Reset();
         ZAppBundle bundle;
+        _AddDylibEdits(bundle, injectDylibs, removeDylibs, changeFrom, changeTo);
         bool bRet =
             bundle.SignFolder(&zSignAsset, strFolder, strBundleId, strBundleVersion, strDisplayName, strDyLibFile,
                               bForce, bWeakInject, bEnableCache, bDontGenerateEmbeddedMobileProvision);